@@ -19,6 +19,21 @@ if (NOT ${LLVM_CONFIG} STREQUAL "LLVM_CONFIG-NOTFOUND")
 		OUTPUT_VARIABLE LLVM_ALL_LIBS
 		OUTPUT_STRIP_TRAILING_WHITESPACE
 	)
+	execute_process(
+		COMMAND ${LLVM_CONFIG} --includedir
+		OUTPUT_VARIABLE LLVM_INCLUDE_DIR
+		OUTPUT_STRIP_TRAILING_WHITESPACE
+	)
+	execute_process(
+		COMMAND ${LLVM_CONFIG} --libdir
+		OUTPUT_VARIABLE LLVM_LIBRARY_DIR
+		OUTPUT_STRIP_TRAILING_WHITESPACE
+	)
+	execute_process(
+		COMMAND ${LLVM_CONFIG} --version
+		OUTPUT_VARIABLE LLVM_VERSION
+		OUTPUT_STRIP_TRAILING_WHITESPACE
+	)
 
 	SET(LLVM_FOUND TRUE)
 
@@ -2,10 +2,20 @@ INCLUDE(FindPkgConfig)
 
 IF(PKG_CONFIG_FOUND)
         pkg_check_modules (LUA lua>=5.1)
-        if (LUA_VERSION VERSION_EQUAL "5.3")
+        if (NOT LUA_FOUND)
+                pkg_check_modules (LUAJIT luajit)
+        endif()
+        if (LUAJIT_FOUND)
+                SET(LUA_INCLUDEDIR ${LUAJIT_INCLUDEDIR})
+                SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DLUA51 -DLUAJIT" CACHE STRING "Lua version compiler flag")
+                SET(LUA_SHORT_VERSION "5.1" CACHE STRING "Lua short version string")
+        elseif (NOT LUA_VERSION VERSION_LESS "5.4")
+                SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DLUA54" CACHE STRING "Lua version compiler flag")
+                SET(LUA_SHORT_VERSION "5.4" CACHE STRING "Lua short version string")
+        elseif (NOT LUA_VERSION VERSION_LESS "5.3")
                 SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DLUA53" CACHE STRING "Lua version compiler flag")
                 SET(LUA_SHORT_VERSION "5.3" CACHE STRING "Lua short version string")
-        elseif (LUA_VERSION VERSION_EQUAL "5.2")
+        elseif (NOT LUA_VERSION VERSION_LESS "5.2")
                 SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DLUA52" CACHE STRING "Lua version compiler flag")
                 SET(LUA_SHORT_VERSION "5.2" CACHE STRING "Lua short version string")
         else()
@@ -13,7 +23,11 @@ IF(PKG_CONFIG_FOUND)
 		SET(LUA_SHORT_VERSION "5.1" CACHE STRING "Lua short version string")
         endif()
 
-        FIND_LIBRARY(LUA_LIBRARY NAMES lua)
+        if (LUAJIT_FOUND)
+                FIND_LIBRARY(LUA_LIBRARY NAMES luajit-5.1 HINTS ${LUAJIT_LIBRARY_DIRS})
+        else()
+                FIND_LIBRARY(LUA_LIBRARY NAMES lua HINTS ${LUA_LIBRARY_DIRS})
+        endif()
 
 ELSE(PKG_CONFIG_FOUND)
 	MESSAGE(WARNING " pkg-config not found, version detection will be much less reliable")
@@ -33,7 +47,10 @@ ELSE(PKG_CONFIG_FOUND)
 			MESSAGE(FATAL_ERROR "Lua reports unsupported version ${LUA_VERSION}")
                 ELSE ()
 			MESSAGE(STATUS "Found Lua version = ${LUA_VERSION}")
-                        if (LUA_VERSION VERSION_EQUAL "5.3")
+                        if (LUA_VERSION VERSION_EQUAL "5.4")
+                                SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DLUA54" CACHE STRING "Lua version compiler flag")
+                                SET(LUA_SHORT_VERSION "5.4" CACHE STRING "Lua short version string")
+                        elseif (LUA_VERSION VERSION_EQUAL "5.3")
                                 SET(CMAKE_CXX_FLAGS "${CMAKE_CXX_FLAGS} -DLUA53" CACHE STRING "Lua version compiler flag")
                                 SET(LUA_SHORT_VERSION "5.3" CACHE STRING "Lua short version string")
                         elseif (LUA_VERSION VERSION_EQUAL "5.2")
@@ -0,0 +1,96 @@
+# selfportrait_generate(<target> HEADERS <header>... [FLAGS <flag>...] [PRELUDE <header>]
+#                       [SHARDS <n>] [METHOD_TABLES] [STATIC_METADATA]
+#                       [BINARY_METADATA <file>])
+#
+# Generates the meta-data for the headers with selfportraitc before <target>
+# is built and adds the generated sources to it, one per header or, with
+# SHARDS, n per header that can be compiled in parallel.
+# selfportraitc keeps a manifest of the headers, their includes and the flags,
+# so it runs on every build but only parses and rewrites the outputs of
+# headers that changed, and targets depending on the generated sources are
+# only recompiled when these really change.
+# METHOD_TABLES registers the methods through tables sharing one invoker per
+# signature, which compiles faster and gives smaller binaries.
+# STATIC_METADATA compiles the generated sources with REFL_STATIC_METADATA,
+# the meta-classes are then built on first lookup instead of at load time.
+# BINARY_METADATA also writes the meta-data of all the headers to <file>, in
+# the binary format read by MetadataFile.
+
+include(CMakeParseArguments)
+
+function(selfportrait_generate TARGET)
+	if(CMAKE_VERSION VERSION_LESS 3.2)
+		message(FATAL_ERROR "selfportrait_generate requires CMake 3.2")
+	endif()
+
+	cmake_parse_arguments(SP "METHOD_TABLES;STATIC_METADATA" "PRELUDE;SHARDS;BINARY_METADATA" "HEADERS;FLAGS" ${ARGN})
+
+	if(NOT SP_HEADERS)
+		message(FATAL_ERROR "selfportrait_generate: no HEADERS given for ${TARGET}")
+	endif()
+
+	if(TARGET selfportraitc)
+		set(SELFPORTRAITC $<TARGET_FILE:selfportraitc>)
+	else()
+		find_program(SELFPORTRAITC selfportraitc)
+		if(NOT SELFPORTRAITC)
+			message(FATAL_ERROR "selfportrait_generate: selfportraitc not found")
+		endif()
+	endif()
+
+	set(DIR "${CMAKE_CURRENT_BINARY_DIR}/${TARGET}_metadata")
+	file(MAKE_DIRECTORY "${DIR}")
+
+	set(HEADER_LIST "")
+	set(GENERATED "")
+	foreach(HEADER ${SP_HEADERS})
+		get_filename_component(ABS "${HEADER}" ABSOLUTE)
+		get_filename_component(NAME "${HEADER}" NAME_WE)
+		set(HEADER_LIST "${HEADER_LIST}${ABS}\n")
+		if(SP_SHARDS GREATER 1)
+			math(EXPR LAST "${SP_SHARDS} - 1")
+			foreach(I RANGE ${LAST})
+				list(APPEND GENERATED "${DIR}/${NAME}_${I}.cpp")
+			endforeach()
+		else()
+			list(APPEND GENERATED "${DIR}/${NAME}.cpp")
+		endif()
+	endforeach()
+	file(WRITE "${DIR}/headers.txt" "${HEADER_LIST}")
+
+	set(ARGS --batch=${DIR}/headers.txt --output-dir=${DIR} --manifest=${DIR}/manifest.txt)
+	if(SP_SHARDS)
+		list(APPEND ARGS --shards=${SP_SHARDS})
+	endif()
+	if(SP_METHOD_TABLES)
+		list(APPEND ARGS --method-tables)
+	endif()
+	if(SP_BINARY_METADATA)
+		set(BINARY "${SP_BINARY_METADATA}")
+		if(NOT IS_ABSOLUTE "${BINARY}")
+			set(BINARY "${CMAKE_CURRENT_BINARY_DIR}/${BINARY}")
+		endif()
+		list(APPEND ARGS --binary-metadata=${BINARY})
+	endif()
+	if(SP_PRELUDE)
+		get_filename_component(PRELUDE "${SP_PRELUDE}" ABSOLUTE)
+		list(APPEND ARGS --prelude=${PRELUDE} --pch-cache=${DIR})
+	endif()
+
+	add_custom_target(${TARGET}_metadata
+		COMMAND ${SELFPORTRAITC} ${ARGS} ${SP_FLAGS}
+		BYPRODUCTS ${GENERATED} ${BINARY}
+		WORKING_DIRECTORY ${CMAKE_CURRENT_SOURCE_DIR}
+		VERBATIM)
+
+	if(TARGET selfportraitc)
+		add_dependencies(${TARGET}_metadata selfportraitc)
+	endif()
+
+	set_source_files_properties(${GENERATED} PROPERTIES GENERATED TRUE)
+	if(SP_STATIC_METADATA)
+		set_property(SOURCE ${GENERATED} APPEND PROPERTY COMPILE_DEFINITIONS REFL_STATIC_METADATA)
+	endif()
+	target_sources(${TARGET} PRIVATE ${GENERATED})
+	add_dependencies(${TARGET} ${TARGET}_metadata)
+endfunction()
@@ -0,0 +1,49 @@
+-- Compares reading the attributes of a reflected struct one field at a
+-- time with reading them in bulk, run by the bench executable with the
+-- number of objects read as argument. Returns the number of reads of
+-- each kind.
+
+require "libluaselfportrait"
+
+local times = ...
+
+local TestStruct = Class.lookup("test_functions::TestStruct")
+local s = TestStruct:construct()
+s:setAttributes{elem1 = 1, elem2 = 2, elem3 = 3, elem4 = 4}
+
+local names = {"elem1", "elem2", "elem3", "elem4"}
+local accessor = TestStruct:attributeAccessor(names)
+local fields, bulk, accessed = 0, 0, 0
+
+collectgarbage()
+local start = os.clock()
+
+for i = 1, times do
+    local a, b, c, d = s.elem1, s.elem2, s.elem3, s.elem4
+    fields = fields + 1
+end
+
+print("4 attributes by field (s) = " .. (os.clock() - start))
+
+collectgarbage()
+start = os.clock()
+
+for i = 1, times do
+    local a, b, c, d = s:getAttributes(names)
+    bulk = bulk + 1
+end
+
+print("4 attributes by getAttributes (s) = " .. (os.clock() - start))
+
+collectgarbage()
+start = os.clock()
+
+for i = 1, times do
+    local a, b, c, d = accessor:get(s)
+    accessed = accessed + 1
+end
+
+print("4 attributes by accessor (s) = " .. (os.clock() - start))
+
+assert(fields == bulk and bulk == accessed)
+return accessed
@@ -0,0 +1,53 @@
+-- Compares calls through the Lua C API with calls through LuaJIT FFI
+-- function pointers, run by the bench executable with the number of calls
+-- as argument. Returns the number of calls made.
+
+require "libluaselfportrait"
+
+local times = ...
+
+local intarg2 = Function.lookup("test_functions::intarg2")
+local Methods = Class.lookup("test_functions::Methods")
+local obj = Methods:construct()
+
+local start = os.clock()
+
+for i = 1, times do
+    intarg2(i, i)
+end
+
+print("lua function 2 args (s) = " .. (os.clock() - start))
+
+start = os.clock()
+
+for i = 1, times do
+    obj:intarg2(i, i)
+end
+
+print("lua method 2 args (s) = " .. (os.clock() - start))
+
+local ffiIntarg2 = intarg2:ffi()
+local ffiMethod = Methods:findMethod(function(m) return m:name() == "intarg2" end):ffi()
+
+if not ffiIntarg2 or not ffiMethod then
+    print("no FFI")
+    return 2*times
+end
+
+start = os.clock()
+
+for i = 1, times do
+    ffiIntarg2(i, i)
+end
+
+print("ffi function 2 args (s) = " .. (os.clock() - start))
+
+start = os.clock()
+
+for i = 1, times do
+    ffiMethod(obj, i, i)
+end
+
+print("ffi method 2 args (s) = " .. (os.clock() - start))
+
+return 4*times
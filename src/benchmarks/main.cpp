@@ -4,10 +4,18 @@
 */
 #include "test_functions.h"
 #include "reflection.h"
+#include <lua.hpp>
 
+#include <dlfcn.h>
+#include <sys/stat.h>
 #include <time.h>
 #include <stdlib.h>
+#include <algorithm>
+#include <chrono>
 #include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
 using namespace std;
 
 static const int times = 100000000;
@@ -16,7 +24,7 @@ static const int times = 100000000;
 
 void noargtest()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::noargs");
+	Function::FunctionList functions = Function::findFunctions("test_functions::noargs");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -65,7 +73,7 @@ void noargtest()
 
 void arg1test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg1");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg1");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -116,7 +124,7 @@ void arg1test()
 
 void arg2test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg2");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg2");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -166,7 +174,7 @@ void arg2test()
 
 void arg3test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg3");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg3");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -216,7 +224,7 @@ void arg3test()
 
 void arg4test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg4");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg4");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -266,7 +274,7 @@ void arg4test()
 
 void arg5test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg5");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg5");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -315,7 +323,7 @@ void arg5test()
 
 void arg6test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg6");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg6");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -364,7 +372,7 @@ void arg6test()
 
 void arg7test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg7");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg7");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -413,7 +421,7 @@ void arg7test()
 
 void arg8test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg8");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg8");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -462,7 +470,7 @@ void arg8test()
 
 void arg9test()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg9");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg9");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -513,7 +521,7 @@ void arg9test()
 void structArgCpy1Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy1");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy1");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -565,7 +573,7 @@ void structArgCpy1Test()
 void structArgCpy2Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy2");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy2");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -615,7 +623,7 @@ void structArgCpy2Test()
 void structArgCpy3Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy3");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy3");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -665,7 +673,7 @@ void structArgCpy3Test()
 void structArgCpy4Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy4");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy4");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -715,7 +723,7 @@ void structArgCpy4Test()
 void structArgCpy5Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy5");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy5");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -765,7 +773,7 @@ void structArgCpy5Test()
 void structArgCpy6Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy6");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy6");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -815,7 +823,7 @@ void structArgCpy6Test()
 void structArgCpy7Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy7");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy7");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -866,7 +874,7 @@ void structArgCpy7Test()
 void structArgCpy8Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy8");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy8");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -917,7 +925,7 @@ void structArgCpy8Test()
 void structArgCpy9Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgCpy9");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgCpy9");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -967,7 +975,7 @@ void structArgCpy9Test()
 void structArgRef1Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef1");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef1");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1019,7 +1027,7 @@ void structArgRef1Test()
 void structArgRef2Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef2");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef2");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1069,7 +1077,7 @@ void structArgRef2Test()
 void structArgRef3Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef3");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef3");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1119,7 +1127,7 @@ void structArgRef3Test()
 void structArgRef4Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef4");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef4");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1169,7 +1177,7 @@ void structArgRef4Test()
 void structArgRef5Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef5");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef5");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1219,7 +1227,7 @@ void structArgRef5Test()
 void structArgRef6Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef6");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef6");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1269,7 +1277,7 @@ void structArgRef6Test()
 void structArgRef7Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef7");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef7");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1320,7 +1328,7 @@ void structArgRef7Test()
 void structArgRef8Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef8");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef8");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1371,7 +1379,7 @@ void structArgRef8Test()
 void structArgRef9Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::structArgRef9");
+	Function::FunctionList functions = Function::findFunctions("test_functions::structArgRef9");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1421,7 +1429,7 @@ void structArgRef9Test()
 
 void arg1Conversiontest()
 {
-	std::list<Function> functions = Function::findFunctions("test_functions::intarg1");
+	Function::FunctionList functions = Function::findFunctions("test_functions::intarg1");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1474,7 +1482,7 @@ void arg1Conversiontest()
 void polyArgRef1Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg1");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg1");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1525,7 +1533,7 @@ void polyArgRef1Test()
 void polyArgRef2Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg2");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg2");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1576,7 +1584,7 @@ void polyArgRef2Test()
 void polyArgRef3Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg3");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg3");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1627,7 +1635,7 @@ void polyArgRef3Test()
 void polyArgRef4Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg4");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg4");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1678,7 +1686,7 @@ void polyArgRef4Test()
 void polyArgRef5Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg5");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg5");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1729,7 +1737,7 @@ void polyArgRef5Test()
 void polyArgRef6Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg6");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg6");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1780,7 +1788,7 @@ void polyArgRef6Test()
 void polyArgRef7Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg7");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg7");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1831,7 +1839,7 @@ void polyArgRef7Test()
 void polyArgRef8Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg8");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg8");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1882,7 +1890,7 @@ void polyArgRef8Test()
 void polyArgRef9Test()
 {
 	using namespace test_functions;
-	std::list<Function> functions = Function::findFunctions("test_functions::polyArg9");
+	Function::FunctionList functions = Function::findFunctions("test_functions::polyArg9");
 
 	if (functions.size() != 1) {
 		std::cerr << "wrong number of functions found" << std::endl;
@@ -1931,6 +1939,536 @@ void polyArgRef9Test()
 }
 
 
+void proxyNoargTest()
+{
+	Class iface = Class::lookup("test_functions::Interface");
+	Method method = iface.findMethod([](const Method& m) { return m.name() == "noargs"; });
+
+	if (!method.isValid()) {
+		std::cerr << "method not found" << std::endl;
+		exit(1);
+	}
+
+	test_functions::Interface* direct = test_functions::newInterfaceImpl();
+
+	test_functions::resetCounter();
+
+	clock_t start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		direct->noargs();
+	}
+
+	clock_t final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "direct 0 args = " << (final - start) << std::endl;
+
+	Proxy proxy(iface);
+	proxy.addImplementation(method, [](const ArgArray& args) -> VariantValue {
+		test_functions::noargs();
+		return VariantValue();
+	});
+
+	VariantValue handle = proxy.reference(iface);
+	test_functions::Interface& stub = handle.convertTo<test_functions::Interface&>();
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.noargs();
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "proxied 0 args = " << (final - start) << std::endl;
+
+	proxy.addImplementation<void()>(method, []() { test_functions::noargs(); });
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.noargs();
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "typed proxied 0 args = " << (final - start) << std::endl;
+
+	delete direct;
+}
+
+void proxyArg2Test()
+{
+	Class iface = Class::lookup("test_functions::Interface");
+	Method method = iface.findMethod([](const Method& m) { return m.name() == "intarg2"; });
+
+	if (!method.isValid()) {
+		std::cerr << "method not found" << std::endl;
+		exit(1);
+	}
+
+	test_functions::Interface* direct = test_functions::newInterfaceImpl();
+
+	test_functions::resetCounter();
+
+	clock_t start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		direct->intarg2(i, 0);
+	}
+
+	clock_t final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "direct 2 args = " << (final - start) << std::endl;
+
+	Proxy proxy(iface);
+	proxy.addImplementation(method, [](const ArgArray& args) -> VariantValue {
+		test_functions::intarg2(args[0].value<int>(), args[1].value<int>());
+		return VariantValue();
+	});
+
+	VariantValue handle = proxy.reference(iface);
+	test_functions::Interface& stub = handle.convertTo<test_functions::Interface&>();
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.intarg2(i, 0);
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "proxied 2 args = " << (final - start) << std::endl;
+
+	proxy.addImplementation<void(int, int)>(method, [](int a, int b) { test_functions::intarg2(a, b); });
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.intarg2(i, 0);
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "typed proxied 2 args = " << (final - start) << std::endl;
+
+	delete direct;
+}
+
+void proxyRet2Test()
+{
+	Class iface = Class::lookup("test_functions::Interface");
+	Method method = iface.findMethod([](const Method& m) { return m.name() == "intret2"; });
+
+	if (!method.isValid()) {
+		std::cerr << "method not found" << std::endl;
+		exit(1);
+	}
+
+	test_functions::Interface* direct = test_functions::newInterfaceImpl();
+
+	test_functions::resetCounter();
+
+	clock_t start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		direct->intret2(i, 0);
+	}
+
+	clock_t final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "direct 2 args with result = " << (final - start) << std::endl;
+
+	Proxy proxy(iface);
+	proxy.addImplementation(method, [](const ArgArray& args) -> VariantValue {
+		test_functions::intarg2(args[0].value<int>(), args[1].value<int>());
+		return VariantValue(args[0].value<int>() + args[1].value<int>());
+	});
+
+	VariantValue handle = proxy.reference(iface);
+	test_functions::Interface& stub = handle.convertTo<test_functions::Interface&>();
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.intret2(i, 0);
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "proxied 2 args with result = " << (final - start) << std::endl;
+
+	proxy.addImplementation<int(int, int)>(method, [](int a, int b) { test_functions::intarg2(a, b); return a + b; });
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.intret2(i, 0);
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "typed proxied 2 args with result = " << (final - start) << std::endl;
+
+	delete direct;
+}
+
+void proxyStructArgRef1Test()
+{
+	Class iface = Class::lookup("test_functions::Interface");
+	Method method = iface.findMethod([](const Method& m) { return m.name() == "structArgRef1"; });
+
+	if (!method.isValid()) {
+		std::cerr << "method not found" << std::endl;
+		exit(1);
+	}
+
+	test_functions::Interface* direct = test_functions::newInterfaceImpl();
+
+	test_functions::TestStruct t1;
+
+	test_functions::resetCounter();
+
+	clock_t start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		direct->structArgRef1(t1);
+	}
+
+	clock_t final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "direct 1 struct arg by ref = " << (final - start) << std::endl;
+
+	Proxy proxy(iface);
+	proxy.addImplementation(method, [](const ArgArray& args) -> VariantValue {
+		test_functions::structArgRef1(args[0].convertTo<const test_functions::TestStruct&>());
+		return VariantValue();
+	});
+
+	VariantValue handle = proxy.reference(iface);
+	test_functions::Interface& stub = handle.convertTo<test_functions::Interface&>();
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.structArgRef1(t1);
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "proxied 1 struct arg by ref = " << (final - start) << std::endl;
+
+	proxy.addImplementation<void(const test_functions::TestStruct&)>(method, [](const test_functions::TestStruct& t) { test_functions::structArgRef1(t); });
+
+	test_functions::resetCounter();
+
+	start = clock();
+
+	for (int i = 0; i < times; ++i) {
+		stub.structArgRef1(t1);
+	}
+
+	final = clock();
+
+	if (test_functions::getCounter() != times) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+
+	std::cout << "typed proxied 1 struct arg by ref = " << (final - start) << std::endl;
+
+	delete direct;
+}
+
+
+// every thread calls through its own copy of the proxy, reports wall time
+double proxyThreadsRun(const Proxy& proxy, const Class& iface, unsigned numThreads, int callsPerThread)
+{
+	std::vector<std::thread> threads;
+	std::vector<long> sums(numThreads, 0);
+
+	auto start = std::chrono::steady_clock::now();
+
+	for (unsigned t = 0; t < numThreads; ++t) {
+		threads.emplace_back([&, t]() {
+			Proxy copy(proxy);
+			VariantValue handle = copy.reference(iface);
+			test_functions::Interface& stub = handle.convertTo<test_functions::Interface&>();
+			long sum = 0;
+			for (int i = 0; i < callsPerThread; ++i) {
+				sum += stub.intret2(1, 0);
+			}
+			sums[t] = sum;
+		});
+	}
+	for (auto& th: threads) {
+		th.join();
+	}
+
+	auto final = std::chrono::steady_clock::now();
+
+	for (long sum: sums) {
+		if (sum != callsPerThread) {
+			std::cerr << "wrong result" << std::endl;
+			exit(1);
+		}
+	}
+
+	return std::chrono::duration<double, std::milli>(final - start).count();
+}
+
+// calls of all threads per millisecond must not drop as threads are added,
+// as they would if every call went through a shared lock or counter
+void proxyThreadsCheck(const char* what, const std::vector<unsigned>& threadCounts, const std::vector<double>& ms, int callsPerThread)
+{
+	const double single = callsPerThread / ms.front();
+	for (size_t i = 0; i < threadCounts.size(); ++i) {
+		const double throughput = threadCounts[i] * callsPerThread / ms[i];
+		std::cout << what << ", " << threadCounts[i] << " threads: " << static_cast<long>(throughput) << " calls/ms, "
+				  << throughput / single << "x one thread" << std::endl;
+		if (throughput < single) {
+			std::cerr << "proxy calls do not scale with threads" << std::endl;
+			exit(1);
+		}
+	}
+}
+
+void proxyThreadsTest()
+{
+	Class iface = Class::lookup("test_functions::Interface");
+	Method method = iface.findMethod([](const Method& m) { return m.name() == "intret2"; });
+
+	unsigned numThreads = std::max(1u, std::thread::hardware_concurrency());
+	const int callsPerThread = times / 10;
+
+	std::vector<unsigned> threadCounts;
+	for (unsigned n = 1; n < numThreads; n *= 2) {
+		threadCounts.push_back(n);
+	}
+	threadCounts.push_back(numThreads);
+
+	Proxy proxy(iface);
+
+	proxy.addImplementation(method, [](const ArgArray& args) -> VariantValue {
+		return VariantValue(args[0].value<int>() + args[1].value<int>());
+	});
+
+	std::vector<double> ms;
+	for (unsigned n: threadCounts) {
+		ms.push_back(proxyThreadsRun(proxy, iface, n, callsPerThread));
+		std::cout << "proxied 2 args with result, " << n << " threads (ms) = " << ms.back() << std::endl;
+	}
+	proxyThreadsCheck("proxied", threadCounts, ms, callsPerThread);
+
+	proxy.addImplementation<int(int, int)>(method, [](int a, int b) { return a + b; });
+
+	ms.clear();
+	for (unsigned n: threadCounts) {
+		ms.push_back(proxyThreadsRun(proxy, iface, n, callsPerThread));
+		std::cout << "typed proxied 2 args with result, " << n << " threads (ms) = " << ms.back() << std::endl;
+	}
+	proxyThreadsCheck("typed proxied", threadCounts, ms, callsPerThread);
+}
+
+
+// runs a script from the benchmark directory with the number of calls as
+// argument and returns its result
+lua_Integer runLuaScript(const char* script, int times)
+{
+	lua_State* L = luaL_newstate();
+	luaL_openlibs(L);
+
+	lua_getglobal(L, "package");
+	lua_pushstring(L, BENCH_BIN "/../lua_module/?.so;" BENCH_BIN "/../lua_module/?.dll");
+	lua_setfield(L, -2, "cpath");
+	lua_pop(L, 1);
+
+	test_functions::resetCounter();
+
+	if (luaL_loadfile(L, (std::string(BENCH_SRC "/") + script).c_str()) != 0) {
+		std::cerr << lua_tostring(L, -1) << std::endl;
+		exit(1);
+	}
+	lua_pushinteger(L, times);
+	if (lua_pcall(L, 1, 1, 0) != 0) {
+		std::cerr << lua_tostring(L, -1) << std::endl;
+		exit(1);
+	}
+	lua_Integer ret = lua_tointeger(L, -1);
+
+	lua_close(L);
+	return ret;
+}
+
+void luaMethodTest()
+{
+	const int luaTimes = 10000000;
+
+	runLuaScript("method_call.lua", luaTimes);
+
+	if (test_functions::getCounter() != 3*luaTimes) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+}
+
+void luaFFITest()
+{
+	const int luaTimes = 10000000;
+
+	const lua_Integer calls = runLuaScript("ffi_call.lua", luaTimes);
+
+	if (test_functions::getCounter() != calls) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+}
+
+void luaTableTest()
+{
+	const int luaTimes = 10000000;
+
+	const lua_Integer calls = runLuaScript("table_call.lua", luaTimes);
+
+	if (test_functions::getCounter() != calls) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+}
+
+
+void luaProxyTest()
+{
+	const int luaTimes = 1000000;
+
+	if (runLuaScript("proxy_call.lua", luaTimes) != luaTimes) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+}
+
+
+void luaAttributeTest()
+{
+	const int luaTimes = 1000000;
+
+	if (runLuaScript("attribute_access.lua", luaTimes) != luaTimes) {
+		std::cerr << "wrong counter" << std::endl;
+		exit(1);
+	}
+}
+
+
+// Loads a library generated by metadata_bench.cmake and calls a method of it
+void metadataLoad(const char* name)
+{
+	const string file = string(BENCH_BIN "/") + name + ".so";
+
+	struct stat st;
+	if (stat(file.c_str(), &st) != 0) {
+		std::cerr << "cannot find " << file << std::endl;
+		exit(1);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+
+	if (!dlopen(file.c_str(), RTLD_NOW | RTLD_GLOBAL)) {
+		std::cerr << dlerror() << std::endl;
+		exit(1);
+	}
+
+	Class clazz = Class::lookup(string(name) + "::Class0");
+	Class::MethodList methods = clazz.findAllMethods([](const Method& m) { return m.name() == "method0"; });
+	VariantValue obj = clazz.constructors().front().call();
+	const int result = methods.front().call(obj, 1).value<int>();
+
+	auto final = std::chrono::steady_clock::now();
+
+	if (result != 1) {
+		std::cerr << "wrong result" << std::endl;
+		exit(1);
+	}
+
+	std::cout << name << " size = " << (st.st_size / 1024) << " KiB, load and first call = "
+			  << std::chrono::duration_cast<std::chrono::microseconds>(final - start).count() << " us" << std::endl;
+}
+
+void metadataTest()
+{
+	metadataLoad("metadata_classic");
+	metadataLoad("metadata_table");
+	metadataLoad("metadata_static");
+}
+
 int main()
 {
 
@@ -2053,5 +2591,38 @@ int main()
 	std::cout << "9 poly args by ref function call:" << std::endl;
 	polyArgRef9Test();
 
+	std::cout << "0 args proxy call:" << std::endl;
+	proxyNoargTest();
+
+	std::cout << "2 args proxy call:" << std::endl;
+	proxyArg2Test();
+
+	std::cout << "2 args proxy call with result:" << std::endl;
+	proxyRet2Test();
+
+	std::cout << "1 struct arg by ref proxy call:" << std::endl;
+	proxyStructArgRef1Test();
+
+	std::cout << (times / 10) << " proxy calls per thread:" << std::endl;
+	proxyThreadsTest();
+
+	std::cout << "10000000 method calls from lua:" << std::endl;
+	luaMethodTest();
+
+	std::cout << "10000000 calls from lua, C API and FFI:" << std::endl;
+	luaFFITest();
+
+	std::cout << "10000000 elements from lua, one call each and in tables:" << std::endl;
+	luaTableTest();
+
+	std::cout << "1000000 proxy calls into lua:" << std::endl;
+	luaProxyTest();
+
+	std::cout << "1000000 reads of 4 attributes from lua:" << std::endl;
+	luaAttributeTest();
+
+	std::cout << "meta-data registered per method, in tables and static:" << std::endl;
+	metadataTest();
+
 	return 0;
 }
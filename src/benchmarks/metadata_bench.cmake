@@ -0,0 +1,62 @@
+# generate_metadata_bench(<file> <namespace> <classes> <methods> <tables>)
+#
+# Writes a translation unit with <classes> classes of <methods> methods each,
+# in <namespace>, and their meta-data as selfportraitc would generate it:
+# one REFL_METHOD per method or, with <tables>, rows of a method table.
+# The methods cycle through a handful of signatures like real code does.
+
+function(generate_metadata_bench FILE NAMESPACE CLASSES METHODS TABLES)
+	if(TABLES)
+		set(ROW "_ROW")
+	else()
+		set(ROW "")
+	endif()
+
+	set(DECLS "")
+	set(REFL "")
+	math(EXPR LAST_CLASS "${CLASSES} - 1")
+	math(EXPR LAST_METHOD "${METHODS} - 1")
+	foreach(I RANGE ${LAST_CLASS})
+		set(DECLS "${DECLS}\tclass Class${I} {\n\tpublic:\n")
+		set(REFL "${REFL}REFL_BEGIN_CLASS(${NAMESPACE}::Class${I})\nREFL_DEFAULT_CONSTRUCTOR()\n")
+		if(TABLES)
+			set(REFL "${REFL}REFL_BEGIN_METHOD_TABLE\n")
+		endif()
+		foreach(J RANGE ${LAST_METHOD})
+			math(EXPR KIND "${J} % 6")
+			if(KIND EQUAL 0)
+				set(DECLS "${DECLS}\t\tint method${J}(int a) { return a + ${J}; }\n")
+				set(REFL "${REFL}REFL_METHOD${ROW}(method${J}, int, int)\n")
+			elseif(KIND EQUAL 1)
+				set(DECLS "${DECLS}\t\tdouble method${J}(double a, int b) const { return a * b + ${J}; }\n")
+				set(REFL "${REFL}REFL_CONST_METHOD${ROW}(method${J}, double, double, int)\n")
+			elseif(KIND EQUAL 2)
+				set(DECLS "${DECLS}\t\tvoid method${J}(const std::string& s) { m_name = s; }\n")
+				set(REFL "${REFL}REFL_METHOD${ROW}(method${J}, void, const std::string&)\n")
+			elseif(KIND EQUAL 3)
+				set(DECLS "${DECLS}\t\tstd::string method${J}() const { return m_name; }\n")
+				set(REFL "${REFL}REFL_CONST_METHOD${ROW}(method${J}, std::string)\n")
+			elseif(KIND EQUAL 4)
+				set(DECLS "${DECLS}\t\tint method${J}(int a, int b, int c) { return a + b + c + ${J}; }\n")
+				set(REFL "${REFL}REFL_METHOD${ROW}(method${J}, int, int, int, int)\n")
+			else()
+				set(DECLS "${DECLS}\t\tstatic int method${J}(int a) { return a * ${J}; }\n")
+				set(REFL "${REFL}REFL_STATIC_METHOD${ROW}(method${J}, int, int)\n")
+			endif()
+		endforeach()
+		set(DECLS "${DECLS}\tprivate:\n\t\tstd::string m_name;\n\t};\n\n")
+		if(TABLES)
+			set(REFL "${REFL}REFL_END_METHOD_TABLE\n")
+		endif()
+		set(REFL "${REFL}REFL_END_CLASS\n\n")
+	endforeach()
+
+	set(CONTENT "#include \"reflection_impl.h\"\n#include <string>\n\nnamespace ${NAMESPACE} {\n\n${DECLS}}\n\n${REFL}")
+	if(EXISTS "${FILE}")
+		file(READ "${FILE}" OLD)
+	endif()
+	# keep the timestamp so that reconfiguring does not rebuild the libraries
+	if(NOT "${OLD}" STREQUAL "${CONTENT}")
+		file(WRITE "${FILE}" "${CONTENT}")
+	endif()
+endfunction()
@@ -0,0 +1,33 @@
+-- Calls reflected methods from Lua, run by the bench executable
+-- with the number of calls as argument
+
+require "libluaselfportrait"
+
+local times = ...
+
+local Methods = Class.lookup("test_functions::Methods")
+local obj = Methods:construct()
+
+local start = os.clock()
+
+for i = 1, times do
+    obj:noargs()
+end
+
+print("lua method 0 args (s) = " .. (os.clock() - start))
+
+start = os.clock()
+
+for i = 1, times do
+    obj:intarg2(i, i)
+end
+
+print("lua method 2 args (s) = " .. (os.clock() - start))
+
+start = os.clock()
+
+for i = 1, times do
+    obj:intret2(i, i)
+end
+
+print("lua method 2 args with result (s) = " .. (os.clock() - start))
@@ -0,0 +1,29 @@
+# generate_templates_bench(<file> <input> <copies>)
+#
+# Writes <input>, parser_data/input/templates.h, scaled up: <copies> copies
+# of it, each in a namespace of its own, so that every copy brings its own
+# class template with its specializations through members, arguments,
+# return values and explicit instantiations. The include guard is kept
+# only once.
+
+function(generate_templates_bench FILE INPUT COPIES)
+	file(READ "${INPUT}" TEMPLATE)
+	string(REGEX REPLACE "#ifndef TEMPLATES_H\n#define TEMPLATES_H\n" "" TEMPLATE "${TEMPLATE}")
+	string(REGEX REPLACE "#endif[ \t\n]*$" "" TEMPLATE "${TEMPLATE}")
+
+	set(CONTENT "#ifndef TEMPLATES_BENCH_H\n#define TEMPLATES_BENCH_H\n")
+	math(EXPR LAST_COPY "${COPIES} - 1")
+	foreach(I RANGE ${LAST_COPY})
+		set(CONTENT "${CONTENT}\nnamespace Copy${I} {\n${TEMPLATE}}\n")
+	endforeach()
+	set(CONTENT "${CONTENT}\n#endif\n")
+
+	# regenerated when the input changes
+	set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${INPUT}")
+	if(EXISTS "${FILE}")
+		file(READ "${FILE}" OLD)
+	endif()
+	if(NOT "${OLD}" STREQUAL "${CONTENT}")
+		file(WRITE "${FILE}" "${CONTENT}")
+	endif()
+endfunction()
@@ -0,0 +1,30 @@
+-- Calls a proxy method implemented in Lua through the C++ stub, run by the
+-- bench executable with the number of calls as argument. Returns the
+-- number of calls the handler received.
+
+require "libluaselfportrait"
+
+local times = ...
+
+local Interface = Class.lookup("test_functions::Interface")
+local intret2 = Interface:findMethod(function(m) return m:name() == "intret2" end)
+
+local proxy = Proxy.create(Interface)
+local calls = 0
+
+proxy:addImplementation(intret2, function(a, b)
+    calls = calls + 1
+    return a + b
+end)
+
+local ref = proxy:reference(Interface)
+
+local start = os.clock()
+
+for i = 1, times do
+    intret2:call(ref, i, i)
+end
+
+print("lua handler 2 args with result (s) = " .. (os.clock() - start))
+
+return calls
@@ -0,0 +1,44 @@
+-- Compares passing elements one call at a time with passing them in
+-- tables converted by a single call, run by the bench executable with the
+-- number of elements as argument. Returns the number of elements counted.
+
+require "libluaselfportrait"
+
+local times = ...
+local tableSize = 1000
+local tableCalls = math.floor(times / tableSize)
+
+local intarg1 = Function.lookup("test_functions::intarg1")
+local vectorArg = Function.lookup("test_functions::vectorArg")
+local structArgRef1 = Function.lookup("test_functions::structArgRef1")
+
+local start = os.clock()
+
+for i = 1, times do
+    intarg1(i)
+end
+
+print("lua function 1 arg per element (s) = " .. (os.clock() - start))
+
+local t = {}
+for i = 1, tableSize do
+    t[i] = i
+end
+
+start = os.clock()
+
+for i = 1, tableCalls do
+    vectorArg(t)
+end
+
+print("lua function table of " .. tableSize .. " elements (s) = " .. (os.clock() - start))
+
+start = os.clock()
+
+for i = 1, tableCalls do
+    structArgRef1({elem1 = i, elem2 = i, elem3 = i, elem4 = i})
+end
+
+print("lua function struct from table (s) = " .. (os.clock() - start))
+
+return 2*times + tableCalls
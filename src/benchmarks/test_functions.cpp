@@ -172,6 +172,52 @@ namespace test_functions {
 		++global_counter;
 	}
 
+	struct InterfaceImpl: public Interface {
+		void noargs() override
+		{
+			++global_counter;
+		}
+		void intarg2(int, int) override
+		{
+			++global_counter;
+		}
+		int intret2(int a, int b) override
+		{
+			++global_counter;
+			return a + b;
+		}
+		void structArgRef1(const TestStruct&) override
+		{
+			++global_counter;
+		}
+	};
+
+	Interface* newInterfaceImpl()
+	{
+		return new InterfaceImpl();
+	}
+
+	void vectorArg(const std::vector<int>& v)
+	{
+		global_counter += v.size();
+	}
+
+	void Methods::noargs()
+	{
+		++global_counter;
+	}
+
+	void Methods::intarg2(int, int)
+	{
+		++global_counter;
+	}
+
+	int Methods::intret2(int a, int b)
+	{
+		++global_counter;
+		return a + b;
+	}
+
 }
 
 REFL_FUNCTION(test_functions::noargs, void)
@@ -214,6 +260,8 @@ REFL_FUNCTION(test_functions::structArgCpy9, void, test_functions::TestStruct, t
 
 REFL_FUNCTION(test_functions::structArgRef1, void, const test_functions::TestStruct &)
 
+REFL_FUNCTION(test_functions::vectorArg, void, const std::vector<int> &)
+
 REFL_FUNCTION(test_functions::structArgRef2, void, const test_functions::TestStruct &, const test_functions::TestStruct &)
 
 REFL_FUNCTION(test_functions::structArgRef3, void, const test_functions::TestStruct &, const test_functions::TestStruct &, const test_functions::TestStruct &)
@@ -273,3 +321,24 @@ REFL_METHOD(foo, void)
 REFL_METHOD(operator=, test_functions::Derived &, const test_functions::Derived &)
 REFL_END_CLASS
 
+REFL_BEGIN_STUB(test_functions::Interface, test_functions__InterfaceStub)
+REFL_STUB_METHOD(test_functions::Interface, intarg2, void, int, int)
+REFL_STUB_METHOD(test_functions::Interface, intret2, int, int, int)
+REFL_STUB_METHOD(test_functions::Interface, noargs, void)
+REFL_STUB_METHOD(test_functions::Interface, structArgRef1, void, const test_functions::TestStruct &)
+REFL_END_STUB
+
+REFL_BEGIN_CLASS(test_functions::Interface)
+REFL_STUB(test_functions__InterfaceStub)
+REFL_METHOD(intarg2, void, int, int)
+REFL_METHOD(intret2, int, int, int)
+REFL_METHOD(noargs, void)
+REFL_METHOD(structArgRef1, void, const test_functions::TestStruct &)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(test_functions::Methods)
+REFL_DEFAULT_CONSTRUCTOR()
+REFL_METHOD(noargs, void)
+REFL_METHOD(intarg2, void, int, int)
+REFL_METHOD(intret2, int, int, int)
+REFL_END_CLASS
@@ -5,6 +5,8 @@
 #ifndef TEST_FUNCTIONS_H
 #define TEST_FUNCTIONS_H
 
+#include <vector>
+
 namespace test_functions {
 
 	long getCounter();
@@ -68,6 +70,28 @@ namespace test_functions {
 	void polyArg7(const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&);
 	void polyArg8(const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&);
 	void polyArg9(const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&, const Base&);
+
+	struct Interface {
+		virtual ~Interface() {}
+
+		virtual void noargs() = 0;
+		virtual void intarg2(int, int) = 0;
+		virtual int intret2(int, int) = 0;
+		virtual void structArgRef1(const TestStruct&) = 0;
+	};
+
+	// plain C++ implementation, the baseline for proxied calls
+	Interface* newInterfaceImpl();
+
+	// Lua tables converted in one call, counts the elements
+	void vectorArg(const std::vector<int>&);
+
+	// reflected methods called from the Lua benchmark
+	struct Methods {
+		void noargs();
+		void intarg2(int, int);
+		int intret2(int, int);
+	};
 }
 
 
@@ -10,6 +10,13 @@
 #include "boost/date_time/posix_time/posix_time.hpp"
 #include "luamodule.h"
 
+#include <cmath>
+#include <cstddef>
+#include <condition_variable>
+#include <cstdint>
+#include <set>
+#include <thread>
+
 namespace SelfPortraitLua {
 
 namespace impl {
@@ -50,10 +57,457 @@ void setExceptionTranslator(std::function<int(lua_State*, lua_CFunction)> f)
 //=====================Definitions==============================================
 
 
+//---------------CallFrame------------------------------------------------------
+
+LuaCallFrame::LuaCallFrame(lua_State* L, int firstArg)
+    : m_L(L)
+    , m_first(firstArg)
+    , m_size(std::max(0, lua_gettop(L) - firstArg + 1))
+    , m_results(0)
+{}
+
+std::size_t LuaCallFrame::size() const
+{
+    return m_size;
+}
+
+CallFrame::Kind LuaCallFrame::kindOf(lua_State* L, int idx)
+{
+    switch (lua_type(L, idx)) {
+        case LUA_TBOOLEAN:
+            return Boolean;
+        case LUA_TNUMBER:
+            return LuaUtils::isinteger(L, idx) ? Integer : Number;
+        case LUA_TSTRING:
+            return String;
+        case LUA_TTABLE:
+            return Table;
+        default:
+            return Other;
+    }
+}
+
+CallFrame::Kind LuaCallFrame::kind(std::size_t i) const
+{
+    return kindOf(m_L, index(i));
+}
+
+bool LuaCallFrame::booleanArg(std::size_t i)
+{
+    return lua_toboolean(m_L, index(i));
+}
+
+long long LuaCallFrame::integerArg(std::size_t i)
+{
+    return lua_tointeger(m_L, index(i));
+}
+
+double LuaCallFrame::numberArg(std::size_t i)
+{
+    return lua_tonumber(m_L, index(i));
+}
+
+const char* LuaCallFrame::stringArg(std::size_t i, std::size_t& length)
+{
+    return lua_tolstring(m_L, index(i), &length);
+}
+
+VariantValue LuaCallFrame::variantArg(std::size_t i)
+{
+    return Lua_Variant::getFromStack(m_L, index(i));
+}
+
+void LuaCallFrame::sequenceArg(std::size_t i, const Elements& f)
+{
+    LuaTableFrame::readSequence(m_L, index(i), f);
+}
+
+void LuaCallFrame::mapArg(std::size_t i, const Elements& f)
+{
+    LuaTableFrame::readMap(m_L, index(i), f);
+}
+
+void LuaCallFrame::pushBoolean(bool b)
+{
+    lua_pushboolean(m_L, b);
+    m_results = 1;
+}
+
+void LuaCallFrame::pushInteger(long long i)
+{
+    lua_pushinteger(m_L, i);
+    m_results = 1;
+}
+
+void LuaCallFrame::pushNumber(double d)
+{
+    lua_pushnumber(m_L, d);
+    m_results = 1;
+}
+
+void LuaCallFrame::pushString(const char* s, std::size_t length)
+{
+    lua_pushlstring(m_L, s, length);
+    m_results = 1;
+}
+
+// pushes nothing for an invalid variant
+static bool pushVariantValue(lua_State* L, VariantValue&& v)
+{
+    if (!v.isValid()) {
+        return false;
+    }
+    Class clazz;
+#ifndef NO_RTTI
+    if (!v.isArithmetical()) {
+        clazz = Class::lookup(v.typeId());
+    }
+#endif
+    Lua_Variant::create(L, clazz, std::move(v));
+    return true;
+}
+
+// attribute values are variants, even arithmetic ones
+static void pushAttributeValue(lua_State* L, VariantValue&& v)
+{
+    Class clazz;
+#ifndef NO_RTTI
+    if (!v.isArithmetical()) {
+        clazz = Class::lookup(v.typeId());
+    }
+#endif
+    Lua_Variant::create(L, clazz, std::move(v));
+}
+
+void LuaCallFrame::pushVariant(VariantValue&& v)
+{
+    if (pushVariantValue(m_L, std::move(v))) {
+        m_results = 1;
+    }
+}
+
+static bool canYield(lua_State* L)
+{
+#if LUA_VERSION_NUM >= 503
+    return lua_isyieldable(L);
+#elif LUA_VERSION_NUM == 502
+    const bool main = lua_pushthread(L);
+    lua_pop(L, 1);
+    return !main;
+#else
+    // LuaJIT and 5.1 cannot continue a C function after a yield
+    return false;
+#endif
+}
+
+void LuaCallFrame::pushPending(Pending&& p)
+{
+    if (!p.wait(0) && canYield(m_L)) {
+        Lua_Future::create(m_L, std::move(p));
+        m_results = yieldResults;
+    } else {
+        CallFrame::pushPending(std::move(p));
+    }
+}
+
+void LuaCallFrame::pushSequence(std::size_t size, const Elements& f)
+{
+    LuaTableFrame::newSequence(m_L, size, f);
+    m_results = 1;
+}
+
+void LuaCallFrame::pushMap(std::size_t size, const Elements& f)
+{
+    LuaTableFrame::newMap(m_L, size, f);
+    m_results = 1;
+}
+
+
+//---------------TableFrame-----------------------------------------------------
+
+static std::size_t tableLength(lua_State* L, int idx)
+{
+#ifdef LUA51
+    return lua_objlen(L, idx);
+#else
+    return lua_rawlen(L, idx);
+#endif
+}
+
+LuaTableFrame::LuaTableFrame(lua_State* L, int table, Mode mode)
+    : m_L(L)
+    , m_table(table)
+    , m_mode(mode)
+    , m_size(mode == Read ? tableLength(L, table) : 0)
+    , m_hasKey(false)
+{}
+
+std::size_t LuaTableFrame::size() const
+{
+    return m_size;
+}
+
+void LuaTableFrame::get(std::size_t i) const
+{
+    lua_rawgeti(m_L, m_table, static_cast<int>(i) + 1);
+}
+
+CallFrame::Kind LuaTableFrame::kind(std::size_t i) const
+{
+    get(i);
+    Kind k = LuaCallFrame::kindOf(m_L, -1);
+    lua_pop(m_L, 1);
+    return k;
+}
+
+bool LuaTableFrame::booleanArg(std::size_t i)
+{
+    get(i);
+    bool b = lua_toboolean(m_L, -1);
+    lua_pop(m_L, 1);
+    return b;
+}
+
+long long LuaTableFrame::integerArg(std::size_t i)
+{
+    get(i);
+    long long n = lua_tointeger(m_L, -1);
+    lua_pop(m_L, 1);
+    return n;
+}
+
+double LuaTableFrame::numberArg(std::size_t i)
+{
+    get(i);
+    double d = lua_tonumber(m_L, -1);
+    lua_pop(m_L, 1);
+    return d;
+}
+
+const char* LuaTableFrame::stringArg(std::size_t i, std::size_t& length)
+{
+    // the table keeps the string alive
+    get(i);
+    const char* s = lua_tolstring(m_L, -1, &length);
+    lua_pop(m_L, 1);
+    return s;
+}
+
+VariantValue LuaTableFrame::variantArg(std::size_t i)
+{
+    get(i);
+    VariantValue v = Lua_Variant::getFromStack(m_L, lua_gettop(m_L));
+    lua_pop(m_L, 1);
+    return v;
+}
+
+void LuaTableFrame::sequenceArg(std::size_t i, const Elements& f)
+{
+    get(i);
+    readSequence(m_L, lua_gettop(m_L), f);
+    lua_pop(m_L, 1);
+}
+
+void LuaTableFrame::mapArg(std::size_t i, const Elements& f)
+{
+    get(i);
+    readMap(m_L, lua_gettop(m_L), f);
+    lua_pop(m_L, 1);
+}
+
+void LuaTableFrame::store()
+{
+    switch (m_mode) {
+        case AppendSequence:
+            lua_rawseti(m_L, m_table, static_cast<int>(++m_size));
+            break;
+        case AppendMap:
+            // the key waits on the stack for its value
+            if (m_hasKey) {
+                lua_rawset(m_L, m_table);
+                ++m_size;
+            }
+            m_hasKey = !m_hasKey;
+            break;
+        default:
+            lua_pop(m_L, 1);
+            throw std::logic_error("cannot push to a table being read");
+    }
+}
+
+void LuaTableFrame::pushBoolean(bool b)
+{
+    lua_pushboolean(m_L, b);
+    store();
+}
+
+void LuaTableFrame::pushInteger(long long i)
+{
+    lua_pushinteger(m_L, i);
+    store();
+}
+
+void LuaTableFrame::pushNumber(double d)
+{
+    lua_pushnumber(m_L, d);
+    store();
+}
+
+void LuaTableFrame::pushString(const char* s, std::size_t length)
+{
+    lua_pushlstring(m_L, s, length);
+    store();
+}
+
+void LuaTableFrame::pushVariant(VariantValue&& v)
+{
+    if (!pushVariantValue(m_L, std::move(v))) {
+        lua_pushnil(m_L);
+    }
+    store();
+}
+
+void LuaTableFrame::pushSequence(std::size_t size, const Elements& f)
+{
+    newSequence(m_L, size, f);
+    store();
+}
+
+void LuaTableFrame::pushMap(std::size_t size, const Elements& f)
+{
+    newMap(m_L, size, f);
+    store();
+}
+
+void LuaTableFrame::readSequence(lua_State* L, int idx, const Elements& f)
+{
+    LuaTableFrame frame(L, idx, Read);
+    f(frame);
+}
+
+void LuaTableFrame::readMap(lua_State* L, int idx, const Elements& f)
+{
+    lua_newtable(L);
+    const int pairs = lua_gettop(L);
+    int n = 0;
+
+    lua_pushnil(L);
+    while (lua_next(L, idx) != 0) {
+        lua_pushvalue(L, -2);
+        lua_rawseti(L, pairs, ++n);
+        lua_rawseti(L, pairs, ++n);
+    }
+
+    LuaTableFrame frame(L, pairs, Read);
+    f(frame);
+    lua_pop(L, 1);
+}
+
+void LuaTableFrame::newSequence(lua_State* L, std::size_t size, const Elements& f)
+{
+    lua_createtable(L, static_cast<int>(size), 0);
+    LuaTableFrame frame(L, lua_gettop(L), AppendSequence);
+    f(frame);
+}
+
+void LuaTableFrame::newMap(lua_State* L, std::size_t size, const Elements& f)
+{
+    lua_createtable(L, 0, static_cast<int>(size));
+    LuaTableFrame frame(L, lua_gettop(L), AppendMap);
+    f(frame);
+}
+
+
+
+//---------------FFI------------------------------------------------------------
+
+const char * LuaFFI::castName = "SelfPortrait.FFICast";
+
+// returns false when the ffi module is missing (any Lua but LuaJIT).
+// The wrappers raise the errors the entries leave in their buffer, and
+// only pass variants as objects: those have marker in their metatable.
+// The FFI returns 64 bit integers and pointers as cdata, the wrappers turn
+// them into numbers (as lua_pushinteger would on LuaJIT) and strings.
+const char * LuaFFI::castChunk =
+    "local ok, ffi = pcall(require, 'ffi')\n"
+    "if not ok then return false end\n"
+    "local types = {}\n"
+    "local buffer = ffi.typeof('char[?]')\n"
+    "local same = function(r) return r end\n"
+    "local results = {\n"
+    "    ['long'] = tonumber,\n"
+    "    ['unsigned long'] = tonumber,\n"
+    "    ['long long'] = tonumber,\n"
+    "    ['unsigned long long'] = tonumber,\n"
+    "    ['const char*'] = function(r) if r ~= nil then return ffi.string(r) end end,\n"
+    "}\n"
+    "return function(decl, f, errorSize, marker)\n"
+    "    local t = types[decl]\n"
+    "    if not t then\n"
+    "        t = ffi.typeof(decl)\n"
+    "        types[decl] = t\n"
+    "    end\n"
+    "    local call = ffi.cast(t, f)\n"
+    "    local err = buffer(errorSize)\n"
+    "    local result = results[decl:match('^(.-) %(%*%)')] or same\n"
+    "    if marker == nil then\n"
+    "        return function(...)\n"
+    "            err[0] = 0\n"
+    "            local r = call(err, ...)\n"
+    "            if err[0] ~= 0 then error(ffi.string(err), 2) end\n"
+    "            return result(r)\n"
+    "        end\n"
+    "    end\n"
+    "    return function(object, ...)\n"
+    "        local mt = type(object) == 'userdata' and getmetatable(object)\n"
+    "        if not mt or not rawget(mt, marker) then\n"
+    "            error('bad argument #1 (Variant expected, got ' .. type(object) .. ')', 2)\n"
+    "        end\n"
+    "        err[0] = 0\n"
+    "        local r = call(err, object, ...)\n"
+    "        if err[0] ~= 0 then error(ffi.string(err), 2) end\n"
+    "        return result(r)\n"
+    "    end\n"
+    "end\n";
+
+bool LuaFFI::push(lua_State* L, const NativeEntry* entry, bool takesObject)
+{
+    if (entry == nullptr) {
+        return false;
+    }
+
+    lua_getfield(L, LUA_REGISTRYINDEX, castName);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        if (luaL_loadstring(L, castChunk) != 0 || lua_pcall(L, 0, 1, 0) != 0) {
+            lua_pop(L, 1);
+            lua_pushboolean(L, false);
+        }
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, castName);
+    }
+    if (!lua_isfunction(L, -1)) {
+        lua_pop(L, 1);
+        return false;
+    }
+    lua_pushstring(L, entry->declaration());
+    lua_pushlightuserdata(L, reinterpret_cast<void*>(entry->function));
+    lua_pushinteger(L, static_cast<lua_Integer>(nativeErrorSize));
+    if (takesObject) {
+        Lua_Variant::pushMarker(L);
+    } else {
+        lua_pushnil(L);
+    }
+    lua_call(L, 4, 1);
+    return true;
+}
+
+
 //---------------Variant--------------------------------------------------------
 
 const char * Lua_Variant::metatableName = "SelfPortraitVariant";
 const char * Lua_Variant::userDataName  = "Variant";
+const char * Lua_Variant::classMetatablesName = "SelfPortrait.VariantClasses";
 MethodTable Lua_Variant::methods;
 
 
@@ -95,6 +549,8 @@ void Lua_Variant::initialize()
 	methods["alignOf"]         = exception_translator<alignOf>;
     methods["ptrToValue"]      = exception_translator<ptrToValue>;
     methods["class"]           = exception_translator<_class>;
+    methods["getAttributes"]   = exception_translator<getAttributes>;
+    methods["setAttributes"]   = exception_translator<setAttributes>;
 }
 
 int Lua_Variant::index(lua_State* L) {
@@ -188,20 +644,20 @@ VariantValue Lua_Variant::getFromStack(lua_State* L, int idx)
 			break;
 		}
 		case LUA_TNUMBER: {
+			if (LuaUtils::isinteger(L, idx)) {
+				return ::std::move(VariantValue( static_cast<std::int64_t>(lua_tointeger(L, idx)) ));
+			}
 			return ::std::move(VariantValue( lua_tonumber(L, idx) ));
 			break;
 		}
 		case LUA_TTABLE: {
-			luaL_error(L, "variant from table not implemented yet");
+			luaL_error(L, "a table can only be passed as a container or a reflected object, not as a variant");
 			break;
 		}
 		case LUA_TUSERDATA: {
 			void *p = lua_touserdata(L, idx);
 			if (p != nullptr) {
-				lua_getmetatable(L, idx);
-				lua_getfield(L, LUA_REGISTRYINDEX, Lua_Variant::metatableName);  /* get correct metatable */
-				if (lua_rawequal(L, -1, -2)) {  /* does it have the correct mt? */
-					lua_pop(L, 2);  /* remove both metatables */
+				if (isUserData(L, idx)) {
 					return ::std::move(reinterpret_cast<Lua_Variant*>(p)->m_variant.createReference());
 				} else {
 					luaL_error(L, "unknown userdata cannot be converted to variant");
@@ -247,7 +703,8 @@ int Lua_Variant::tostring(lua_State* L)
 	Lua_Variant* v = checkUserData(L);
 
 	if (v != nullptr && v->m_variant.isValid()) {
-		lua_pushstring(L, v->m_variant.convertTo<std::string>().c_str());
+		const std::string s = v->m_variant.convertTo<std::string>();
+		lua_pushlstring(L, s.data(), s.size());
 	} else {
 		lua_pushstring(L, "uninitialized variant");
 	}
@@ -258,14 +715,32 @@ int Lua_Variant::tostring(lua_State* L)
 int Lua_Variant::tonumber(lua_State* L)
 {
 	Lua_Variant* v = checkUserData(L);
-	LuaUtils::LuaValue<double>::pushValue(L, v->m_variant.convertTo<double>());
+	if (v->m_variant.isIntegral()) {
+		lua_pushinteger(L, v->m_variant.convertTo<lua_Integer>());
+	} else {
+		LuaUtils::LuaValue<double>::pushValue(L, v->m_variant.convertTo<double>());
+	}
 	return 1;
 }
 
+static bool isIntegerOperand(lua_State* L, int index)
+{
+    if (lua_type(L, index) == LUA_TNUMBER) {
+        return LuaUtils::isinteger(L, index);
+    } else if (Lua_Variant::isUserData(L, index)) {
+        Lua_Variant* v = (Lua_Variant*)lua_touserdata(L, index);
+        return v->wrapped().isIntegral();
+    }
+    return false;
+}
+
 template<typename T = double>
 T getArithOperand(lua_State* L, int index)
 {
     if (lua_type(L, index) == LUA_TNUMBER) {
+        if (std::is_integral<T>::value) {
+            return lua_tointeger(L, index);
+        }
         return lua_tonumber(L, index);
     } else if (Lua_Variant::isUserData(L, index)) {
         Lua_Variant* v = (Lua_Variant*)lua_touserdata(L, index);
@@ -277,21 +752,50 @@ T getArithOperand(lua_State* L, int index)
     }
 }
 
+// like Lua 5.3, arithmetic on two integers yields an integer (except for division)
+// that wraps around on overflow
+static bool integerOperands(lua_State* L)
+{
+    return isIntegerOperand(L, 1) && isIntegerOperand(L, 2);
+}
+
+static lua_Integer wrap(unsigned long long u)
+{
+    return static_cast<lua_Integer>(u);
+}
+
+static unsigned long long getUnsignedOperand(lua_State* L, int index)
+{
+    return static_cast<unsigned long long>(getArithOperand<lua_Integer>(L, index));
+}
+
 int Lua_Variant::add(lua_State* L)
 {
-    lua_pushnumber(L, getArithOperand(L,1)+getArithOperand(L,2));
+    if (integerOperands(L)) {
+        lua_pushinteger(L, wrap(getUnsignedOperand(L,1)+getUnsignedOperand(L,2)));
+    } else {
+        lua_pushnumber(L, getArithOperand(L,1)+getArithOperand(L,2));
+    }
     return 1;
 }
 
 int Lua_Variant::sub(lua_State* L)
 {
-    lua_pushnumber(L, getArithOperand(L,1)-getArithOperand(L,2));
+    if (integerOperands(L)) {
+        lua_pushinteger(L, wrap(getUnsignedOperand(L,1)-getUnsignedOperand(L,2)));
+    } else {
+        lua_pushnumber(L, getArithOperand(L,1)-getArithOperand(L,2));
+    }
     return 1;
 }
 
 int Lua_Variant::mul(lua_State* L)
 {
-    lua_pushnumber(L, getArithOperand(L,1)*getArithOperand(L,2));
+    if (integerOperands(L)) {
+        lua_pushinteger(L, wrap(getUnsignedOperand(L,1)*getUnsignedOperand(L,2)));
+    } else {
+        lua_pushnumber(L, getArithOperand(L,1)*getArithOperand(L,2));
+    }
     return 1;
 }
 
@@ -303,13 +807,36 @@ int Lua_Variant::div(lua_State* L)
 
 int Lua_Variant::mod(lua_State* L)
 {
-    lua_pushnumber(L, getArithOperand<int>(L,1)%getArithOperand<int>(L,2));
+    if (integerOperands(L)) {
+        const lua_Integer d = getArithOperand<lua_Integer>(L,2);
+        if (d == 0) {
+            return luaL_error(L, "attempt to perform 'n%%0'");
+        }
+        // avoids the overflow of LLONG_MIN % -1
+        lua_Integer m = d == -1 ? 0 : getArithOperand<lua_Integer>(L,1) % d;
+        // % truncates, Lua's modulo takes the sign of the divisor
+        if (m != 0 && (m ^ d) < 0) {
+            m += d;
+        }
+        lua_pushinteger(L, m);
+    } else {
+        const double d = getArithOperand(L,2);
+        double m = std::fmod(getArithOperand(L,1), d);
+        if ((m > 0) ? d < 0 : (m < 0 && d != m)) {
+            m += d;
+        }
+        lua_pushnumber(L, m);
+    }
     return 1;
 }
 
 int Lua_Variant::unm(lua_State* L)
 {
-    lua_pushnumber(L, -getArithOperand(L,1));
+    if (isIntegerOperand(L, 1)) {
+        lua_pushinteger(L, wrap(0ull - getUnsignedOperand(L,1)));
+    } else {
+        lua_pushnumber(L, -getArithOperand(L,1));
+    }
     return 1;
 }
 
@@ -383,56 +910,409 @@ int Lua_Variant::ptrToValue(lua_State* L)
     LuaUtils::LuaValue<size_t>::pushValue(L, reinterpret_cast<size_t>(v->m_variant.ptrToValue()));
     return 1;
 }
-int Lua_Variant::method_stub(lua_State* L)
+namespace {
+
+    /* Heuristic: usally when there are two methods that differ only in constness and return types,
+     * they return a reference or a const reference. Choosing the method that returns the const
+     * reference seems to be a reasonable default
+     */
+    Method selectOverload(const Class::MethodList& methods)
+    {
+        if (methods.size() == 1) {
+            return methods.front();
+        } else if (methods.size() == 2) {
+            auto it = methods.begin();
+            const Method& m1 = *it++;
+            const Method& m2 = *it;
+            if ((m1.isConst() && !m2.isConst()) || (!m1.isConst() && m2.isConst())) {
+                const Method& mc = m2.isConst() ? m2 : m1;
+#ifndef NO_RTTI
+                if (m1.argumentTypes() == m2.argumentTypes()) {
+                    return mc;
+                }
+#else
+                if (m1.argumentSpellings() == m2.argumentSpellings()) {
+                    return mc;
+                }
+#endif
+            }
+        }
+        return Method();
+    }
+
+    // the non-static methods of a class with the same name, resolved by number of arguments
+    struct OverloadSet {
+        Class clazz;
+        string name;
+        std::vector<Method> byArity;
+        std::vector<size_t> candidates;
+        // the method when the name is not overloaded
+        Method single;
+    };
+
+    struct ClassMetadata {
+        std::map<string, OverloadSet> overloads;
+        // the attributes found by name, base class attributes hidden by the class' own are left out
+        std::vector<Attribute> attributes;
+    };
+
+    // key of the table of attribute slots in a class metatable, name -> const Attribute*
+    const char attributeSlotsKey = 0;
+
+    /* Built once per class for the whole process and never modified afterwards,
+     * the metatables of every lua_State point into it.
+     */
+    const ClassMetadata& classMetadata(const Class& c)
+    {
+        static std::mutex mutex;
+        static std::unordered_map<Class, std::unique_ptr<const ClassMetadata>> cache;
+
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = cache.find(c);
+        if (it != cache.end()) {
+            return *it->second;
+        }
+
+        std::map<string, Class::MethodList> byName;
+        for (const Method& m: c.methods()) {
+            Class::MethodList& overloads = byName[m.name()];
+            if (!m.isStatic()) {
+                overloads.push_back(m);
+            }
+        }
+
+        std::unique_ptr<ClassMetadata> metadata(new ClassMetadata);
+        for (auto& entry: byName) {
+            OverloadSet& set = metadata->overloads[entry.first];
+            set.clazz = c;
+            set.name = entry.first;
+            if (entry.second.size() == 1) {
+                set.single = entry.second.front();
+            }
+
+            for (const Method& m: entry.second) {
+                const size_t numArgs = m.numberOfArguments();
+                if (set.candidates.size() <= numArgs) {
+                    set.candidates.resize(numArgs+1);
+                }
+                ++set.candidates[numArgs];
+            }
+            set.byArity.resize(set.candidates.size());
+            for (size_t i = 0; i < set.candidates.size(); ++i) {
+                if (set.candidates[i] > 0) {
+                    set.byArity[i] = selectOverload(c.findAllMethods([&](const Method& m){
+                        return m.name() == entry.first && m.numberOfArguments() == i && !m.isStatic();
+                    }));
+                }
+            }
+        }
+
+        std::set<string> names;
+        for (const Attribute& a: c.attributes()) {
+            if (names.insert(a.name()).second) {
+                metadata->attributes.push_back(a);
+            }
+        }
+
+        return *cache.emplace(c, std::move(metadata)).first->second;
+    }
+
+}
+
+int Lua_Variant::method_stub(lua_State* L)
+{
+    Lua_Class& c = *Lua_Class::checkUserData(L, lua_upvalueindex(1));
+    const string name = luaL_checkstring(L, lua_upvalueindex(2));
+    const size_t numArgs = lua_gettop(L) - 1;
+
+    auto methods = c.wrapped().findAllMethods([&](const Method& m){ return m.name() == name && m.numberOfArguments() == numArgs && !m.isStatic();});
+
+    Method m;
+    if (methods.size() == 0) {
+        luaL_error(L, strconv::fmt_str("Class %1 has no method named %2", c.wrapped().fullyQualifiedName(), name).c_str());
+    } else {
+        m = selectOverload(methods);
+        if (!m.isValid()) {
+            luaL_error(L, strconv::fmt_str("Class %1 has more than one method named %2 with %3 arguments", c.wrapped().fullyQualifiedName(), name, numArgs).c_str());
+        }
+    }
+
+    return Lua_Method::callAndPush(L, m, 1);
+}
+
+int Lua_Variant::overload_stub(lua_State* L)
+{
+    const OverloadSet& set = *reinterpret_cast<const OverloadSet*>(lua_touserdata(L, lua_upvalueindex(1)));
+    const size_t numArgs = lua_gettop(L) - 1;
+
+    if (numArgs < set.byArity.size()) {
+        const Method& m = set.byArity[numArgs];
+        if (m.isValid()) {
+            return Lua_Method::callAndPush(L, m, 1);
+        } else if (set.candidates[numArgs] > 1) {
+            luaL_error(L, strconv::fmt_str("Class %1 has more than one method named %2 with %3 arguments", set.clazz.fullyQualifiedName(), set.name, numArgs).c_str());
+        }
+    }
+    luaL_error(L, strconv::fmt_str("Class %1 has no method named %2", set.clazz.fullyQualifiedName(), set.name).c_str());
+    return 0;
+}
+
+// the attribute named by the value on top of the stack, popped
+static const Attribute* popAttributeSlot(lua_State* L, int slots)
+{
+    lua_rawget(L, slots);
+    const Attribute* attr = static_cast<const Attribute*>(lua_touserdata(L, -1));
+    lua_pop(L, 1);
+    return attr;
+}
+
+// for error messages, without converting the key in place
+static string keyName(lua_State* L, int idx)
+{
+    return lua_type(L, idx) == LUA_TSTRING ? lua_tostring(L, idx) : lua_typename(L, lua_type(L, idx));
+}
+
+// pushes the attribute slots of the class of the variant at idx
+static void pushAttributeSlots(lua_State* L, int idx)
+{
+    if (lua_getmetatable(L, idx)) {
+        lua_pushlightuserdata(L, const_cast<char*>(&attributeSlotsKey));
+        lua_rawget(L, -2);
+        lua_remove(L, -2);
+    } else {
+        lua_pushnil(L);
+    }
+    if (lua_isnil(L, -1)) {
+        // no reflected class, so no attribute
+        lua_pop(L, 1);
+        lua_newtable(L);
+    }
+}
+
+int Lua_Variant::class_index(lua_State* L)
+{
+    lua_pushvalue(L, 2);
+    lua_rawget(L, lua_upvalueindex(1));
+    if (!lua_isnil(L, -1)) {
+        return 1;
+    }
+    lua_pop(L, 1);
+
+    lua_pushvalue(L, 2);
+    if (const Attribute* attr = popAttributeSlot(L, lua_upvalueindex(2))) {
+        VariantValue obj = getFromStack(L, 1);
+        pushAttributeValue(L, attr->get(obj));
+        return 1;
+    }
+    return index(L);
+}
+
+int Lua_Variant::class_newindex(lua_State* L)
+{
+    lua_pushvalue(L, 2);
+    if (const Attribute* attr = popAttributeSlot(L, lua_upvalueindex(1))) {
+        VariantValue obj = getFromStack(L, 1);
+        attr->set(obj, getFromStack(L, 3));
+        return 0;
+    }
+    return newindex(L);
+}
+
+int Lua_Variant::getAttributes(lua_State* L)
+{
+    checkUserData(L);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    const int n = static_cast<int>(tableLength(L, 2));
+    luaL_checkstack(L, n + 2, "too many attributes");
+
+    pushAttributeSlots(L, 1);
+    const int slots = lua_gettop(L);
+    VariantValue obj = getFromStack(L, 1);
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 2, i);
+        const Attribute* attr = popAttributeSlot(L, slots);
+        if (attr == nullptr) {
+            lua_rawgeti(L, 2, i);
+            throw std::runtime_error(strconv::fmt_str("class has no property %1", keyName(L, -1)));
+        }
+        pushAttributeValue(L, attr->get(obj));
+    }
+    return n;
+}
+
+int Lua_Variant::setAttributes(lua_State* L)
+{
+    checkUserData(L);
+    luaL_checktype(L, 2, LUA_TTABLE);
+    lua_settop(L, 2);
+
+    pushAttributeSlots(L, 1);
+    const int slots = lua_gettop(L);
+    VariantValue obj = getFromStack(L, 1);
+
+    lua_pushnil(L);
+    while (lua_next(L, 2) != 0) {
+        lua_pushvalue(L, -2);
+        const Attribute* attr = popAttributeSlot(L, slots);
+        if (attr == nullptr) {
+            throw std::runtime_error(strconv::fmt_str("class has no property %1", keyName(L, -2)));
+        }
+        attr->set(obj, getFromStack(L, -1));
+        lua_pop(L, 1);
+    }
+    return 0;
+}
+
+int Lua_Variant::no_property(lua_State* L)
+{
+    luaL_error(L, "class has no property %s\n", luaL_checkstring(L, 2));
+    return 0;
+}
+
+void Lua_Variant::_register(lua_State* L)
+{
+    // the FFI passes the address of the userdata as the variant of the object.
+    // Lua_Variant is not standard-layout, but offsetof works for classes without virtual bases
+#ifdef __GNUC__
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Winvalid-offsetof"
+#endif
+    static_assert(offsetof(Lua_Variant, m_variant) == 0, "the variant must be at the start of the userdata");
+#ifdef __GNUC__
+#pragma GCC diagnostic pop
+#endif
+
+    LuaAdapter<Lua_Variant>::_register(L);
+
+    // every variant metatable carries this key, see isUserData
+    luaL_getmetatable(L, metatableName);
+    lua_pushlightuserdata(L, &metatableName);
+    lua_pushboolean(L, 1);
+    lua_rawset(L, -3);
+    lua_pop(L, 1);
+}
+
+void Lua_Variant::pushMarker(lua_State* L)
+{
+    lua_pushlightuserdata(L, &metatableName);
+}
+
+bool Lua_Variant::isUserData(lua_State* L, int pos)
+{
+    bool found = false;
+    if (lua_touserdata(L, pos) != nullptr && lua_getmetatable(L, pos)) {
+        lua_pushlightuserdata(L, &metatableName);
+        lua_rawget(L, -2);
+        found = lua_toboolean(L, -1);
+        lua_pop(L, 2);
+    }
+    return found;
+}
+
+Lua_Variant* Lua_Variant::checkUserData(lua_State* L, int pos)
+{
+    if (isUserData(L, pos)) {
+        return reinterpret_cast<Lua_Variant*>(lua_touserdata(L, pos));
+    }
+    return reinterpret_cast<Lua_Variant*>(luaL_checkudata(L, pos, metatableName));
+}
+
+void Lua_Variant::pushMetatable(lua_State* L, const Class& c)
+{
+    if (!c.isValid()) {
+        luaL_getmetatable(L, metatableName);
+        return;
+    }
+
+    lua_getfield(L, LUA_REGISTRYINDEX, classMetatablesName);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        lua_newtable(L);
+        lua_pushvalue(L, -1);
+        lua_setfield(L, LUA_REGISTRYINDEX, classMetatablesName);
+    }
+
+    void* key = reinterpret_cast<void*>(std::hash<Class>()(c));
+    lua_pushlightuserdata(L, key);
+    lua_rawget(L, -2);
+    if (lua_isnil(L, -1)) {
+        lua_pop(L, 1);
+        buildClassMetatable(L, c);
+        lua_pushlightuserdata(L, key);
+        lua_pushvalue(L, -2);
+        lua_rawset(L, -4);
+    }
+    lua_remove(L, -2);
+}
+
+void Lua_Variant::buildClassMetatable(lua_State* L, const Class& c)
 {
-    Lua_Class& c = *Lua_Class::checkUserData(L, lua_upvalueindex(1));
-    const string name = luaL_checkstring(L, lua_upvalueindex(2));
-    const size_t numArgs = lua_gettop(L) - 1;
+    lua_newtable(L);
 
-    auto methods = c.wrapped().findAllMethods([&](const Method& m){ return m.name() == name && m.numberOfArguments() == numArgs && !m.isStatic();});
+    // same metamethods as the plain variants
+    luaL_getmetatable(L, metatableName);
+    lua_pushnil(L);
+    while (lua_next(L, -2) != 0) {
+        lua_pushvalue(L, -2);
+        lua_insert(L, -2);
+        lua_rawset(L, -5);
+    }
+    lua_pop(L, 1);
 
-    Method m;
-    if (methods.size() == 0) {
-        luaL_error(L, strconv::fmt_str("Class %1 has no method named %2", c.wrapped().fullyQualifiedName(), name).c_str());
-    } else if (methods.size() > 1) {
-        if (methods.size() == 2) {
-            /* Heuristic: usally when there are two methods that differ only in constness and return types,
-             * they return a reference or a const reference. Choosing the method that returns the const
-             * reference seems to be a reasonable default
-             */
-            auto it = methods.begin();
-            Method& m1 = *it++;
-            Method& m2 = *it;
-            if ((m1.isConst() && !m2.isConst()) || (!m1.isConst() && m2.isConst())) {
-                Method mc = m1;
-                if (m2.isConst()) {
-                    mc = m2;
-                }
-#ifndef NO_RTTI
-                if (m1.argumentTypes() == m2.argumentTypes()) {
-                    m = mc;
-                }
-#else
-                if (m1.argumentSpellings() == m2.argumentSpellings()) {
-                    m = mc;
-                }
-#endif
-            }
-        }
-        if (!m.isValid()) {
-            luaL_error(L, strconv::fmt_str("Class %1 has more than one method named %2 with %3 arguments", c.wrapped().fullyQualifiedName(), name, numArgs).c_str());
+    const ClassMetadata& metadata = classMetadata(c);
+
+    // attribute slots, shared by __index, __newindex and the bulk accessors
+    lua_createtable(L, 0, static_cast<int>(metadata.attributes.size()));
+    for (const Attribute& a: metadata.attributes) {
+        lua_pushlightuserdata(L, const_cast<Attribute*>(&a));
+        lua_setfield(L, -2, a.name().c_str());
+    }
+    lua_pushlightuserdata(L, const_cast<char*>(&attributeSlotsKey));
+    lua_pushvalue(L, -2);
+    lua_rawset(L, -4);
+
+    if (!metadata.attributes.empty()) {
+        lua_pushvalue(L, -1);
+        lua_pushcclosure(L, exception_translator<class_newindex>, 1);
+        lua_setfield(L, -3, "__newindex");
+    }
+
+    // one closure per method name, overloads are resolved once per arity
+    lua_newtable(L);
+    for (auto& entry: metadata.overloads) {
+        const OverloadSet& set = entry.second;
+#ifdef LUA_FFI
+        // the JIT can compile calls through FFI function pointers
+        if (set.single.isValid() && LuaFFI::push(L, set.single.nativeEntry(), true)) {
+            lua_setfield(L, -2, entry.first.c_str());
+            continue;
         }
-    } else {
-        m = methods.front();
+#endif
+        lua_pushlightuserdata(L, const_cast<OverloadSet*>(&set));
+        lua_pushcclosure(L, exception_translator<overload_stub>, 1);
+        lua_setfield(L, -2, entry.first.c_str());
     }
 
-    Lua_Method::create(L, m);
-    for (size_t i = 1; i <= numArgs+1; ++i) {
-        lua_pushvalue(L, 1);
-        lua_remove(L, 1);
+    // the builtin methods take precedence, as in index
+    for (auto& entry: methods) {
+        lua_pushcfunction(L, entry.second);
+        lua_setfield(L, -2, entry.first.c_str());
     }
 
-    return Lua_Method::call(L);
+    if (metadata.attributes.empty()) {
+        // plain table lookup, missing keys still raise an error
+        lua_newtable(L);
+        lua_pushcfunction(L, exception_translator<no_property>);
+        lua_setfield(L, -2, "__index");
+        lua_setmetatable(L, -2);
+        lua_remove(L, -2);
+    } else {
+        lua_insert(L, -2);
+        lua_pushcclosure(L, exception_translator<class_index>, 2);
+    }
+    lua_setfield(L, -2, "__index");
 }
 
 
@@ -475,6 +1355,7 @@ void Lua_Class::initialize()
 	methods["findAllMethods"]      = exception_translator<findAllMethods>;
 	methods["findSuperClass"]      = exception_translator<findSuperClass>;
 	methods["findAllSuperClasses"] = exception_translator<findAllSuperClasses>;
+	methods["attributeAccessor"]   = exception_translator<attributeAccessor>;
 }
 
 int Lua_Class::lookup(lua_State* L)
@@ -529,6 +1410,31 @@ int Lua_Class::castUp(lua_State* L)
     return 1;
 }
 
+int Lua_Class::attributeAccessor(lua_State* L)
+{
+    Lua_Class* c = checkUserData(L, 1);
+    luaL_checktype(L, 2, LUA_TTABLE);
+
+    const int n = static_cast<int>(tableLength(L, 2));
+    std::vector<Attribute> attributes;
+    attributes.reserve(n);
+
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 2, i);
+        const string name = luaL_checkstring(L, -1);
+        lua_pop(L, 1);
+
+        Attribute attr = c->m_class.findAttribute([&](const Attribute& a){ return a.name() == name; });
+        if (!attr.isValid()) {
+            throw std::runtime_error(strconv::fmt_str("class %1 has no property %2", c->m_class.fullyQualifiedName(), name));
+        }
+        attributes.push_back(attr);
+    }
+
+    Lua_AttributeAccessor::create(L, std::move(attributes));
+    return 1;
+}
+
 int Lua_Class::isInterface(lua_State* L)
 {
 	Lua_Class* c = checkUserData(L);
@@ -779,6 +1685,7 @@ void Lua_Method::initialize()
 	methods["isVolatile"]        = exception_translator<isVolatile>;
 	methods["isStatic"]          = exception_translator<isStatic>;
 	methods["getClass"]          = exception_translator<getClass>;
+	methods["ffi"]               = exception_translator<ffi>;
 }
 
 int Lua_Method::name(lua_State* L)
@@ -837,45 +1744,42 @@ int Lua_Method::isStatic(lua_State* L)
 	return 1;
 }
 
+int Lua_Method::ffi(lua_State* L)
+{
+	Lua_Method* c = checkUserData(L);
+	if (!LuaFFI::push(L, c->m_method.nativeEntry(), !c->m_method.isStatic())) {
+		lua_pushnil(L);
+	}
+	return 1;
+}
+
 
 int Lua_Method::call(lua_State* L)
 {
 	Lua_Method* m = checkUserData(L);
-    ArgArray args;
 
-	VariantValue obj;
+	if (!m->m_method.isStatic() && lua_gettop(L) <= 1) {
+		luaL_error(L, "cannot call non-static member function without object");
+	}
 
-	int n = lua_gettop(L);
+	return callAndPush(L, m->m_method, 2);
+}
 
-	int begin = 2;
+int Lua_Method::callAndPush(lua_State* L, const Method& m, int firstArg)
+{
+	VariantValue obj;
 
-	if (!m->m_method.isStatic()) {
-		if (n <= 1) {
-			luaL_error(L, "cannot call non-static member function without object");
-		}
-		obj = Lua_Variant::getFromStack(L, begin++);
-	}
+	int begin = firstArg;
 
-    for (int i = begin; i <= n; ++i) {
-		args.push_back(Lua_Variant::getFromStack(L, i));
+	if (!m.isStatic()) {
+		obj = Lua_Variant::getFromStack(L, begin++);
 	}
 
-	VariantValue ret;
+	LuaCallFrame frame(L, begin);
 
-	ret = m->m_method.callArgArray(obj, args); // if the method is static, it ignores the first arg
+	m.callFrame(obj, frame); // if the method is static, it ignores the object
 
-	if (ret.isValid()) {
-        Class clazz;
-#ifndef NO_RTTI
-        if (!ret.isArithmetical()) {
-            clazz = Class::lookup(ret.typeId());
-        }
-#endif
-        Lua_Variant::create(L, clazz, std::move(ret));
-		return 1;
-	} else {
-		return 0;
-	}
+	return frame.results();
 }
 
 
@@ -992,14 +1896,7 @@ int Lua_Attribute::get(lua_State* L)
 		obj = Lua_Variant::getFromStack(L, 2);
 	}
 
-	VariantValue ret = c->m_attribute.get(obj);
-    Class clazz;
-#ifndef NO_RTTI
-    if (!ret.isArithmetical()) {
-        clazz = Class::lookup(ret.typeId());
-    }
-#endif
-    Lua_Variant::create(L, clazz, std::move(ret));
+	pushAttributeValue(L, c->m_attribute.get(obj));
 
 	return 1;
 }
@@ -1061,6 +1958,78 @@ int Lua_Attribute::getClass(lua_State* L)
 	return 1;
 }
 
+//---------------AttributeAccessor----------------------------------------------
+
+const char * Lua_AttributeAccessor::metatableName = "SelfPortrait.AttributeAccessor";
+const char * Lua_AttributeAccessor::userDataName  = "AttributeAccessor";
+
+MethodTable Lua_AttributeAccessor::methods;
+
+const struct luaL_Reg Lua_AttributeAccessor::lib_f[] = {
+	{ NULL, NULL }
+};
+
+void Lua_AttributeAccessor::initialize()
+{
+	methods["get"]   = exception_translator<get>;
+	methods["set"]   = exception_translator<set>;
+	methods["names"] = exception_translator<names>;
+}
+
+void Lua_AttributeAccessor::_register(lua_State* L)
+{
+    LuaAdapter<Lua_AttributeAccessor>::_register(L);
+
+    // accessors are used in loops, their methods are a plain table lookup
+    luaL_getmetatable(L, metatableName);
+    lua_newtable(L);
+    for (auto& entry: methods) {
+        lua_pushcfunction(L, entry.second);
+        lua_setfield(L, -2, entry.first.c_str());
+    }
+    lua_setfield(L, -2, "__index");
+    lua_pop(L, 1);
+}
+
+int Lua_AttributeAccessor::get(lua_State* L)
+{
+	Lua_AttributeAccessor* a = checkUserData(L);
+	VariantValue obj = Lua_Variant::getFromStack(L, 2);
+
+	const int n = static_cast<int>(a->m_attributes.size());
+	luaL_checkstack(L, n, "too many attributes");
+
+	for (const Attribute& attr: a->m_attributes) {
+		pushAttributeValue(L, attr.get(obj));
+	}
+	return n;
+}
+
+int Lua_AttributeAccessor::set(lua_State* L)
+{
+	Lua_AttributeAccessor* a = checkUserData(L);
+	VariantValue obj = Lua_Variant::getFromStack(L, 2);
+
+	const int n = std::min(lua_gettop(L) - 2, static_cast<int>(a->m_attributes.size()));
+	for (int i = 0; i < n; ++i) {
+		a->m_attributes[i].set(obj, Lua_Variant::getFromStack(L, i + 3));
+	}
+	return 0;
+}
+
+int Lua_AttributeAccessor::names(lua_State* L)
+{
+	Lua_AttributeAccessor* a = checkUserData(L);
+
+	lua_createtable(L, a->m_attributes.size(), 0);
+	int i = 0;
+	for (const Attribute& attr: a->m_attributes) {
+		lua_pushstring(L, attr.name().c_str());
+		lua_rawseti(L, -2, ++i);
+	}
+	return 1;
+}
+
 //---------------Function-------------------------------------------------------
 
 const char * Lua_Function::metatableName = "SelfPortrait.Function";
@@ -1069,6 +2038,8 @@ MethodTable Lua_Function::methods;
 
 const struct luaL_Reg Lua_Function::lib_f[] = {
 	{ "lookup", exception_translator<lookup> },
+	{ "lookupNamespace", exception_translator<lookupNamespace> },
+	{ "invoke", exception_translator<invoke> },
 	{ NULL, NULL }
 };
 
@@ -1088,6 +2059,7 @@ void Lua_Function::initialize()
 	methods["numberOfArguments"] = exception_translator<numberOfArguments>;
 	methods["returnSpelling"]    = exception_translator<returnSpelling>;
 	methods["argumentSpellings"] = exception_translator<argumentSpellings>;
+	methods["ffi"]               = exception_translator<ffi>;
 }
 
 int Lua_Function::name(lua_State* L)
@@ -1100,32 +2072,16 @@ int Lua_Function::name(lua_State* L)
 int Lua_Function::call(lua_State* L)
 {
 	Lua_Function* f = checkUserData(L);
-    ArgArray args;
-
-
-	int n = lua_gettop(L);
-
-	for (int i = 2; i <= n; ++i) {
-		args.push_back(Lua_Variant::getFromStack(L, i));
-	}
-
-	VariantValue ret;
+	return callAndPush(L, f->m_function, 2);
+}
 
-	ret = f->m_function.callArgArray(args);
+int Lua_Function::callAndPush(lua_State* L, const Function& f, int firstArg)
+{
+	LuaCallFrame frame(L, firstArg);
 
-	if (ret.isValid()) {
+	f.callFrame(frame);
 
-        Class clazz;
-#ifndef NO_RTTI
-        if (!ret.isArithmetical()) {
-            clazz = Class::lookup(ret.typeId());
-        }
-#endif
-        Lua_Variant::create(L, clazz, std::move(ret));
-		return 1;
-	} else {
-		return 0;
-	}
+	return frame.results();
 }
 
 int Lua_Function::numberOfArguments(lua_State* L)
@@ -1149,6 +2105,15 @@ int Lua_Function::argumentSpellings(lua_State* L)
 	return 1;
 }
 
+int Lua_Function::ffi(lua_State* L)
+{
+	Lua_Function* c = checkUserData(L);
+	if (!LuaFFI::push(L, c->m_function.nativeEntry(), false)) {
+		lua_pushnil(L);
+	}
+	return 1;
+}
+
 
 int Lua_Function::lookup(lua_State* L)
 {
@@ -1174,6 +2139,41 @@ int Lua_Function::lookup(lua_State* L)
 	return 1;
 }
 
+int Lua_Function::lookupNamespace(lua_State* L)
+{
+	const char * ns = luaL_checkstring(L, 1);
+
+	Function::FunctionList l = Function::findNamespaceFunctions(ns);
+
+	lua_createtable(L, l.size(), 0);
+	int i = 0;
+	for (auto it = l.begin(); it != l.end(); ++it) {
+		Lua_Function::create(L, *it);
+		lua_rawseti(L, -2, ++i);
+	}
+	return 1;
+}
+
+int Lua_Function::invoke(lua_State* L)
+{
+	size_t length = 0;
+	const char * name = luaL_checklstring(L, 1, &length);
+
+	luaL_argcheck(L, name && (length > 0), 1, "empty function name");
+
+	const std::size_t numArgs = lua_gettop(L) - 1;
+
+	const Function::FunctionList r = Function::findFunctions(name, numArgs);
+
+	if (r.empty()) {
+		luaL_error(L, strconv::fmt_str("No function named %1 with %2 arguments", name, numArgs).c_str());
+	} else if (r.size() > 1) {
+		luaL_error(L, strconv::fmt_str("More than one function named %1 with %2 arguments", name, numArgs).c_str());
+	}
+
+	return callAndPush(L, r.front(), 2);
+}
+
 //---------------Proxy----------------------------------------------------------
 
 const char * Lua_Proxy::metatableName = "SelfPortrait.Proxy";
@@ -1238,26 +2238,78 @@ int Lua_Proxy::interfaces(lua_State* L)
 }
 
 
+static int refTraceBack(lua_State* L)
+{
+    if (LuaUtils::pushTraceBack(L) == 0) {
+        return LUA_NOREF;
+    }
+    return luaL_ref(L, LUA_REGISTRYINDEX);
+}
+
+LuaClosureWrapper::LuaClosureWrapper(lua_State* ls, int index)
+    : L(ls)
+    , ss(new shared_state(index, refTraceBack(ls)), deleter{ls})
+{}
+
 void LuaClosureWrapper::deleter::operator()(shared_state* s) const {
     luaL_unref(L, LUA_REGISTRYINDEX, s->envIndex);
+    luaL_unref(L, LUA_REGISTRYINDEX, s->errorHandler);
     delete s;
 }
 
+void LuaClosureWrapper::pushArg(std::size_t i, const VariantValue& v) const
+{
+    if (v.isIntegral()) {
+#ifndef NO_RTTI
+        if (v.typeId() == typeid(bool)) {
+            lua_pushboolean(L, v.convertTo<bool>());
+            return;
+        }
+#endif
+        lua_pushinteger(L, static_cast<lua_Integer>(v.convertTo<long long>()));
+        return;
+    }
+    if (v.isFloatingPoint()) {
+        lua_pushnumber(L, v.convertTo<double>());
+        return;
+    }
+    if (v.isStdString()) {
+        StringRef s = v.convertTo<StringRef>();
+        lua_pushlstring(L, s.data(), s.size());
+        return;
+    }
+
+    Class clazz;
+#ifndef NO_RTTI
+    if (v.isValid()) {
+        // proxy methods are called with the same types over and over
+        if (ss->argClasses.size() <= i) {
+            ss->argClasses.resize(i + 1, std::make_pair(nullptr, Class()));
+        }
+        std::pair<const std::type_info*, Class>& cached = ss->argClasses[i];
+        if (cached.first != &v.typeId()) {
+            cached.first = &v.typeId();
+            cached.second = Class::lookup(v.typeId());
+        }
+        clazz = cached.second;
+    }
+#endif
+    Lua_Variant::create(L, clazz, v);
+}
+
 VariantValue LuaClosureWrapper::operator()(const ArgArray& vargs) const {
 
-    const int errIndex = LuaUtils::pushTraceBack(L);
+    int errIndex = 0;
+    if (ss->errorHandler != LUA_NOREF) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, ss->errorHandler);
+        errIndex = lua_gettop(L);
+    }
 
     lua_rawgeti(L, LUA_REGISTRYINDEX, ss->envIndex);
     luaL_checktype(L, -1, LUA_TFUNCTION);
 
-    for(const VariantValue& v: vargs) {
-        Class clazz;
-#ifndef NO_RTTI
-        if (!v.isArithmetical()) {
-            clazz = Class::lookup(v.typeId());
-        }
-#endif
-        Lua_Variant::create(L, clazz, std::move(v));
+    for (std::size_t i = 0; i < vargs.size(); ++i) {
+        pushArg(i, vargs[i]);
     }
 
     if (lua_pcall(L, vargs.size(), 1, errIndex) != 0) {
@@ -1314,6 +2366,201 @@ int Lua_Proxy::reference(lua_State* L)
 }
 
 
+//---------------Future---------------------------------------------------------
+
+const char * Lua_Future::metatableName = "SelfPortrait.Future";
+const char * Lua_Future::userDataName  = "Future";
+MethodTable Lua_Future::methods;
+
+// receives the library table, the metatable of the futures and waitAny.
+// A failing task leaves the others queued for the next run
+const char * Lua_Future::loopChunk =
+    "local Future, metatable, waitAny = ...\n"
+    "local tasks = {}\n"
+    "local function step(co, ...)\n"
+    "    local ok, pending = coroutine.resume(co, ...)\n"
+    "    if not ok then error(pending, 0) end\n"
+    "    if coroutine.status(co) == 'suspended' then\n"
+    "        if getmetatable(pending) ~= metatable then\n"
+    "            error('a task can only yield a Future', 0)\n"
+    "        end\n"
+    "        tasks[#tasks + 1] = { co, pending }\n"
+    "    end\n"
+    "end\n"
+    "function Future.spawn(f, ...)\n"
+    "    step(coroutine.create(f), ...)\n"
+    "end\n"
+    "function Future.run()\n"
+    "    while #tasks > 0 do\n"
+    "        local waiting, resumed = tasks, false\n"
+    "        tasks = {}\n"
+    "        for i, t in ipairs(waiting) do\n"
+    "            if t[2]:ready() then\n"
+    "                resumed = true\n"
+    "                local ok, err = pcall(step, t[1])\n"
+    "                if not ok then\n"
+    "                    for j = i + 1, #waiting do\n"
+    "                        tasks[#tasks + 1] = waiting[j]\n"
+    "                    end\n"
+    "                    error(err, 0)\n"
+    "                end\n"
+    "            else\n"
+    "                tasks[#tasks + 1] = t\n"
+    "            end\n"
+    "        end\n"
+    "        if not resumed and #tasks > 0 then\n"
+    "            local futures = {}\n"
+    "            for i, t in ipairs(tasks) do\n"
+    "                futures[i] = t[2]\n"
+    "            end\n"
+    "            waitAny(futures)\n"
+    "        end\n"
+    "    end\n"
+    "end\n";
+
+const struct luaL_Reg Lua_Future::lib_f[] = {
+    { NULL, NULL }
+};
+
+const struct luaL_Reg Lua_Future::lib_m[] = {
+    { "__gc", exception_translator<gc> },
+    { "__index", exception_translator<index> },
+    { NULL, NULL }
+};
+
+void Lua_Future::initialize()
+{
+    methods["ready"] = exception_translator<ready>;
+    methods["wait"]  = exception_translator<wait>;
+    methods["get"]   = exception_translator<get>;
+}
+
+void Lua_Future::_register(lua_State* L)
+{
+    LuaAdapter<Lua_Future>::_register(L);
+
+    if (luaL_loadstring(L, loopChunk) != 0) {
+        lua_error(L);
+    }
+    lua_pushvalue(L, -2);
+    luaL_getmetatable(L, metatableName);
+    lua_pushcfunction(L, exception_translator<waitAny>);
+    lua_call(L, 3, 0);
+}
+
+int Lua_Future::ready(lua_State* L)
+{
+    Lua_Future* f = checkUserData(L);
+    lua_pushboolean(L, f->m_pending.wait(0));
+    return 1;
+}
+
+int Lua_Future::wait(lua_State* L)
+{
+    Lua_Future* f = checkUserData(L);
+    lua_pushboolean(L, f->m_pending.wait(luaL_optnumber(L, 2, -1)));
+    return 1;
+}
+
+// counts the values that became ready, see waitAny
+struct Lua_Future::Completions {
+    std::mutex mutex;
+    std::condition_variable ready;
+    unsigned long long count = 0;
+};
+
+Lua_Future::Completions& Lua_Future::completions()
+{
+    // never destroyed, the threads waiting for futures may outlive main
+    static Completions* c = new Completions();
+    return *c;
+}
+
+/* Blocks until one of the futures of the table is ready. A std::future
+ * cannot notify anyone, so every future that is not ready gets a thread
+ * that waits for it once and then signals completions(). Deferred values
+ * count as ready, they are computed when read.
+ */
+int Lua_Future::waitAny(lua_State* L)
+{
+    luaL_checktype(L, 1, LUA_TTABLE);
+    Completions& c = completions();
+    unsigned long long seen;
+    {
+        std::lock_guard<std::mutex> lock(c.mutex);
+        seen = c.count;
+    }
+
+    const int n = static_cast<int>(tableLength(L, 1));
+    for (int i = 1; i <= n; ++i) {
+        lua_rawgeti(L, 1, i);
+        Lua_Future* f = checkUserData(L, lua_gettop(L));
+        lua_pop(L, 1);
+        if (f->m_pending.wait(0)) {
+            return 0;
+        }
+        if (!f->m_watched) {
+            const std::function<bool(double)> wait = f->m_pending.wait;
+            std::thread([wait, &c]() {
+                wait(-1);
+                std::lock_guard<std::mutex> lock(c.mutex);
+                ++c.count;
+                c.ready.notify_all();
+            }).detach();
+            f->m_watched = true;
+        }
+    }
+
+    std::unique_lock<std::mutex> lock(c.mutex);
+    c.ready.wait(lock, [&c, seen]() { return c.count != seen; });
+    return 0;
+}
+
+// also continues a call suspended by yieldPending, with the future on top
+int Lua_Future::get(lua_State* L)
+{
+    const int top = lua_gettop(L);
+    Lua_Future* f = checkUserData(L, top);
+    LuaCallFrame frame(L, top + 1);
+
+    f->m_pending.wait(-1);
+    f->m_pending.result(frame);
+    return frame.results();
+}
+
+#if LUA_VERSION_NUM >= 502
+
+#if LUA_VERSION_NUM >= 503
+static int resumePending(lua_State* L, int, lua_KContext ctx)
+{
+#else
+static int resumePending(lua_State* L)
+{
+    int ctx = 0;
+    lua_getctx(L, &ctx);
+#endif
+    // drops the values passed to resume
+    lua_settop(L, static_cast<int>(ctx));
+    return exception_translator<Lua_Future::get>(L);
+}
+
+int yieldPending(lua_State* L)
+{
+    // the copy below the yielded future is kept for the continuation
+    lua_pushvalue(L, -1);
+    return lua_yieldk(L, 1, lua_gettop(L) - 1, resumePending);
+}
+
+#else
+
+int yieldPending(lua_State* L)
+{
+    return luaL_error(L, "cannot yield a pending result");
+}
+
+#endif
+
+
 /* Library loading functions adapted from loadlib.c from the lua source code
  *
  */
@@ -1464,11 +2711,13 @@ extern "C" {
         using namespace SelfPortraitLua;
 		Lua_Class::_register(L);
 		Lua_Attribute::_register(L);
+		Lua_AttributeAccessor::_register(L);
 		Lua_Method::_register(L);
 		Lua_Constructor::_register(L);
 		Lua_Variant::_register(L);
 		Lua_Function::_register(L);
 		Lua_Proxy::_register(L);
+		Lua_Future::_register(L);
         Lua_Library::_register(L);
 		return 1;
     }
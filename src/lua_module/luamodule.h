@@ -8,7 +8,10 @@
 #include <ctype.h>
 
 
+#include <algorithm>
 #include <map>
+#include <memory>
+#include <mutex>
 #include <unordered_map>
 #include <string>
 #include <vector>
@@ -34,13 +37,18 @@ public:
 void setExceptionTranslator(std::function<int(lua_State*, lua_CFunction)> f);
 std::function<int(lua_State*, lua_CFunction)>& getExceptionTranslator();
 
+// suspends the running coroutine until the pending result on top of the stack is ready
+int yieldPending(lua_State* L);
+
 /* For an explanation:
  * http://maxdebayser.blogspot.com.br/2012/11/semi-automatic-conversion-of-c.html
  */
 template<lua_CFunction func>
 static int exception_translator(lua_State* L)
 {
-    return getExceptionTranslator()(L, func);
+    const int results = getExceptionTranslator()(L, func);
+    // out of the C++ frames, lua_yieldk may longjmp
+    return results >= 0 ? results : yieldPending(L);
 }
 
 
@@ -53,7 +61,9 @@ public:
     typedef T Adapted;
 
     static void _register(lua_State* L) {
-        Adapted::initialize();
+        // the tables are shared by every lua_State, which may be opened concurrently
+        static std::once_flag initialized;
+        std::call_once(initialized, &Adapted::initialize);
 
 
 
@@ -137,6 +147,121 @@ const struct luaL_Reg LuaAdapter<T>::lib_m[] = {
     { NULL, NULL }
 };
 
+//---------------CallFrame------------------------------------------------------
+
+/* Arguments of a call on the Lua stack from firstArg to the top.
+ * Numbers, booleans and strings are read and pushed without variants,
+ * tables are read and created by LuaTableFrame.
+ */
+class LuaCallFrame: public CallFrame {
+public:
+    LuaCallFrame(lua_State* L, int firstArg);
+
+    std::size_t size() const override;
+    Kind kind(std::size_t i) const override;
+
+    bool booleanArg(std::size_t i) override;
+    long long integerArg(std::size_t i) override;
+    double numberArg(std::size_t i) override;
+    const char* stringArg(std::size_t i, std::size_t& length) override;
+    VariantValue variantArg(std::size_t i) override;
+    void sequenceArg(std::size_t i, const Elements& f) override;
+    void mapArg(std::size_t i, const Elements& f) override;
+
+    void pushBoolean(bool b) override;
+    void pushInteger(long long i) override;
+    void pushNumber(double d) override;
+    void pushString(const char* s, std::size_t length) override;
+    void pushVariant(VariantValue&& v) override;
+    void pushSequence(std::size_t size, const Elements& f) override;
+    void pushMap(std::size_t size, const Elements& f) override;
+
+    void pushPending(Pending&& p) override;
+
+    static Kind kindOf(lua_State* L, int idx);
+
+    // results() when the call must yield a Future, see exception_translator
+    static const int yieldResults = -1;
+
+    // number of values pushed
+    int results() const { return m_results; }
+
+private:
+    int index(std::size_t i) const { return m_first + static_cast<int>(i); }
+
+    lua_State* const m_L;
+    const int m_first;
+    const std::size_t m_size;
+    int m_results;
+};
+
+/* Elements of a Lua table, read from its array part or appended to it.
+ * Maps are read from an array of their pairs, key, value, key, value...
+ * and written by pushing keys and values alternately.
+ */
+class LuaTableFrame: public CallFrame {
+public:
+    enum Mode { Read, AppendSequence, AppendMap };
+
+    // table is an absolute stack index
+    LuaTableFrame(lua_State* L, int table, Mode mode);
+
+    std::size_t size() const override;
+    Kind kind(std::size_t i) const override;
+
+    bool booleanArg(std::size_t i) override;
+    long long integerArg(std::size_t i) override;
+    double numberArg(std::size_t i) override;
+    const char* stringArg(std::size_t i, std::size_t& length) override;
+    VariantValue variantArg(std::size_t i) override;
+    void sequenceArg(std::size_t i, const Elements& f) override;
+    void mapArg(std::size_t i, const Elements& f) override;
+
+    void pushBoolean(bool b) override;
+    void pushInteger(long long i) override;
+    void pushNumber(double d) override;
+    void pushString(const char* s, std::size_t length) override;
+    void pushVariant(VariantValue&& v) override;
+    void pushSequence(std::size_t size, const Elements& f) override;
+    void pushMap(std::size_t size, const Elements& f) override;
+
+    // call f with the elements of the table at idx
+    static void readSequence(lua_State* L, int idx, const Elements& f);
+    static void readMap(lua_State* L, int idx, const Elements& f);
+    // push a new table filled by f
+    static void newSequence(lua_State* L, std::size_t size, const Elements& f);
+    static void newMap(lua_State* L, std::size_t size, const Elements& f);
+
+private:
+    // pushes element i on the stack
+    void get(std::size_t i) const;
+    // stores the value on top of the stack
+    void store();
+
+    lua_State* const m_L;
+    const int m_table;
+    const Mode m_mode;
+    std::size_t m_size;
+    bool m_hasKey;
+};
+
+//---------------FFI------------------------------------------------------------
+
+/* Lua functions calling the native entries of methods and functions
+ * through LuaJIT FFI function pointers, so that the JIT can compile them.
+ * Exceptions are raised as Lua errors once the entry has returned, and
+ * methods check that their first argument is a variant.
+ */
+class LuaFFI {
+public:
+    // pushes nothing and returns false if there is no entry or no FFI
+    static bool push(lua_State* L, const NativeEntry* entry, bool takesObject);
+
+private:
+    static const char * castName;
+    static const char * castChunk;
+};
+
 //---------------Variant--------------------------------------------------------
 class Lua_Variant: public LuaAdapter<Lua_Variant> {
 public:
@@ -148,10 +273,17 @@ public:
 
     static void initialize();
 
-
+    static void _register(lua_State* L);
 
     static VariantValue getFromStack(lua_State* L, int idx = 1);
 
+    // variants of a reflected class share a metatable built for that class
+    static Lua_Variant* checkUserData(lua_State* L, int pos = 1);
+    static bool isUserData(lua_State* L, int pos = 1);
+    // pushes the key every variant metatable has, see isUserData
+    static void pushMarker(lua_State* L);
+    static void pushMetatable(lua_State* L, const Class& c);
+
     static int newInstance(lua_State* L);
     static int assign(lua_State* L);
     static int tostring(lua_State* L);
@@ -177,6 +309,15 @@ public:
 
     static int attribute_stub(lua_State* L);
     static int method_stub(lua_State* L);
+    static int overload_stub(lua_State* L);
+    static int class_index(lua_State* L);
+    static int class_newindex(lua_State* L);
+    static int no_property(lua_State* L);
+
+    // reads or writes several attributes in one call, obj:getAttributes{"a", "b"}
+    // returns both values and obj:setAttributes{a = 1, b = 2} assigns them
+    static int getAttributes(lua_State* L);
+    static int setAttributes(lua_State* L);
 
     static const char * metatableName;
     static const char * userDataName;
@@ -187,7 +328,7 @@ public:
         lc->m_variant = ::std::move(v);
 
         lc->m_class = c;
-        luaL_getmetatable(L, Lua_Variant::metatableName);
+        pushMetatable(L, c);
         lua_setmetatable(L, -2);
     }
 
@@ -199,15 +340,18 @@ public:
         void * f = lua_newuserdata(L, sizeof(Adapted));
         Adapted * lc = new(f) Adapted(args...);
         lc->m_class = c;
-        luaL_getmetatable(L, Adapted::metatableName);
+        pushMetatable(L, c);
         lua_setmetatable(L, -2);
     }
 
     const VariantValue& wrapped() const { return m_variant; }
 
 private:
+    static void buildClassMetatable(lua_State* L, const Class& c);
+
     VariantValue m_variant;
     Class m_class;
+    static const char * classMetatablesName;
     static MethodTable methods;
     static const struct luaL_Reg lib_f[];
     static const struct luaL_Reg lib_m[];
@@ -242,6 +386,7 @@ public:
     static int findSuperClass(lua_State* L);
     static int findAllSuperClasses(lua_State* L);
     static int castUp(lua_State* L);
+    static int attributeAccessor(lua_State* L);
 
     static void initialize();
 
@@ -271,6 +416,7 @@ public:
     Lua_Method(Method m) : m_method(m) {}
 
     static int call(lua_State* L);
+    static int callAndPush(lua_State* L, const Method& m, int firstArg);
     static int name(lua_State* L);
     static int fullName(lua_State* L);
     static int numberOfArguments(lua_State* L);
@@ -280,6 +426,7 @@ public:
     static int isVolatile(lua_State* L);
     static int isStatic(lua_State* L);
     static int getClass(lua_State* L);
+    static int ffi(lua_State* L);
 
     static void initialize();
 
@@ -352,6 +499,33 @@ private:
     friend class LuaAdapter<Lua_Attribute>;
 };
 
+/* A list of attributes of a class resolved once, accessor:get(obj) returns
+ * their values and accessor:set(obj, ...) assigns them in the same order.
+ */
+class Lua_AttributeAccessor: public LuaAdapter<Lua_AttributeAccessor> {
+public:
+    Lua_AttributeAccessor(std::vector<Attribute>&& attributes) : m_attributes(std::move(attributes)) {}
+
+    static int get(lua_State* L);
+    static int set(lua_State* L);
+    static int names(lua_State* L);
+
+    static void initialize();
+
+    static void _register(lua_State* L);
+
+    static const char * metatableName;
+    static const char * userDataName;
+
+    const std::vector<Attribute>& wrapped() const { return m_attributes; }
+
+private:
+    std::vector<Attribute> m_attributes;
+    static MethodTable methods;
+    static const struct luaL_Reg lib_f[];
+    friend class LuaAdapter<Lua_AttributeAccessor>;
+};
+
 
 //---------------Function-------------------------------------------------------
 
@@ -364,7 +538,10 @@ public:
     static int numberOfArguments(lua_State* L);
     static int returnSpelling(lua_State* L);
     static int argumentSpellings(lua_State* L);
+    static int ffi(lua_State* L);
     static int lookup(lua_State* L);
+    static int lookupNamespace(lua_State* L);
+    static int invoke(lua_State* L);
 
     static void initialize();
 
@@ -374,6 +551,8 @@ public:
     const Function& wrapped() const { return m_function; }
 
 private:
+    static int callAndPush(lua_State* L, const Function& f, int firstArg);
+
     Function m_function;
     static MethodTable methods;
     static const struct luaL_Reg lib_f[];
@@ -384,11 +563,20 @@ private:
 //---------------Proxy----------------------------------------------------------
 
 
+/* Calls a Lua function implementing a proxy method. Primitive arguments
+ * are pushed as Lua values, objects as variants.
+ * The C++ caller waits for the result, so the function cannot yield:
+ * reflected calls returning futures block in it.
+ */
 struct LuaClosureWrapper {
     lua_State * const L = nullptr;
     struct shared_state {
-        shared_state(int index) : envIndex(index) {}
+        shared_state(int index, int handler) : envIndex(index), errorHandler(handler) {}
         const int envIndex;
+        // debug.traceback, looked up once
+        const int errorHandler;
+        // class of the last object passed at each argument position
+        std::vector<std::pair<const std::type_info*, Class>> argClasses;
     };
 
     struct deleter {
@@ -401,11 +589,12 @@ struct LuaClosureWrapper {
 
     LuaClosureWrapper(const LuaClosureWrapper& that) = default;
 
-    LuaClosureWrapper(lua_State* ls, int index) : L(ls), ss(new shared_state(index), deleter{L}) {
-
-    }
+    LuaClosureWrapper(lua_State* ls, int index);
 
     VariantValue operator()(const ArgArray& vargs) const;
+
+private:
+    void pushArg(std::size_t i, const VariantValue& v) const;
 };
 
 
@@ -465,6 +654,46 @@ struct binding_mapper<Function> {
     typedef Lua_Function type;
 };
 
+//---------------Future-----------------------------------------------------------
+
+/* Result of a reflected call that returned a std::future. A call made from a
+ * coroutine that can yield suspends it with the Future when the value is
+ * not ready yet, and returns the value when the coroutine is resumed.
+ * Future.spawn and Future.run multiplex such coroutines on one thread.
+ * Calls made under a C++ frame, e.g. in a proxy method handler, block.
+ */
+class Lua_Future: public LuaAdapter<Lua_Future> {
+public:
+    Lua_Future(CallFrame::Pending&& p) : m_pending(std::move(p)) {}
+
+    static int ready(lua_State* L);
+    static int wait(lua_State* L);
+    static int get(lua_State* L);
+    static int waitAny(lua_State* L);
+
+    static void initialize();
+
+    static void _register(lua_State* L);
+
+    static const char * metatableName;
+    static const char * userDataName;
+    static const char * loopChunk;
+
+    const CallFrame::Pending& wrapped() const { return m_pending; }
+
+private:
+    struct Completions;
+    static Completions& completions();
+
+    CallFrame::Pending m_pending;
+    // a thread signals completions() when the value is ready
+    bool m_watched = false;
+    static MethodTable methods;
+    static const struct luaL_Reg lib_f[];
+    static const struct luaL_Reg lib_m[];
+    friend class LuaAdapter<Lua_Future>;
+};
+
 //---------------Library----------------------------------------------------------
 
 class Lua_Library: public LuaAdapter<Lua_Library> {
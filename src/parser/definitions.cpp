@@ -3,9 +3,11 @@
 ** See Copyright Notice in reflection.h
 */
 #include "definitions.h"
+#include "metadata_format.h"
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <set>
 using namespace std;
 
 namespace {
@@ -45,6 +47,126 @@ namespace {
 		}
 	}
 
+	// type spellings escape the commas of template arguments
+	size_t arity(const std::string& argument_type_spellings) {
+		return argument_type_spellings.empty() ? 0 : count(argument_type_spellings.begin(), argument_type_spellings.end(), ',') + 1;
+	}
+
+	// interns the strings of a binary meta-data file
+	class StringTable {
+	public:
+		StringTable() { offset(""); }
+
+		uint32_t offset(const std::string& s) {
+			auto it = m_offsets.find(s);
+			if (it != m_offsets.end()) {
+				return it->second;
+			}
+			const uint32_t ret = m_data.size();
+			m_data.append(s.c_str(), s.size() + 1);
+			m_offsets.emplace(s, ret);
+			return ret;
+		}
+
+		const std::string& data() const { return m_data; }
+
+	private:
+		std::string m_data;
+		std::unordered_map<std::string, uint32_t> m_offsets;
+	};
+
+	template<class Record>
+	void writeRecords(const std::vector<Record>& records, std::ostream& o) {
+		if (!records.empty()) {
+			o.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(Record));
+		}
+	}
+
+	// every reflected member is a template instantiation that grows with its arity
+	size_t cost(const Class& c) {
+		size_t ret = 1 + c.attributes.size() + c.inherited.size();
+		for (const Constructor& x: c.constructors) {
+			ret += 1 + arity(x.argument_type_spellings);
+		}
+		for (const Method& x: c.methods) {
+			ret += 1 + arity(x.argument_type_spellings);
+		}
+		return ret;
+	}
+
+	size_t cost(const Function& f) {
+		return 1 + arity(f.argument_type_spellings);
+	}
+
+	void printJson(const std::string& s, std::ostream& o) {
+		static const char hex[] = "0123456789abcdef";
+		o << '"';
+		for (char c: s) {
+			if (c == '"' || c == '\\') {
+				o << '\\' << c;
+			} else if (c == '\n') {
+				o << "\\n";
+			} else if (c == '\t') {
+				o << "\\t";
+			} else if (static_cast<unsigned char>(c) < 0x20) {
+				o << "\\u00" << hex[c >> 4] << hex[c & 0xf];
+			} else {
+				o << c;
+			}
+		}
+		o << '"';
+	}
+
+	// the parser replaces the commas of template arguments by COMMA for the macros
+	std::string unescapeSpelling(const std::string& spelling) {
+		std::string ret = spelling;
+		const std::string comma = " COMMA ";
+		for (size_t pos = ret.find(comma); pos != std::string::npos; pos = ret.find(comma, pos + 1)) {
+			ret.replace(pos, comma.size(), ",");
+		}
+		return ret;
+	}
+
+	// the spellings of argument_type_spellings, still escaped
+	std::vector<std::string> splitArguments(const std::string& argument_type_spellings) {
+		std::vector<std::string> ret;
+		size_t begin = 0;
+		while (begin < argument_type_spellings.size()) {
+			size_t end = argument_type_spellings.find(',', begin);
+			if (end == std::string::npos) {
+				end = argument_type_spellings.size();
+			}
+			const size_t first = argument_type_spellings.find_first_not_of(' ', begin);
+			ret.push_back(argument_type_spellings.substr(first, end - first));
+			begin = end + 1;
+		}
+		return ret;
+	}
+
+	void printJsonSpelling(const std::string& spelling, std::ostream& o) {
+		printJson(unescapeSpelling(spelling), o);
+	}
+
+	void printJsonArguments(const std::string& argument_type_spellings, std::ostream& o) {
+		o << '[';
+		bool first = true;
+		for (const std::string& a: splitArguments(argument_type_spellings)) {
+			if (!first) {
+				o << ',';
+			}
+			printJsonSpelling(a, o);
+			first = false;
+		}
+		o << ']';
+	}
+
+	const char* accessName(Access access) {
+		return access == Public ? "public" : access == Protected ? "protected" : "private";
+	}
+
+	const char* boolName(bool b) {
+		return b ? "true" : "false";
+	}
 
 }
 
@@ -52,6 +174,11 @@ namespace definitions {
 
 	bool Class::is_interface(std::ostream& diag, const ClassIndex& index) const
 	{
+		if (released) {
+			diag << released_diagnostics;
+			return released_is_interface;
+		}
+
 		bool is = true;
 
 		if (!attributes.empty()) {
@@ -131,16 +258,89 @@ namespace definitions {
 	}
 
 
-	void print(const Class& c, std::ostream& o, bool diagOn, const ClassIndex&);
+	void print(const Class& c, std::ostream& o, bool diagOn, bool methodTables, const ClassIndex&);
 	void print(const Inheritance& i, std::ostream& o);
-	void print(const Method& m, std::ostream& o);
+	void print(const Method& m, std::ostream& o, bool row = false);
 	void printAsStub(const Method& m, const std::string& className, std::ostream& o);
 	void print(const Function& f, std::ostream& o);
 	void print(const Attribute& a, std::ostream& o);
 	void print(const Constructor& c, std::ostream& o);
 
 
-	void print(const TranslationUnit& u, std::ostream& o, bool diagOn) {
+	TranslationUnit merge(const std::vector<TranslationUnit>& units) {
+
+		TranslationUnit ret;
+		set<string> includes;
+		set<pair<string, string> > functions;
+
+		for (const TranslationUnit& u: units) {
+
+			for (const auto& x: u.include_directives) {
+				if (includes.insert(x).second) {
+					ret.include_directives.push_back(x);
+				}
+			}
+
+			for (const auto& x: u.functions) {
+				if (functions.insert(make_pair(x.name, x.argument_type_spellings)).second) {
+					ret.functions.push_back(x);
+				}
+			}
+
+			for (const auto& x: u.classes) {
+				auto it = ret.classIndex.find(x->name);
+				if (it == ret.classIndex.end()) {
+					ret.classes.push_back(x);
+					ret.classIndex[x->name] = x;
+				} else if (x->inMainFile && !it->second->inMainFile) {
+					replace(ret.classes.begin(), ret.classes.end(), it->second, x);
+					it->second = x;
+				}
+			}
+		}
+		return ret;
+	}
+
+	std::vector<TranslationUnit> shard(const TranslationUnit& u, std::size_t n) {
+
+		vector<TranslationUnit> ret(max<size_t>(n, 1));
+		vector<size_t> load(ret.size(), 0);
+
+		for (TranslationUnit& x: ret) {
+			x.include_directives = u.include_directives;
+		}
+
+		// largest first, each to the least loaded shard
+		vector<pair<size_t, size_t> > items;
+		for (size_t i = 0; i < u.functions.size(); ++i) {
+			items.push_back(make_pair(cost(u.functions[i]), i));
+		}
+		for (size_t i = 0; i < u.classes.size(); ++i) {
+			if (u.classes[i]->inMainFile) {
+				items.push_back(make_pair(cost(*u.classes[i]), u.functions.size() + i));
+			}
+		}
+		stable_sort(items.begin(), items.end(), [](const pair<size_t, size_t>& a, const pair<size_t, size_t>& b) -> bool {
+			return a.first > b.first;
+		});
+
+		for (const auto& item: items) {
+			size_t s = min_element(load.begin(), load.end()) - load.begin();
+			load[s] += item.first;
+			if (item.second < u.functions.size()) {
+				ret[s].functions.push_back(u.functions[item.second]);
+			} else {
+				ret[s].classes.push_back(u.classes[item.second - u.functions.size()]);
+			}
+		}
+		return ret;
+	}
+
+	void print(const TranslationUnit& u, std::ostream& o, bool diagOn, bool methodTables) {
+		print(u, u.classIndex, o, diagOn, methodTables);
+	}
+
+	void print(const TranslationUnit& u, const ClassIndex& index, std::ostream& o, bool diagOn, bool methodTables) {
 
 		auto include_directives = u.include_directives;
 
@@ -169,7 +369,7 @@ namespace definitions {
 		});
 		for (const auto& x: classes) {
 			if (x->inMainFile) {
-				print(*x, o, diagOn, u.classIndex);
+				print(*x, o, diagOn, methodTables, index);
 				o << "\n";
 			}
 		}
@@ -209,7 +409,7 @@ namespace definitions {
 	}
 
 
-	void print(const Class& c, std::ostream& o, bool diagOn, const ClassIndex& index) {
+	void print(const Class& c, std::ostream& o, bool diagOn, bool methodTables, const ClassIndex& index) {
 
 		stringstream devnull;
 
@@ -256,8 +456,18 @@ namespace definitions {
 
 		auto methods = c.methods;
 		sort(methods.begin(), methods.end(), compare_methods);
+		// the stub of an interface needs the per method instantiations
+		const bool table = methodTables && !isInterface && std::any_of(methods.begin(), methods.end(), [](const Method& m) {
+			return m.access == Public;
+		});
+		if (table) {
+			o << "REFL_BEGIN_METHOD_TABLE\n";
+		}
 		for (const auto& x: methods) {
-			print(x, o);
+			print(x, o, table);
+		}
+		if (table) {
+			o << "REFL_END_METHOD_TABLE\n";
 		}
 		// inner classes also go to TranslationUnit.classes and are printed in that loop
 
@@ -268,25 +478,26 @@ namespace definitions {
 		o << "REFL_SUPER_CLASS(" << i.name << ")\n";
 	}
 
-	void print(const Method& m, std::ostream& o) {
+	void print(const Method& m, std::ostream& o, bool row) {
 
 		if (m.access != Public) {
 			return;
 		}
 
 		const string argstr = (m.argument_type_spellings.empty() ? "" : ", ") + m.argument_type_spellings;
+		const char* suffix = row ? "_ROW(" : "(";
 		if (m.is_static) {
-			o << "REFL_STATIC_METHOD(" << m.name << ", " << m.return_type_spelling << argstr << ")\n";
+			o << "REFL_STATIC_METHOD" << suffix << m.name << ", " << m.return_type_spelling << argstr << ")\n";
 		} else {
 
 			if (!m.is_const && !m.is_volatile) {
-				o << "REFL_METHOD(" << m.name << ", " << m.return_type_spelling << argstr << ")\n";
+				o << "REFL_METHOD" << suffix << m.name << ", " << m.return_type_spelling << argstr << ")\n";
 			} else if (m.is_const && !m.is_volatile) {
-				o << "REFL_CONST_METHOD(" << m.name << ", " << m.return_type_spelling << argstr << ")\n";
+				o << "REFL_CONST_METHOD" << suffix << m.name << ", " << m.return_type_spelling << argstr << ")\n";
 			} else if (!m.is_const && m.is_volatile) {
-				o << "REFL_VOLATILE_METHOD(" << m.name << ", " << m.return_type_spelling << argstr << ")\n";
+				o << "REFL_VOLATILE_METHOD" << suffix << m.name << ", " << m.return_type_spelling << argstr << ")\n";
 			} else {
-				o << "REFL_CONST_VOLATILE_METHOD(" << m.name << ", " << m.return_type_spelling << argstr << ")\n";
+				o << "REFL_CONST_VOLATILE_METHOD" << suffix << m.name << ", " << m.return_type_spelling << argstr << ")\n";
 			}
 
 		}
@@ -337,8 +548,99 @@ namespace definitions {
 		}
 	}
 
-	TranslationUnitBuilder::TranslationUnitBuilder(TranslationUnit& tu)
-		: m_tu(tu) {}
+	void Class::release(const ClassIndex& index) {
+		stringstream diag;
+		released_is_interface = is_interface(diag, index);
+		released_diagnostics = diag.str();
+		released = true;
+
+		vector<Constructor>().swap(constructors);
+		vector<Method>().swap(methods);
+		vector<Attribute>().swap(attributes);
+		vector<Inheritance>().swap(inherited);
+		vector<shared_ptr<Class> >().swap(inner);
+	}
+
+	void JsonLinesWriter::add(const Class& c, const ClassIndex& index) {
+		if (!c.inMainFile) {
+			return;
+		}
+
+		stringstream diag;
+		const bool isInterface = c.is_interface(diag, index);
+
+		m_out << "{\"kind\":\"class\",\"name\":";
+		printJsonSpelling(c.name, m_out);
+		m_out << ",\"interface\":" << boolName(isInterface) << ",\"diagnostics\":[";
+		string line;
+		for (bool first = true; getline(diag, line); first = false) {
+			m_out << (first ? "" : ",");
+			printJsonSpelling(line, m_out);
+		}
+		m_out << "],\"public_virtual_destructor\":" << boolName(c.destructor_is_public_virtual);
+
+		m_out << ",\"bases\":[";
+		for (size_t i = 0; i < c.inherited.size(); ++i) {
+			m_out << (i == 0 ? "" : ",") << "{\"name\":";
+			printJsonSpelling(c.inherited[i].name, m_out);
+			m_out << ",\"access\":\"" << accessName(c.inherited[i].access) << "\"}";
+		}
+
+		m_out << "],\"constructors\":[";
+		for (size_t i = 0; i < c.constructors.size(); ++i) {
+			m_out << (i == 0 ? "" : ",") << "{\"arguments\":";
+			printJsonArguments(c.constructors[i].argument_type_spellings, m_out);
+			m_out << ",\"access\":\"" << accessName(c.constructors[i].access) << "\"}";
+		}
+
+		m_out << "],\"methods\":[";
+		for (size_t i = 0; i < c.methods.size(); ++i) {
+			const Method& m = c.methods[i];
+			m_out << (i == 0 ? "" : ",") << "{\"name\":";
+			printJson(m.name, m_out);
+			m_out << ",\"return\":";
+			printJsonSpelling(m.return_type_spelling, m_out);
+			m_out << ",\"arguments\":";
+			printJsonArguments(m.argument_type_spellings, m_out);
+			m_out << ",\"const\":" << boolName(m.is_const)
+				  << ",\"volatile\":" << boolName(m.is_volatile)
+				  << ",\"static\":" << boolName(m.is_static)
+				  << ",\"pure_virtual\":" << boolName(m.is_pure_virtual)
+				  << ",\"user_provided\":" << boolName(m.isUserProvided)
+				  << ",\"access\":\"" << accessName(m.access) << "\"}";
+		}
+
+		m_out << "],\"attributes\":[";
+		for (size_t i = 0; i < c.attributes.size(); ++i) {
+			m_out << (i == 0 ? "" : ",") << "{\"name\":";
+			printJson(c.attributes[i].name, m_out);
+			m_out << ",\"type\":";
+			printJsonSpelling(c.attributes[i].type_spelling, m_out);
+			m_out << ",\"access\":\"" << accessName(c.attributes[i].access) << "\"}";
+		}
+
+		m_out << "],\"inner\":[";
+		for (size_t i = 0; i < c.inner.size(); ++i) {
+			m_out << (i == 0 ? "" : ",");
+			printJsonSpelling(c.inner[i]->name, m_out);
+		}
+		m_out << "]}\n";
+	}
+
+	void JsonLinesWriter::add(const Function& f) {
+		m_out << "{\"kind\":\"function\",\"name\":";
+		printJson(f.name, m_out);
+		m_out << ",\"return\":";
+		printJsonSpelling(f.return_type_spelling, m_out);
+		m_out << ",\"arguments\":";
+		printJsonArguments(f.argument_type_spellings, m_out);
+		m_out << "}\n";
+	}
+
+	TranslationUnitBuilder::TranslationUnitBuilder(TranslationUnit& tu, DeclarationSink* sink, bool keepDeclarations)
+		: m_tu(tu)
+		, m_sink(sink)
+		, m_keep(keepDeclarations) {}
 
 	void TranslationUnitBuilder::pushClass(Class&& cl) {
 		// if the class stack is not empty, it is an inner class
@@ -348,7 +650,9 @@ namespace definitions {
 		if (!m_cStack.empty()) {
 			m_cStack.back()->inner.push_back(c);
 		}
-		m_tu.classes.push_back(c);
+		if (m_keep) {
+			m_tu.classes.push_back(c);
+		}
 
 		m_cStack.push_back(c);
 		m_tu.classIndex[c->name] = c;
@@ -358,7 +662,15 @@ namespace definitions {
 		if (m_cStack.empty()) {
 			throw std::logic_error("programming arror, class stack is empty");
 		}
+		shared_ptr<Class> c = m_cStack.back();
 		m_cStack.pop_back();
+
+		if (m_sink) {
+			m_sink->add(*c, m_tu.classIndex);
+		}
+		if (!m_keep) {
+			c->release(m_tu.classIndex);
+		}
 	}
 
 	Class& TranslationUnitBuilder::currentClass() {
@@ -385,11 +697,153 @@ namespace definitions {
 	}
 
 	void TranslationUnitBuilder::addFunction(Function&& m) {
-		m_tu.functions.emplace_back(m);
+		if (m_sink) {
+			m_sink->add(m);
+		}
+		if (m_keep) {
+			m_tu.functions.emplace_back(m);
+		}
 	}
 
 	void TranslationUnitBuilder::addInheritance(const std::string& baseName, Access access) {
 		currentClass().inherited.push_back({baseName, access});
 	}
 
+	void writeBinary(const TranslationUnit& u, const ClassIndex& index, std::ostream& o) {
+
+		stringstream devnull;
+		StringTable strings;
+		// spellings as in C++, like the JSON lines
+		auto spelling = [&strings](const string& s) {
+			return strings.offset(unescapeSpelling(s));
+		};
+		vector<uint32_t> arguments;
+		auto addArguments = [&](const string& argument_type_spellings) {
+			const uint32_t first = arguments.size();
+			for (const string& a: splitArguments(argument_type_spellings)) {
+				arguments.push_back(spelling(a));
+			}
+			return first;
+		};
+
+		// sorted by their spelling, for the binary search of the reader
+		vector<pair<string, shared_ptr<Class> > > classes;
+		for (const auto& x: u.classes) {
+			if (x->inMainFile) {
+				classes.emplace_back(unescapeSpelling(x->name), x);
+			}
+		}
+		sort(classes.begin(), classes.end(), [](const pair<string, shared_ptr<Class> >& c1, const pair<string, shared_ptr<Class> >& c2) -> bool {
+			 return c1.first < c2.first;
+		});
+		unordered_map<string, uint32_t> classNumbers;
+		for (size_t i = 0; i < classes.size(); ++i) {
+			classNumbers[classes[i].second->name] = i;
+		}
+
+		vector<ClassRecord> classRecords;
+		vector<MethodRecord> methodRecords;
+		vector<AttributeRecord> attributeRecords;
+		vector<ConstructorRecord> constructorRecords;
+		vector<BaseRecord> baseRecords;
+
+		for (const auto& x: classes) {
+			const shared_ptr<Class>& c = x.second;
+			ClassRecord record;
+			record.name = strings.offset(x.first);
+			record.flags = c->is_interface(devnull, index) ? ClassRecord::Interface : 0;
+
+			auto methods = c->methods;
+			sort(methods.begin(), methods.end(), compare_methods);
+			record.firstMethod = methodRecords.size();
+			for (const Method& m: methods) {
+				if (m.access == Public) {
+					const uint32_t firstArgument = addArguments(m.argument_type_spellings);
+					methodRecords.push_back({
+						strings.offset(m.name),
+						spelling(m.return_type_spelling),
+						firstArgument,
+						static_cast<uint32_t>(arguments.size() - firstArgument),
+						static_cast<uint32_t>((m.is_const ? MethodRecord::Const : 0) | (m.is_volatile ? MethodRecord::Volatile : 0) | (m.is_static ? MethodRecord::Static : 0))
+					});
+				}
+			}
+			record.numMethods = methodRecords.size() - record.firstMethod;
+
+			record.firstAttribute = attributeRecords.size();
+			for (const Attribute& a: c->attributes) {
+				if (a.access == Public) {
+					attributeRecords.push_back({ strings.offset(a.name), spelling(a.type_spelling) });
+				}
+			}
+			record.numAttributes = attributeRecords.size() - record.firstAttribute;
+
+			record.firstConstructor = constructorRecords.size();
+			for (const Constructor& x: c->constructors) {
+				if (x.access == Public) {
+					const uint32_t firstArgument = addArguments(x.argument_type_spellings);
+					constructorRecords.push_back({ firstArgument, static_cast<uint32_t>(arguments.size() - firstArgument) });
+				}
+			}
+			record.numConstructors = constructorRecords.size() - record.firstConstructor;
+
+			record.firstBase = baseRecords.size();
+			for (const Inheritance& i: c->inherited) {
+				auto it = classNumbers.find(i.name);
+				baseRecords.push_back({ spelling(i.name), it == classNumbers.end() ? noClassIndex : it->second });
+			}
+			record.numBases = baseRecords.size() - record.firstBase;
+
+			classRecords.push_back(record);
+		}
+
+		auto functions = u.functions;
+		// overloads are adjacent, the reader finds them by name
+		sort(functions.begin(), functions.end(), [](const Function& f1, const Function& f2) -> bool {
+			if (f1.name < f2.name) {
+				return true;
+			} else if (f2.name < f1.name) {
+				return false;
+			} else {
+				return f1.argument_type_spellings < f2.argument_type_spellings;
+			}
+		});
+		vector<FunctionRecord> functionRecords;
+		for (const Function& f: functions) {
+			const uint32_t firstArgument = addArguments(f.argument_type_spellings);
+			functionRecords.push_back({
+				strings.offset(f.name),
+				spelling(f.return_type_spelling),
+				firstArgument,
+				static_cast<uint32_t>(arguments.size() - firstArgument)
+			});
+		}
+
+		MetadataHeader header;
+		copy(metadataMagic, metadataMagic + sizeof(metadataMagic), header.magic);
+		header.version = metadataVersion;
+		header.numClasses = classRecords.size();
+		header.numFunctions = functionRecords.size();
+		header.numMethods = methodRecords.size();
+		header.numAttributes = attributeRecords.size();
+		header.numConstructors = constructorRecords.size();
+		header.numBases = baseRecords.size();
+		header.numArguments = arguments.size();
+
+		// keeps the size of the file a multiple of 4, like the records
+		string stringData = strings.data();
+		stringData.resize((stringData.size() + 3) & ~size_t(3), '\0');
+		header.stringsSize = stringData.size();
+
+		o.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		writeRecords(classRecords, o);
+		writeRecords(functionRecords, o);
+		writeRecords(methodRecords, o);
+		writeRecords(attributeRecords, o);
+		writeRecords(constructorRecords, o);
+		writeRecords(baseRecords, o);
+		writeRecords(arguments, o);
+		o.write(stringData.data(), stringData.size());
+	}
+
 }
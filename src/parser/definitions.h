@@ -90,7 +90,7 @@ namespace definitions {
 
 	struct Class {
 
-		Class(const std::string& n, bool isInMainFile) : name(n), destructor_is_public_virtual(false), inMainFile(isInMainFile) {}
+		Class(const std::string& n, bool isInMainFile) : name(n), destructor_is_public_virtual(false), inMainFile(isInMainFile), released(false), released_is_interface(false) {}
 
 		std::string name;
 
@@ -121,6 +121,18 @@ namespace definitions {
 		// Should we restrict overloaded methods?
 		bool is_interface(std::ostream& diag, const ClassIndex& index) const;
 
+		/*! Frees the members of a class that has already been written.
+		 * Only the verdict and the diagnostics of is_interface are kept,
+		 * the classes derived from it still need them.
+		 */
+		void release(const ClassIndex& index);
+
+		bool released;
+
+		bool released_is_interface;
+
+		std::string released_diagnostics;
+
 	};
 
 	struct TranslationUnit {
@@ -134,9 +146,49 @@ namespace definitions {
 		ClassIndex classIndex;
 	};
 
+	/*! Receives the declarations while they are visited. A class is passed
+	 * when its definition is complete, so its bases and inner classes
+	 * have been passed before it.
+	 */
+	class DeclarationSink {
+	public:
+		virtual ~DeclarationSink() {}
+
+		virtual void add(const Class& c, const ClassIndex& index) = 0;
+
+		virtual void add(const Function& f) = 0;
+	};
+
+	/*! Writes one JSON object per line for each class of the main file and
+	 * each function, for generators that should not have to parse the
+	 * headers again:
+	 *
+	 *   {"kind":"class","name":...,"interface":...,"diagnostics":[...],
+	 *    "public_virtual_destructor":...,"bases":[...],"constructors":[...],
+	 *    "methods":[...],"attributes":[...],"inner":[...]}
+	 *   {"kind":"function","name":...,"return":...,"arguments":[...]}
+	 *
+	 * Type spellings are the ones of the declarations.
+	 */
+	class JsonLinesWriter : public DeclarationSink {
+	public:
+		JsonLinesWriter(std::ostream& o) : m_out(o) {}
+
+		void add(const Class& c, const ClassIndex& index) override;
+
+		void add(const Function& f) override;
+
+	private:
+		std::ostream& m_out;
+	};
+
 	class TranslationUnitBuilder {
 	public:
-		TranslationUnitBuilder(TranslationUnit& tu);
+		/*! Without keepDeclarations the classes and functions are only
+		 * passed to the sink: the classes are released as soon as they
+		 * are complete and the TranslationUnit keeps just its index.
+		 */
+		TranslationUnitBuilder(TranslationUnit& tu, DeclarationSink* sink = nullptr, bool keepDeclarations = true);
 
 		void pushClass(Class&& c);
 
@@ -158,11 +210,38 @@ namespace definitions {
 
 	private:
 		TranslationUnit& m_tu;
+		DeclarationSink* m_sink;
+		bool m_keep;
 		std::vector<std::shared_ptr<Class> > m_cStack;
 	};
 
 
-	void print(const TranslationUnit& u, std::ostream& o, bool diagOn = false);
+	/*! Joins the declarations of several translation units. Classes are
+	 * deduplicated by name, a definition from a main file replacing one
+	 * that was only seen as an include.
+	 */
+	TranslationUnit merge(const std::vector<TranslationUnit>& units);
+
+	/*! Splits the functions and the classes of the main file into n units
+	 * of about the same estimated compilation cost, so that the generated
+	 * code can be compiled in parallel. The shards have no class index of
+	 * their own, they must be printed with the index of u.
+	 */
+	std::vector<TranslationUnit> shard(const TranslationUnit& u, std::size_t n);
+
+	/*! With methodTables the methods of each class are emitted as rows of a
+	 * REFL_BEGIN_METHOD_TABLE, sharing one invoker per signature, instead of
+	 * a REFL_METHOD each. Interfaces keep the REFL_METHOD macros.
+	 */
+	void print(const TranslationUnit& u, std::ostream& o, bool diagOn = false, bool methodTables = false);
+
+	//! Resolves base classes through index instead of u.classIndex
+	void print(const TranslationUnit& u, const ClassIndex& index, std::ostream& o, bool diagOn = false, bool methodTables = false);
+
+	/*! Writes the classes of the main file and the functions of u in the
+	 * binary format of metadata_format.h, for MetadataFile
+	 */
+	void writeBinary(const TranslationUnit& u, const ClassIndex& index, std::ostream& o);
 
 }
 
@@ -0,0 +1,741 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include <vector>
+#include <string>
+#include <set>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <algorithm>
+#include <iterator>
+#include <thread>
+#include <cstdlib>
+#include <cstring>
+#include <cstdio>
+#include <cstdint>
+#include <climits>
+#include <chrono>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "definitions.h"
+#include "manifest.h"
+#include "parser.h"
+using namespace definitions;
+
+using namespace std;
+
+namespace {
+
+	struct Input {
+		// the input specific flags, without the compiler
+		parser::Command command;
+		string output;
+		TranslationUnit tu;
+		bool ok;
+		bool skipped;
+		uint64_t flags;
+		vector<string> dependencies;
+	};
+
+	// clang options whose value is the next argument
+	bool takesValue(const char* arg)
+	{
+		static const char* options[] = { "-o", "-I", "-D", "-U", "-x", "-include", "-include-pch", "-isystem", "-iquote", "-idirafter", "-working-directory", "-Xclang" };
+		for (const char* o: options) {
+			if (strcmp(arg, o) == 0) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+	// The arguments without the input files and the output
+	vector<const char*> compilerFlags(const vector<const char*>& args, string* input = nullptr)
+	{
+		vector<const char*> ret;
+		for (size_t i = 0; i < args.size(); ++i) {
+			if (i > 0 && args[i][0] != '-') {
+				if (input) {
+					*input = args[i];
+				}
+			} else if (strncmp(args[i], "-o", 2) == 0) {
+				if (args[i][2] == '\0') {
+					++i;
+				}
+			} else {
+				ret.push_back(args[i]);
+				if (takesValue(args[i]) && (i+1) < args.size()) {
+					ret.push_back(args[++i]);
+				}
+			}
+		}
+		return ret;
+	}
+
+	// true if clang accepts pch with the flags of command: a PCH written by
+	// another clang, or that does not match its headers any more, fails
+	bool loadable(const parser::Command& command, const string& pch)
+	{
+		parser::Command check = command;
+		check.file = (pch[0] == '/' ? pch : command.directory + "/" + pch) + ".check.h";
+		check.flags.push_back("-include-pch");
+		check.flags.push_back(pch);
+		const parser::VirtualFiles files = { { check.file, "" } };
+
+		TranslationUnit tu;
+		string diagnostics;
+		return parser::parse(check, tu, false, &diagnostics, nullptr, nullptr, false, &files);
+	}
+
+	/* Builds a PCH of the prelude with the given flags, unless the cache
+	 * directory already has one for the same flags and clang version
+	 * whose files did not change. They are listed in a manifest next to
+	 * the PCH, and a PCH that clang cannot load is built again.
+	 * Every translation unit then loads it with -include-pch instead of
+	 * parsing the common headers again.
+	 */
+	bool precompilePrelude(const parser::Command& command, const string& cacheDir, string& pch)
+	{
+		const string& prelude = command.file;
+		struct stat st;
+		if (stat(prelude.c_str(), &st) != 0) {
+			cerr << "cannot find prelude " << prelude << endl;
+			return false;
+		}
+
+		string key = prelude + '\n' + parser::compilerVersion();
+		for (const string& f: command.flags) {
+			key += '\n';
+			key += f;
+		}
+		const uint64_t keyHash = Manifest::hash(key);
+		char name[32];
+		snprintf(name, sizeof(name), "%016llx.pch", static_cast<unsigned long long>(keyHash));
+		pch = cacheDir + "/" + name;
+		const string manifestFile = pch + ".manifest";
+
+		// the PCH itself is not hashed, loading it tells whether it is sound
+		Manifest manifest;
+		manifest.load(manifestFile);
+		if (manifest.upToDate(pch, keyHash, {}) && access(pch.c_str(), R_OK) == 0 && loadable(command, pch)) {
+			return true;
+		}
+
+		// concurrent invocations may build the same file, the rename is atomic
+		const string tmp = pch + "." + to_string(getpid());
+		vector<string> dependencies;
+		if (!parser::precompile(command, tmp, nullptr, &dependencies)) {
+			cerr << "cannot precompile prelude " << prelude << endl;
+			unlink(tmp.c_str());
+			return false;
+		}
+		if (rename(tmp.c_str(), pch.c_str()) != 0) {
+			cerr << "cannot write precompiled prelude " << pch << endl;
+			unlink(tmp.c_str());
+			return false;
+		}
+		// without it the PCH is only built again next time
+		manifest.update(pch, keyHash, Manifest::hash(""), dependencies);
+		if (!manifest.save(manifestFile)) {
+			cerr << "cannot write manifest " << manifestFile << endl;
+		}
+		return true;
+	}
+
+	double millisecondsSince(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}
+
+	// out.cpp is written to out_0.cpp ... out_<n-1>.cpp
+	vector<string> outputFiles(const string& output, size_t shards)
+	{
+		if (shards <= 1) {
+			return { output };
+		}
+		const size_t slash = output.find_last_of('/');
+		size_t dot = output.find_last_of('.');
+		if (dot == string::npos || (slash != string::npos && dot < slash)) {
+			dot = output.size();
+		}
+		vector<string> ret;
+		for (size_t i = 0; i < shards; ++i) {
+			ret.push_back(output.substr(0, dot) + "_" + to_string(i) + output.substr(dot));
+		}
+		return ret;
+	}
+
+	/* Only replaces output if its contents change, so that build systems
+	 * do not recompile generated files that are still the same.
+	 */
+	bool writeFile(const string& output, const string& content)
+	{
+		if (output == "-") {
+			cout << content;
+			return true;
+		}
+
+		ifstream in(output, ios::binary);
+		if (in.is_open()) {
+			stringstream old;
+			old << in.rdbuf();
+			if (old.str() == content) {
+				return true;
+			}
+		}
+
+		const string tmp = output + "." + to_string(getpid());
+		std::ofstream out(tmp, ios::binary);
+		if (!out.is_open()) {
+			cerr << "cannot open output file " << output << endl;
+			return false;
+		}
+		out << content;
+		out.close();
+		if (!out || rename(tmp.c_str(), output.c_str()) != 0) {
+			cerr << "cannot write output file " << output << endl;
+			unlink(tmp.c_str());
+			return false;
+		}
+		return true;
+	}
+
+	bool sameContents(const string& file1, const string& file2)
+	{
+		ifstream in1(file1, ios::binary | ios::ate);
+		ifstream in2(file2, ios::binary | ios::ate);
+		if (!in1.is_open() || !in2.is_open() || in1.tellg() != in2.tellg()) {
+			return false;
+		}
+		in1.seekg(0);
+		in2.seekg(0);
+		return std::equal(istreambuf_iterator<char>(in1), istreambuf_iterator<char>(), istreambuf_iterator<char>(in2));
+	}
+
+	// Like writeFile, for contents that were streamed to tmp
+	bool replaceFile(const string& tmp, const string& output)
+	{
+		if (sameContents(tmp, output)) {
+			unlink(tmp.c_str());
+			return true;
+		}
+		return rename(tmp.c_str(), output.c_str()) == 0;
+	}
+
+	bool write(const string& output, const TranslationUnit& tu, const ClassIndex& index, bool diagsOn, bool methodTables, size_t shards, uint64_t* hash = nullptr)
+	{
+		const vector<string> files = outputFiles(output, shards);
+		const vector<TranslationUnit> units = shards > 1 ? shard(tu, shards) : vector<TranslationUnit>();
+
+		uint64_t h = Manifest::hash("");
+		for (size_t i = 0; i < files.size(); ++i) {
+			stringstream ss;
+			definitions::print(units.empty() ? tu : units[i], index, ss, diagsOn, methodTables);
+			const string content = ss.str();
+			h = Manifest::hash(content, h);
+
+			if (!writeFile(files[i], content)) {
+				return false;
+			}
+		}
+
+		if (hash) {
+			*hash = h;
+		}
+		return true;
+	}
+
+	// The binary meta-data is chained to hash, if given
+	bool writeBinaryMetadata(const string& file, const TranslationUnit& tu, const ClassIndex& index, uint64_t* hash = nullptr)
+	{
+		stringstream ss;
+		definitions::writeBinary(tu, index, ss);
+		const string content = ss.str();
+		if (hash) {
+			*hash = Manifest::hash(content, *hash);
+		}
+		return writeFile(file, content);
+	}
+
+	// Everything besides the inputs that determines the output
+	uint64_t optionsHash(const vector<string>& args, bool iFaceDiags, bool forceTemplates, bool methodTables, size_t shards)
+	{
+		string key = iFaceDiags ? "diags" : "nodiags";
+		key += "\nshards " + to_string(shards);
+		key += forceTemplates ? "\ntemplates" : "\nnotemplates";
+		key += methodTables ? "\ntables" : "\nnotables";
+		for (const string& a: args) {
+			key += '\n';
+			key += a;
+		}
+		return Manifest::hash(key);
+	}
+
+	string currentDirectory()
+	{
+		char buffer[PATH_MAX];
+		if (!getcwd(buffer, sizeof(buffer))) {
+			cerr << "cannot get the current directory" << endl;
+			exit(1);
+		}
+		return buffer;
+	}
+
+	// one header per line, empty lines and lines starting with # are ignored,
+	// relative paths are relative to the current directory
+	vector<Input> readHeaderList(const string& path)
+	{
+		ifstream in(path);
+		if (!in.is_open()) {
+			cerr << "cannot open header list " << path << endl;
+			exit(1);
+		}
+		vector<Input> ret;
+		string line;
+		while (getline(in, line)) {
+			auto begin = line.find_first_not_of(" \t\r");
+			if (begin == string::npos || line[begin] == '#') {
+				continue;
+			}
+			auto end = line.find_last_not_of(" \t\r");
+			Input input;
+			input.command.directory = currentDirectory();
+			input.command.file = line.substr(begin, end - begin + 1);
+			ret.push_back(std::move(input));
+		}
+		return ret;
+	}
+
+	vector<Input> readCompileCommands(const string& path)
+	{
+		vector<Input> ret;
+		try {
+			for (parser::Command& command: parser::readCompileCommands(path)) {
+				Input input;
+				input.command = std::move(command);
+				// the compiler is ours
+				input.command.flags.erase(input.command.flags.begin());
+				ret.push_back(std::move(input));
+			}
+		} catch (const std::runtime_error& ex) {
+			cerr << ex.what() << endl;
+			exit(1);
+		}
+		return ret;
+	}
+
+	string outputName(const string& dir, const string& file)
+	{
+		string name = file.substr(file.find_last_of('/') + 1);
+		name = name.substr(0, name.find_last_of('.')) + ".cpp";
+		return dir + "/" + name;
+	}
+
+}
+
+int main(int argc, const char* argv[])
+{
+	vector<const char*> args;
+	set<int> skip;
+	bool foundCpp = false;
+	bool foundStd = false;
+	bool foundSpellChecking = false;
+	bool iFaceDiags = false;
+	bool forceTemplates = true;
+	bool methodTables = false;
+	string output;
+	string outputDir;
+	string headerList;
+	string compileCommands;
+	string prelude;
+	string pchCache;
+	string manifestFile;
+	string binaryMetadata;
+	string json;
+	size_t shards = 1;
+	bool timing = false;
+	unsigned jobs = std::max(1u, std::thread::hardware_concurrency());
+
+	args.push_back(argv[0]);
+	args.push_back("-Qunused-arguments"); // why do I keep getting warnings about the unused linker if I'm only creating an ASTunit
+
+	for (int i = 1; i < argc; ++i) {
+		if (strncmp(argv[i], "-std=", 5) == 0) {
+			foundStd = true;
+		} else if (strcmp(argv[i], "-x") == 0) {
+			if (((i+1) < argc) && (strcmp(argv[i+1], "c++") == 0)) {
+				foundCpp = true;
+			}
+		} else if (strcmp(argv[i], "-xc++") == 0) {
+			foundCpp = true;
+		} else if (strcmp(argv[i], "-fno-spell-checking") == 0) {
+			foundSpellChecking = true;
+		} else if (strcmp(argv[i], "-fspell-checking") == 0) {
+			foundSpellChecking = true;
+		} else if (strncmp(argv[i], "-o", 2) == 0) {
+
+			if (argv[i][2] != '\0') {
+				output = &argv[i][2];
+			} else {
+				if ((i+1) == argc) {
+					cerr << "No argument given to -o option" << endl;
+					exit(1);
+				}
+				output = argv[i+1];
+			}
+		} else if (strcmp(argv[i], "--interface-diagnostics") == 0) {
+			iFaceDiags = true;
+			skip.insert(i);
+		} else if (strcmp(argv[i], "--no-force-templates") == 0) {
+			forceTemplates = false;
+			skip.insert(i);
+		} else if (strcmp(argv[i], "--method-tables") == 0) {
+			methodTables = true;
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--batch=", 8) == 0) {
+			headerList = &argv[i][8];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--compile-commands=", 19) == 0) {
+			compileCommands = &argv[i][19];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--output-dir=", 13) == 0) {
+			outputDir = &argv[i][13];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--prelude=", 10) == 0) {
+			prelude = &argv[i][10];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--pch-cache=", 12) == 0) {
+			pchCache = &argv[i][12];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--manifest=", 11) == 0) {
+			manifestFile = &argv[i][11];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--binary-metadata=", 18) == 0) {
+			binaryMetadata = &argv[i][18];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--json=", 7) == 0) {
+			json = &argv[i][7];
+			skip.insert(i);
+		} else if (strncmp(argv[i], "--shards=", 9) == 0) {
+			shards = std::max(1, atoi(&argv[i][9]));
+			skip.insert(i);
+		} else if (strcmp(argv[i], "--timing") == 0) {
+			timing = true;
+			skip.insert(i);
+		} else if (strncmp(argv[i], "-j", 2) == 0) {
+			const char* n = argv[i] + 2;
+			skip.insert(i);
+			if (*n == '\0') {
+				if ((i+1) == argc) {
+					cerr << "No argument given to -j option" << endl;
+					exit(1);
+				}
+				n = argv[++i];
+				skip.insert(i);
+			}
+			jobs = std::max(1, atoi(n));
+		}
+	}
+
+	const bool batch = !headerList.empty() || !compileCommands.empty();
+
+	if (output.empty() && (batch ? (outputDir.empty() && binaryMetadata.empty()) : json.empty())) {
+		cerr << "No output given" << endl;
+		exit(1);
+	}
+
+	if (batch && !json.empty()) {
+		cerr << "JSON output is not supported in batch mode" << endl;
+		exit(1);
+	}
+
+	if (shards > 1 && output == "-") {
+		cerr << "Sharded output cannot be written to stdout" << endl;
+		exit(1);
+	}
+
+
+	if (!foundCpp) {
+		args.push_back("-xc++");
+	}
+
+	if (!foundStd) {
+		args.push_back("-std=c++11");
+	}
+
+	if (!foundSpellChecking) {
+		args.push_back("-fno-spell-checking");
+	}
+
+	for (int i = 1; i < argc; ++i) {
+		if (!skip.count(i)) {
+			args.push_back(argv[i]);
+		}
+	}
+
+	string mainFile;
+	const vector<const char*> flags = compilerFlags(args, &mainFile);
+
+	if (!batch && mainFile.empty()) {
+		cerr << "No input given" << endl;
+		exit(1);
+	}
+
+	string pch;
+	if (!prelude.empty()) {
+		if (pchCache.empty()) {
+			const char* tmp = getenv("TMPDIR");
+			pchCache = tmp ? tmp : "/tmp";
+		}
+		auto start = std::chrono::steady_clock::now();
+		if (!precompilePrelude({ currentDirectory(), prelude, vector<string>(flags.begin(), flags.end()) }, pchCache, pch)) {
+			exit(1);
+		}
+		if (timing) {
+			cerr << prelude << ": precompiled prelude ready in " << millisecondsSince(start) << " ms" << endl;
+		}
+		args.push_back("-include-pch");
+		args.push_back(pch.c_str());
+	}
+
+	// With a manifest, outputs whose inputs did not change are neither
+	// parsed nor written again
+	Manifest manifest;
+	const bool incremental = !manifestFile.empty();
+	if (incremental) {
+		manifest.load(manifestFile);
+	}
+
+	if (!batch) {
+		const vector<const char*> commandFlags = compilerFlags(args);
+		const parser::Command command = { currentDirectory(), mainFile, vector<string>(commandFlags.begin(), commandFlags.end()) };
+		const uint64_t flagsHash = optionsHash(vector<string>(args.begin(), args.end()), iFaceDiags, forceTemplates, methodTables, shards);
+		// the binary meta-data and the JSON lines are more outputs of the same entry
+		vector<string> files = outputFiles(output, shards);
+		if (!binaryMetadata.empty()) {
+			files.push_back(binaryMetadata);
+		}
+		if (!json.empty()) {
+			files.push_back(json);
+		}
+		const bool manifestEntry = incremental && !output.empty() && output != "-" && json != "-";
+		if (manifestEntry && manifest.upToDate(output, flagsHash, files)) {
+			if (timing) {
+				cerr << mainFile << ": up to date" << endl;
+			}
+			return 0;
+		}
+
+		// The JSON lines are written while parsing. When nothing else
+		// needs the declarations they are dropped as soon as they are
+		// written, giant headers do not have to fit in memory twice.
+		const bool keepDeclarations = !output.empty() || !binaryMetadata.empty();
+		const string jsonTmp = json + "." + to_string(getpid());
+		std::ofstream jsonFile;
+		if (!json.empty() && json != "-") {
+			jsonFile.open(jsonTmp, ios::binary);
+			if (!jsonFile.is_open()) {
+				cerr << "cannot open output file " << json << endl;
+				exit(1);
+			}
+		}
+		JsonLinesWriter jsonWriter(json == "-" ? cout : jsonFile);
+
+		TranslationUnit tu;
+		vector<string> dependencies;
+		auto start = std::chrono::steady_clock::now();
+		if (!parser::parse(command, tu, forceTemplates, nullptr, &dependencies, json.empty() ? nullptr : &jsonWriter, keepDeclarations)) {
+			if (jsonFile.is_open()) {
+				unlink(jsonTmp.c_str());
+			}
+			return 1;
+		}
+		if (timing) {
+			cerr << mainFile << ": parsed in " << millisecondsSince(start) << " ms" << endl;
+		}
+		if (jsonFile.is_open()) {
+			jsonFile.close();
+			if (!jsonFile || !replaceFile(jsonTmp, json)) {
+				cerr << "cannot write output file " << json << endl;
+				unlink(jsonTmp.c_str());
+				exit(1);
+			}
+		}
+		uint64_t outputHash = Manifest::hash("");
+		if (!output.empty() && !write(output, tu, tu.classIndex, iFaceDiags, methodTables, shards, &outputHash)) {
+			exit(1);
+		}
+		if (!binaryMetadata.empty() && !writeBinaryMetadata(binaryMetadata, tu, tu.classIndex, &outputHash)) {
+			exit(1);
+		}
+		// the JSON lines were streamed, they are chained last like in files
+		if (manifestEntry && !json.empty() && !Manifest::hashFiles({json}, outputHash, outputHash)) {
+			cerr << "cannot read output file " << json << endl;
+			exit(1);
+		}
+		if (manifestEntry) {
+			if (!pch.empty()) {
+				dependencies.push_back(pch);
+			}
+			manifest.update(output, flagsHash, outputHash, dependencies);
+			if (!manifest.save(manifestFile)) {
+				cerr << "cannot write manifest " << manifestFile << endl;
+			}
+		}
+		return 0;
+	}
+
+	// Batch mode: the inputs are parsed in parallel by clang's tooling, the
+	// results share one ClassIndex so that base classes declared in other
+	// headers can be resolved.
+
+	vector<Input> inputs = headerList.empty() ? readCompileCommands(compileCommands) : readHeaderList(headerList);
+
+	if (!outputDir.empty()) {
+		set<string> names;
+		for (Input& input: inputs) {
+			input.output = outputName(outputDir, input.command.file);
+			if (!names.insert(input.output).second) {
+				cerr << "more than one input would be written to " << input.output << endl;
+				exit(1);
+			}
+		}
+	}
+
+	auto commandFor = [&](const Input& input) -> parser::Command {
+		parser::Command ret = input.command;
+		ret.flags.assign(args.begin(), args.end());
+		ret.flags.insert(ret.flags.end(), input.command.flags.begin(), input.command.flags.end());
+		return ret;
+	};
+
+	string allFlags;
+	for (Input& input: inputs) {
+		input.ok = false;
+		input.skipped = false;
+		const parser::Command command = commandFor(input);
+		vector<string> key = command.flags;
+		key.push_back(command.directory);
+		key.push_back(command.file);
+		input.flags = optionsHash(key, iFaceDiags, forceTemplates, methodTables, shards);
+		allFlags += to_string(input.flags) + "\n";
+	}
+	const uint64_t mergedFlags = Manifest::hash(allFlags);
+
+	// the merged output and the binary meta-data need every unit, so they
+	// are all or nothing
+	const bool needsAllUnits = !output.empty() || !binaryMetadata.empty();
+	const bool mergedUpToDate = incremental && output != "-" && needsAllUnits
+			&& (output.empty() || manifest.upToDate(output, mergedFlags, outputFiles(output, shards)))
+			&& (binaryMetadata.empty() || manifest.upToDate(binaryMetadata, mergedFlags, {binaryMetadata}));
+	if (mergedUpToDate) {
+		bool upToDate = true;
+		for (const Input& input: inputs) {
+			if (!input.output.empty() && !manifest.upToDate(input.output, input.flags, outputFiles(input.output, shards))) {
+				upToDate = false;
+				break;
+			}
+		}
+		if (upToDate) {
+			if (timing) {
+				cerr << "all " << inputs.size() << " files are up to date" << endl;
+			}
+			return 0;
+		}
+	}
+
+	vector<Input*> toParse;
+	vector<parser::Command> commands;
+	for (Input& input: inputs) {
+		if (incremental && !needsAllUnits && manifest.upToDate(input.output, input.flags, outputFiles(input.output, shards))) {
+			input.ok = input.skipped = true;
+			continue;
+		}
+		toParse.push_back(&input);
+		commands.push_back(commandFor(input));
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	vector<parser::Result> results = parser::parseAll(commands, forceTemplates, jobs);
+	for (size_t i = 0; i < results.size(); ++i) {
+		Input& input = *toParse[i];
+		parser::Result& result = results[i];
+		input.ok = result.ok;
+		input.tu = std::move(result.tu);
+		input.dependencies = std::move(result.dependencies);
+		if (!pch.empty()) {
+			input.dependencies.push_back(pch);
+		}
+		cerr << result.diagnostics;
+		if (timing) {
+			cerr << input.command.file << ": parsed in " << result.milliseconds << " ms" << endl;
+		}
+	}
+	if (timing) {
+		cerr << commands.size() << " files parsed in " << millisecondsSince(start) << " ms" << endl;
+	}
+
+	vector<TranslationUnit> units;
+	vector<string> allDependencies;
+	int ret = 0;
+	for (Input& input: inputs) {
+		if (input.skipped) {
+			continue;
+		} else if (input.ok) {
+			units.push_back(input.tu);
+			allDependencies.insert(allDependencies.end(), input.dependencies.begin(), input.dependencies.end());
+		} else {
+			cerr << "failed to parse " << input.command.file << endl;
+			ret = 1;
+		}
+	}
+
+	TranslationUnit merged = merge(units);
+
+	if (!outputDir.empty()) {
+		for (const Input& input: inputs) {
+			if (!input.ok || input.skipped) {
+				continue;
+			}
+			uint64_t outputHash;
+			if (!write(input.output, input.tu, merged.classIndex, iFaceDiags, methodTables, shards, &outputHash)) {
+				ret = 1;
+			} else if (incremental) {
+				manifest.update(input.output, input.flags, outputHash, input.dependencies);
+			}
+		}
+	}
+
+	if (!output.empty()) {
+		uint64_t outputHash;
+		if (!write(output, merged, merged.classIndex, iFaceDiags, methodTables, shards, &outputHash)) {
+			ret = 1;
+		} else if (incremental && ret == 0 && output != "-") {
+			sort(allDependencies.begin(), allDependencies.end());
+			allDependencies.erase(unique(allDependencies.begin(), allDependencies.end()), allDependencies.end());
+			manifest.update(output, mergedFlags, outputHash, allDependencies);
+		}
+	}
+
+	if (!binaryMetadata.empty()) {
+		uint64_t outputHash = Manifest::hash("");
+		if (!writeBinaryMetadata(binaryMetadata, merged, merged.classIndex, &outputHash)) {
+			ret = 1;
+		} else if (incremental && ret == 0) {
+			sort(allDependencies.begin(), allDependencies.end());
+			allDependencies.erase(unique(allDependencies.begin(), allDependencies.end()), allDependencies.end());
+			manifest.update(binaryMetadata, mergedFlags, outputHash, allDependencies);
+		}
+	}
+
+	if (incremental && !manifest.save(manifestFile)) {
+		cerr << "cannot write manifest " << manifestFile << endl;
+	}
+
+	return ret;
+}
@@ -0,0 +1,183 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "manifest.h"
+
+#include <fstream>
+#include <sstream>
+#include <cstdio>
+
+#include <sys/stat.h>
+#include <unistd.h>
+using namespace std;
+
+namespace {
+
+	const char* header = "selfportrait-manifest 1";
+
+	bool stat(const string& path, long long& mtime, long long& size) {
+		struct stat st;
+		if (::stat(path.c_str(), &st) != 0) {
+			return false;
+		}
+		mtime = st.st_mtime;
+		size = st.st_size;
+		return true;
+	}
+
+}
+
+uint64_t Manifest::hash(const std::string& s, uint64_t seed)
+{
+	// FNV-1a, stable across runs and platforms
+	for (unsigned char c: s) {
+		seed ^= c;
+		seed *= 1099511628211ULL;
+	}
+	return seed;
+}
+
+bool Manifest::hashFile(const std::string& path, uint64_t& h)
+{
+	return hashFiles({path}, h);
+}
+
+bool Manifest::hashFiles(const std::vector<std::string>& paths, uint64_t& h, uint64_t seed)
+{
+	uint64_t ret = seed;
+	for (const string& path: paths) {
+		ifstream in(path, ios::binary);
+		if (!in.is_open()) {
+			return false;
+		}
+		stringstream ss;
+		ss << in.rdbuf();
+		ret = hash(ss.str(), ret);
+	}
+	h = ret;
+	return true;
+}
+
+void Manifest::load(const std::string& path)
+{
+	ifstream in(path);
+	string line;
+	if (!getline(in, line) || line != header) {
+		// missing or from another version, everything gets regenerated
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	while (getline(in, line)) {
+		istringstream ss(line);
+		string output;
+		Entry e;
+		size_t count = 0;
+		ss >> hex >> e.flags >> e.output >> dec >> count;
+		if (!ss || !getline(ss.ignore(), output)) {
+			break;
+		}
+		for (size_t i = 0; i < count && getline(in, line); ++i) {
+			istringstream ds(line);
+			Dependency d;
+			ds >> d.mtime >> d.size >> hex >> d.hash;
+			if (ds && getline(ds.ignore(), d.path)) {
+				e.dependencies.push_back(std::move(d));
+			}
+		}
+		if (e.dependencies.size() == count) {
+			m_entries[output] = std::move(e);
+		}
+	}
+}
+
+bool Manifest::save(const std::string& path) const
+{
+	const string tmp = path + "." + to_string(getpid());
+	{
+		ofstream out(tmp);
+		if (!out.is_open()) {
+			return false;
+		}
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		out << header << "\n";
+		for (const auto& x: m_entries) {
+			const Entry& e = x.second;
+			out << hex << e.flags << " " << e.output << dec << " " << e.dependencies.size() << " " << x.first << "\n";
+			for (const Dependency& d: e.dependencies) {
+				out << d.mtime << " " << d.size << " " << hex << d.hash << dec << " " << d.path << "\n";
+			}
+		}
+		out.close();
+		if (!out) {
+			unlink(tmp.c_str());
+			return false;
+		}
+	}
+	return rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+bool Manifest::upToDate(const std::string& output, uint64_t flags) const
+{
+	return upToDate(output, flags, {output});
+}
+
+bool Manifest::upToDate(const std::string& output, uint64_t flags, const std::vector<std::string>& files) const
+{
+	Entry e;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto it = m_entries.find(output);
+		if (it == m_entries.end()) {
+			return false;
+		}
+		e = it->second;
+	}
+
+	uint64_t h;
+	if (e.flags != flags || !hashFiles(files, h) || h != e.output) {
+		return false;
+	}
+
+	for (const Dependency& d: e.dependencies) {
+		long long mtime, size;
+		if (!stat(d.path, mtime, size) || size != d.size) {
+			return false;
+		}
+		// only read files that were touched
+		if (mtime != d.mtime && (!hashFile(d.path, h) || h != d.hash)) {
+			return false;
+		}
+	}
+	return true;
+}
+
+bool Manifest::update(const std::string& output, uint64_t flags, uint64_t outputHash, const std::vector<std::string>& dependencies)
+{
+	Entry e;
+	e.flags = flags;
+	e.output = outputHash;
+	bool complete = true;
+	for (const string& path: dependencies) {
+		Dependency d;
+		d.path = path;
+		if (!stat(path, d.mtime, d.size) || !hashFile(path, d.hash)) {
+			complete = false;
+			break;
+		}
+		e.dependencies.push_back(std::move(d));
+	}
+
+	// an entry missing a dependency would keep the output when it changes
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (complete) {
+		m_entries[output] = std::move(e);
+	} else {
+		m_entries.erase(output);
+	}
+	return complete;
+}
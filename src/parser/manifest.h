@@ -0,0 +1,61 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+
+/* Remembers for every generated file the flags and the contents of all
+ * files it was generated from, so that an output whose header, transitive
+ * includes and flags did not change need not be parsed again.
+ */
+class Manifest {
+public:
+
+	static uint64_t hash(const std::string& s, uint64_t seed = 14695981039346656037ULL);
+
+	//! Hash of the contents of path, false if it cannot be read
+	static bool hashFile(const std::string& path, uint64_t& hash);
+
+	//! Hash of the concatenated contents of paths, chained to seed
+	static bool hashFiles(const std::vector<std::string>& paths, uint64_t& hash, uint64_t seed = Manifest::hash(""));
+
+	void load(const std::string& path);
+
+	bool save(const std::string& path) const;
+
+	//! True if output exists unmodified and was generated with these flags from unchanged files
+	bool upToDate(const std::string& output, uint64_t flags) const;
+
+	//! Same for an output that was written to several files
+	bool upToDate(const std::string& output, uint64_t flags, const std::vector<std::string>& files) const;
+
+	//! Records output, or forgets it when a dependency cannot be read: it is then always regenerated
+	bool update(const std::string& output, uint64_t flags, uint64_t outputHash, const std::vector<std::string>& dependencies);
+
+private:
+
+	struct Dependency {
+		std::string path;
+		long long mtime;
+		long long size;
+		uint64_t hash;
+	};
+
+	struct Entry {
+		uint64_t flags;
+		uint64_t output;
+		std::vector<Dependency> dependencies;
+	};
+
+	std::unordered_map<std::string, Entry> m_entries;
+	mutable std::mutex m_mutex;
+};
+
+#endif /* MANIFEST_H */
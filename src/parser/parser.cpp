@@ -2,59 +2,45 @@
 ** SelfPortrait API
 ** See Copyright Notice in reflection.h
 */
-#include "llvm/Support/Host.h"
-
-#include "clang/Driver/Compilation.h"
-#include "clang/Driver/Driver.h"
-#include "clang/Driver/Tool.h"
-#include "clang/Frontend/CompilerInvocation.h"
-#include "clang/Basic/DiagnosticOptions.h"
-#include "clang/Frontend/FrontendDiagnostic.h"
-#include "clang/Frontend/TextDiagnosticPrinter.h"
-
-#include "clang/Frontend/CompilerInstance.h"
-#include "clang/Frontend/Utils.h"
-#include "clang/Basic/TargetOptions.h"
-#include "clang/Basic/TargetInfo.h"
-#include "clang/Basic/FileManager.h"
-#include "clang/Basic/SourceManager.h"
-#include "clang/Lex/Preprocessor.h"
-#include "clang/Basic/Diagnostic.h"
 #include "clang/AST/ASTContext.h"
-#include "clang/AST/ASTConsumer.h"
-#include "clang/Frontend/ASTUnit.h"
-#include "clang/Parse/Parser.h"
-#include "clang/Parse/ParseAST.h"
 #include "clang/AST/Decl.h"
 #include "clang/AST/DeclTemplate.h"
-#include "clang/Basic/LangOptions.h"
+#include "clang/AST/RecursiveASTVisitor.h"
+#include "clang/Basic/Diagnostic.h"
+#include "clang/Basic/DiagnosticOptions.h"
+#include "clang/Basic/FileManager.h"
+#include "clang/Basic/SourceManager.h"
+#include "clang/Basic/Version.h"
+#include "clang/Frontend/CompilerInstance.h"
+#include "clang/Frontend/FrontendActions.h"
+#include "clang/Frontend/TextDiagnosticPrinter.h"
 #include "clang/Sema/Sema.h"
+#include "clang/Sema/SemaConsumer.h"
 #include "clang/Sema/Template.h"
-
+#include "clang/Tooling/AllTUsExecution.h"
+#include "clang/Tooling/CompilationDatabase.h"
+#include "clang/Tooling/JSONCompilationDatabase.h"
+#include "clang/Tooling/Tooling.h"
+#include "llvm/Support/Path.h"
+#include "llvm/Support/VirtualFileSystem.h"
+#include "llvm/Support/raw_ostream.h"
 
 #include <vector>
 #include <string>
-#include <set>
+#include <list>
 #include <iostream>
-#include <fstream>
-#include <sstream>
 #include <stdexcept>
 #include <unordered_map>
+#include <unordered_set>
+#include <chrono>
 
-#include "definitions.h"
+#include "parser.h"
 using namespace definitions;
 
 using namespace std;
 using namespace clang;
 using namespace llvm;
 
-template<class... Args, template<class...> class Associative>
-bool contains(const Associative<Args...>& container, const typename Associative<Args...>::key_type& key)
-{
-	auto it = container.find(key);
-	return (it != container.end());
-}
-
 template<class... Args, template<class...> class Container>
 std::string join(const Container<Args...>& container, const std::string& separator)
 {
@@ -75,16 +61,30 @@ std::string join(const Container<Args...>& container, const std::string& separat
 }
 
 
-class MyASTConsumer
+/* Walks the declarations like the code generator needs them: only the
+ * definitions of classes, the specializations instead of the templates,
+ * no function bodies.
+ */
+class DeclarationVisitor : public RecursiveASTVisitor<DeclarationVisitor>
 {
-	TranslationUnit m_tu;
+	typedef RecursiveASTVisitor<DeclarationVisitor> Base;
+
+	TranslationUnit& m_tu;
 	TranslationUnitBuilder m_builder;
 
-	SourceManager* m_sourceManager;
+	SourceManager& m_sourceManager;
 	PrintingPolicy m_printPol;
-	set<Decl*> m_visited;
+	unordered_set<const Decl*> m_visited;
+	// spelling of each canonical type printed so far
+	unordered_map<void*, string> m_spellings;
+	// whether a specialization could be instantiated, it is attempted only once
+	unordered_map<const ClassTemplateSpecializationDecl*, bool> m_instantiated;
+	// how many specializations of a template were instantiated for incomplete types
+	unordered_map<const ClassTemplateDecl*, size_t> m_specializationsSeen;
 	Sema& m_sema;
 	bool m_instantiateTemplates;
+	// of the top level declaration being visited
+	bool m_inMainFile;
 
 
 	struct IncompleteType {
@@ -95,31 +95,59 @@ class MyASTConsumer
 	struct PrivateType {};
 
 	string printType(string orig) {
+		size_t pos = orig.find(',');
+		if (pos == string::npos) {
+			return orig;
+		}
 		string ret;
+		ret.reserve(orig.size() + 8);
 
-		for (auto c: orig) {
-			if (c == ',') {
-				ret += " COMMA ";
-			} else {
-				ret += c;
-			}
+		size_t begin = 0;
+		for (; pos != string::npos; pos = orig.find(',', begin)) {
+			ret.append(orig, begin, pos - begin);
+			ret += " COMMA ";
+			begin = pos + 1;
 		}
+		ret.append(orig, begin, string::npos);
 		return ret;
 	}
 
-	string printType(QualType t) {
-		return printType(t.getAsString(m_printPol));
+	const string& printType(QualType t) {
+		auto it = m_spellings.find(t.getAsOpaquePtr());
+		if (it == m_spellings.end()) {
+			it = m_spellings.emplace(t.getAsOpaquePtr(), printType(t.getAsString(m_printPol))).first;
+		}
+		return it->second;
+	}
+
+	// instantiates spec with its members unless it still depends on template parameters
+	bool instantiate(ClassTemplateSpecializationDecl* spec, SourceLocation location) {
+		auto it = m_instantiated.find(spec);
+		if (it != m_instantiated.end()) {
+			return it->second;
+		}
+		string name;
+		raw_string_ostream ss(name);
+		spec->getNameForDiagnostic(ss, m_printPol, true);
+
+		const bool dependent = ss.str().find("type-parameter") != string::npos;
+		m_instantiated[spec] = !dependent;
+		if (!dependent) {
+			m_sema.InstantiateClassTemplateSpecialization(location, spec, TSK_ImplicitInstantiation, true);
+			m_sema.InstantiateClassMembers(location, spec, MultiLevelTemplateArgumentList(spec->getTemplateArgs()), TSK_ImplicitInstantiation);
+		}
+		return !dependent;
 	}
 
 	void treatIncompleteType (IncompleteType t, Decl* decl) {
 		SourceLocation start = t.range.getBegin();
-		const FileEntry* entry = m_sourceManager->getFileEntryForID(m_sourceManager->getFileID(start));
-		int line = m_sourceManager->getSpellingLineNumber(start);
-		int column = m_sourceManager->getSpellingColumnNumber(start);
+		const FileEntry* entry = m_sourceManager.getFileEntryForID(m_sourceManager.getFileID(start));
+		int line = m_sourceManager.getSpellingLineNumber(start);
+		int column = m_sourceManager.getSpellingColumnNumber(start);
 
 
 
-        cerr << (entry ? entry->getName() : "unknown location") << ":" <<
+        cerr << (entry ? entry->getName().str() : "unknown location") << ":" <<
 				line << ":" << column <<
 				": warning: Incomplete type " <<
 				t.type.getAsString(m_printPol) <<
@@ -133,7 +161,7 @@ class MyASTConsumer
 		}
 	}
 
-	QualType treatType(QualType&& t, SourceRange&& range, bool isInMainFile) {
+	QualType treatType(QualType&& t, SourceRange&& range) {
 
 		const Type* orig = t.getTypePtr();
 		const Type* type = nullptr;
@@ -173,17 +201,20 @@ class MyASTConsumer
 
 			if (const TypedefType* tt = dyn_cast<TypedefType>(type)) {
 				if (TypedefNameDecl* tnd = tt->getDecl()) {
-					return treatType(tnd->getUnderlyingType(), ::std::move(range), isInMainFile);
+					return treatType(tnd->getUnderlyingType(), ::std::move(range));
 				}
 			} else if (const auto* tt = dyn_cast<TemplateSpecializationType>(type)) {
 				if (m_instantiateTemplates) {
 					if (ClassTemplateDecl* td = dyn_cast<ClassTemplateDecl>(tt->getTemplateName().getAsTemplateDecl())) {
-						for (clang::ClassTemplateDecl::spec_iterator it = td->spec_begin(); it != td->spec_end(); ++it) {
-							clang::ClassTemplateSpecializationDecl* spec = *it;
+						// the specializations are kept in the order of their creation, only
+						// those added since the last incomplete type of td are new
+						size_t& seen = m_specializationsSeen[td];
+						while (seen < llvm::size(td->specializations())) {
+							ClassTemplateSpecializationDecl* spec = *(td->specializations().begin() + seen++);
 							if (!spec->hasDefinition()) {
 								m_sema.InstantiateClassTemplateSpecialization(range.getBegin(), spec, TSK_ImplicitInstantiation, false);
 								if (spec->hasDefinition()) {
-									handleDecl(spec->getDefinition(), isInMainFile);
+									TraverseDecl(spec->getDefinition());
 								}
 							}
 						}
@@ -201,25 +232,20 @@ class MyASTConsumer
 
 public:
 
-	MyASTConsumer(SourceManager* sm, ASTContext& astContext, Sema& sema, bool instantiateTemplates = true)
-		: m_builder(m_tu)
-		, m_sourceManager(sm)
+	// mainFile is included by the generated code as the user spelled it
+	DeclarationVisitor(TranslationUnit& tu, const string& mainFile, ASTContext& astContext, Sema& sema, bool instantiateTemplates = true, DeclarationSink* sink = nullptr, bool keepDeclarations = true)
+		: m_tu(tu)
+		, m_builder(m_tu, sink, keepDeclarations)
+		, m_sourceManager(astContext.getSourceManager())
 		, m_printPol(astContext.getLangOpts())
 		, m_sema(sema)
 		, m_instantiateTemplates(instantiateTemplates)
+		, m_inMainFile(false)
 	{
 		m_printPol.Bool = 1;
-		FileID mainID = sm->getMainFileID();
-		const FileEntry* entry = sm->getFileEntryForID(mainID);
 
 		m_tu.include_directives.push_back("#include <SelfPortrait/reflection_impl.h>");
-		m_tu.include_directives.push_back(std::string("#include \"") + entry->getName() + "\"");
-	}
-
-	ostream& print(ostream& os, bool diagsOn = false) {
-
-		definitions::print(m_tu, os, diagsOn);
-		return os;
+		m_tu.include_directives.push_back(std::string("#include \"") + mainFile + "\"");
 	}
 
 	Access convertClangsAccessSpec(AccessSpecifier as) const {
@@ -233,361 +259,583 @@ public:
 						Private;
 	}
 
-	void handleDecl(Decl* decl, bool isInMainFile)
+	// the implicit members are reflected like the declared ones
+	bool shouldVisitImplicitCode() const { return true; }
+
+	// the AST of the declarations is of no interest, nor are function bodies
+	bool TraverseStmt(Stmt*, DataRecursionQueue* = nullptr) { return true; }
+
+	bool TraverseDecl(Decl* decl)
 	{
+		if (decl == nullptr || !m_visited.insert(decl).second) {
+			return true;
+		}
+
 		try {
+			return Base::TraverseDecl(decl);
+		} catch (const IncompleteType& t) {
+			treatIncompleteType(t, decl);
+		} catch (const PrivateType& t) {
+		}
+		return true;
+	}
 
-			if (contains(m_visited, decl)) {
-				return;
-			} else {
-				m_visited.insert(decl);
-			}
+	bool TraverseTranslationUnitDecl(TranslationUnitDecl* tud)
+	{
+		for (Decl* subdecl: tud->decls()) {
+			m_inMainFile = m_sourceManager.isInMainFile(subdecl->getLocation());
+			TraverseDecl(subdecl);
+		}
+		return true;
+	}
 
-			if (decl == nullptr) {
-				return;
-			}
+	bool TraverseNamespaceDecl(NamespaceDecl* nd)
+	{
+		if (nd->isAnonymousNamespace()) {
+			return true; // no interest in hidden symbols
+		}
+		for (Decl* subdecl: nd->decls()) {
+			TraverseDecl(subdecl);
+		}
+		return true;
+	}
 
-			if (NamespaceDecl* nd = dyn_cast<NamespaceDecl>(decl)) {
-				if (nd->isAnonymousNamespace()) {
-					return; // no interest in hidden symbols
-				}
-				// recurse
-				for (DeclContext::decl_iterator it = nd->decls_begin(); it != nd->decls_end(); ++it) {
-					clang::Decl* subdecl = *it;
-					handleDecl(subdecl, isInMainFile);
-				}
+	// neither extern "C" blocks nor friends declare members
+	bool TraverseLinkageSpecDecl(LinkageSpecDecl*) { return true; }
 
-			} else if (FieldDecl *fd = dyn_cast<FieldDecl>(decl)) {
-				QualType t = treatType(fd->getType(), fd->getSourceRange(), isInMainFile);
-				Access access = convertClangsAccessSpec(decl->getAccess());
-				m_builder.addAttribute({fd->getDeclName().getAsString(), printType(t), access});
-
-			} else if (RecordDecl* rd = dyn_cast<RecordDecl>(decl)) {
-
-				if (CXXRecordDecl* crd = dyn_cast<CXXRecordDecl>(rd)) {
-
-					if (m_instantiateTemplates) {
-						// maybe we can force the definition to exist
-
-						if (ClassTemplateSpecializationDecl* spec = dyn_cast<ClassTemplateSpecializationDecl>(crd)) {
-
-                            string nameWithNamespace;
-                            raw_string_ostream ss(nameWithNamespace);
-                            spec->getNameForDiagnostic(ss, m_printPol, true);
-                            cout << "1 template name = "<< ss.str() << " is valid " << spec->getPointOfInstantiation().isValid() << endl;
-                            cout << "instantiation: " << crd->getTemplateSpecializationKind() << endl;
-                            //const TemplateArgumentList& list = spec->getTemplateArgs();
-                            if (nameWithNamespace.find("type-parameter") == string::npos) {
-                                cout << "treating " << endl;
-                                m_sema.InstantiateClassTemplateSpecialization(crd->getSourceRange().getBegin(), spec, TSK_ImplicitInstantiation, true);
-                                m_sema.InstantiateClassMembers(crd->getSourceRange().getBegin(), spec, MultiLevelTemplateArgumentList(spec->getTemplateArgs()),TSK_ImplicitInstantiation);
-                            } else {
-                                cout << "not treating " << endl;
-                            }
-						}
+	bool TraverseFriendDecl(FriendDecl*) { return true; }
 
-						if (ClassTemplateSpecializationDecl* spec = dyn_cast<ClassTemplateSpecializationDecl>(crd->getDeclContext())) {
-                            string nameWithNamespace;
-                            raw_string_ostream ss(nameWithNamespace);
-                            spec->getNameForDiagnostic(ss, m_printPol, true);
-                            cout << "2 template name = "<< ss.str() << " is valid " << spec->getPointOfInstantiation().isValid() << endl;
-                            //const TemplateArgumentList& list = spec->getTemplateArgs();
-
-                            if (nameWithNamespace.find("type-parameter") == string::npos) {
-							m_sema.InstantiateClassTemplateSpecialization(crd->getSourceRange().getBegin(), spec, TSK_ImplicitInstantiation, true);
-							m_sema.InstantiateClassMembers(crd->getSourceRange().getBegin(), spec, MultiLevelTemplateArgumentList(spec->getTemplateArgs()),TSK_ImplicitInstantiation);
-							return;
-                            }
-						}
-					}
+	bool TraverseCXXRecordDecl(CXXRecordDecl* crd) { return traverseClass(crd); }
 
-					if (crd->hasDefinition()) {
+	bool TraverseClassTemplateSpecializationDecl(ClassTemplateSpecializationDecl* spec) { return traverseClass(spec); }
 
-						CXXRecordDecl* definition = crd->getDefinition();
+	bool TraverseClassTemplatePartialSpecializationDecl(ClassTemplatePartialSpecializationDecl* spec) { return traverseClass(spec); }
 
-						m_visited.insert(definition);
+	// specializations are classes too, the templates themselves are not
+	bool TraverseClassTemplateDecl(ClassTemplateDecl* td)
+	{
+		if (m_instantiateTemplates) {
+			for (ClassTemplateSpecializationDecl* spec: td->specializations()) {
+				TraverseDecl(spec);
+			}
+		}
+		return true;
+	}
 
-                        string name;
-                        raw_string_ostream ss(name);
-                        definition->getNameForDiagnostic(ss, m_printPol, true);
+	bool TraverseFunctionTemplateDecl(FunctionTemplateDecl* td)
+	{
+		if (m_instantiateTemplates) {
+			for (FunctionDecl* spec: td->specializations()) {
+				TraverseDecl(spec);
+			}
+		}
+		return true;
+	}
 
-                        m_builder.pushClass({printType(ss.str()), isInMainFile});
+	bool traverseClass(CXXRecordDecl* crd)
+	{
+		if (m_instantiateTemplates) {
+			// maybe we can force the definition to exist
 
+			if (ClassTemplateSpecializationDecl* spec = dyn_cast<ClassTemplateSpecializationDecl>(crd)) {
+				instantiate(spec, crd->getSourceRange().getBegin());
+			}
 
-						for (auto it = definition->bases_begin(); it != definition->bases_end(); ++it) {
-							Access access = convertClangsAccessSpec(it->getAccessSpecifier());
-							QualType t = treatType(it->getType(), it->getSourceRange(), isInMainFile);
-							string classname = printType(t);
-							m_builder.addInheritance(classname, access);
-						}
+			if (ClassTemplateSpecializationDecl* spec = dyn_cast<ClassTemplateSpecializationDecl>(crd->getDeclContext())) {
+				if (instantiate(spec, crd->getSourceRange().getBegin())) {
+					return true;
+				}
+			}
+		}
 
-						// recurse
-						if (definition->needsImplicitDefaultConstructor()) {
-							m_builder.addConstructor({"", Public});
-						}
+		if (crd->hasDefinition()) {
 
-						// recurse
-						for (DeclContext::decl_iterator it = definition->decls_begin(); it != definition->decls_end(); ++it) {
-							clang::Decl* subdecl = *it;
-							handleDecl(subdecl, isInMainFile);
-						}
-						m_builder.popClass();
-
-					} /*else if (m_instantiateTemplates) {
-						// maybe we can force the definition to exist
-						if (ClassTemplateSpecializationDecl* spec = dyn_cast<ClassTemplateSpecializationDecl>(crd)) {
-							m_sema.InstantiateClassTemplateSpecialization(crd->getSourceRange().getBegin(), spec, TSK_ImplicitInstantiation, true);
-							m_sema.InstantiateClassMembers(crd->getSourceRange().getBegin(), spec, MultiLevelTemplateArgumentList(spec->getTemplateArgs()),TSK_ImplicitInstantiation);
-							if (crd->hasDefinition()) {
-								m_visited.erase(crd->getDefinition());
-								handleDecl(crd->getDefinition());
-							}
-						}
+			CXXRecordDecl* definition = crd->getDefinition();
 
-						if (ClassTemplateSpecializationDecl* spec = dyn_cast<ClassTemplateSpecializationDecl>(crd->getDeclContext())) {
-							m_sema.InstantiateClassTemplateSpecialization(crd->getSourceRange().getBegin(), spec, TSK_ImplicitInstantiation, true);
-							m_sema.InstantiateClassMembers(crd->getSourceRange().getBegin(), spec, MultiLevelTemplateArgumentList(spec->getTemplateArgs()),TSK_ImplicitInstantiation);
+			m_visited.insert(definition);
 
-							if (crd->hasDefinition()) {
-								m_visited.erase(crd->getDefinition());
-								handleDecl(crd->getDefinition());
-							}
-						}
-					}*/
-				} /*else {
-				// don't know what to do with this, the only possibility left are unions, right?
-			}*/
-
-			} /*else if (VarDecl *vd = llvm::dyn_cast<clang::VarDecl>(decl)) {
-			std::cout << vd << std::endl;
-			if( vd->isFileVarDecl() && vd->hasExternalStorage() )
-			{
-				std::cerr << "Read top-level variable decl: '";
-				std::cerr << vd->getDeclName().getAsString(m_printPol) ;
-				std::cerr << std::endl;
+            string name;
+            raw_string_ostream ss(name);
+            definition->getNameForDiagnostic(ss, m_printPol, true);
+
+            m_builder.pushClass({printType(ss.str()), m_inMainFile});
+
+
+			for (const CXXBaseSpecifier& base: definition->bases()) {
+				Access access = convertClangsAccessSpec(base.getAccessSpecifier());
+				QualType t = treatType(base.getType(), base.getSourceRange());
+				m_builder.addInheritance(printType(t), access);
 			}
 
-		}*/ else if (FunctionDecl* fd = llvm::dyn_cast<FunctionDecl>(decl)) {
+			// recurse
+			if (definition->needsImplicitDefaultConstructor()) {
+				m_builder.addConstructor({"", Public});
+			}
 
-				if (fd->isDeleted()) {
-					return;
-				}
+			// recurse
+			for (Decl* subdecl: definition->decls()) {
+				TraverseDecl(subdecl);
+			}
+			m_builder.popClass();
+		}
+		return true;
+	}
 
-				string name = fd->getNameAsString();
-				QualType qt = treatType(fd->getResultType(), fd->getSourceRange(), isInMainFile);
-				const string returnType =  printType(qt);
+	bool VisitFieldDecl(FieldDecl* fd)
+	{
+		QualType t = treatType(fd->getType(), fd->getSourceRange());
+		Access access = convertClangsAccessSpec(fd->getAccess());
+		m_builder.addAttribute({fd->getDeclName().getAsString(), printType(t), access});
+		return true;
+	}
 
-				list<string> args;
+	bool VisitFunctionDecl(FunctionDecl* fd)
+	{
+		if (fd->isDeleted()) {
+			return true;
+		}
 
+		string name = fd->getNameAsString();
+		QualType qt = treatType(fd->getReturnType(), fd->getSourceRange());
+		const string returnType =  printType(qt);
 
-				for (auto it = fd->param_begin(); it != fd->param_end(); ++it) {
-					ParmVarDecl* param = *it;
-					QualType pt = treatType(param->getType(), param->getSourceRange(), isInMainFile);
-					// if we should need the names, this is how we get them *it)->getDeclName().getAsString(m_printPol)
-					args.push_back(printType(pt));
-				}
+		list<string> args;
 
-				const string argstr = join(args, ", ");
 
-				if (CXXMethodDecl* md = dyn_cast<CXXMethodDecl>(decl)) {
+		for (ParmVarDecl* param: fd->parameters()) {
+			QualType pt = treatType(param->getType(), param->getSourceRange());
+			// if we should need the names, this is how we get them param->getDeclName().getAsString()
+			args.push_back(printType(pt));
+		}
 
-					if (!m_builder.inClass()) {
-						// out-of-class definitions are of no interest to us
-						return;
-					}
+		const string argstr = join(args, ", ");
 
-					if (dyn_cast<CXXConstructorDecl>(decl)) {
-						Access access = convertClangsAccessSpec(decl->getAccess());
-						m_builder.addConstructor({argstr, access});
-					} else if (dyn_cast<CXXConversionDecl>(decl)) {
-						// TODO
-						// ex: operator bool();
-						// dont't know what to do with this yet
-					} else if (dyn_cast<CXXDestructorDecl>(decl)) {
-						const bool isVirtual  = md->isVirtual();
-						Access access = convertClangsAccessSpec(decl->getAccess());
-						if (access == Public && isVirtual) {
-							m_builder.currentClass().destructor_is_public_virtual = true;
-						}
-					} else {
-
-						QualType mqt = treatType(md->getType(), md->getSourceRange(), isInMainFile);
-						// this prints the method type: mqt.getAsString(m_printPol)
-
-						const FunctionProtoType* proto = dyn_cast<const FunctionProtoType>(mqt.getTypePtr());
-
-						Qualifiers quals = Qualifiers::fromCVRMask(proto->getTypeQuals());
-
-						const bool isStatic      = md->isStatic();
-						const bool isPureVirtual = md->isPure();
-						const bool isConst       = quals.hasConst();
-						const bool isVolatile    = quals.hasVolatile();
-
-						string a = string(args.empty() ? "" : ", ") + argstr;
-						Access access = convertClangsAccessSpec(decl->getAccess());
-						const bool user = md->isUserProvided();
-						if (isStatic) {
-							m_builder.addMethod({name, returnType, argstr, false, false, false, true, access, user});
-						} else if (isConst && isVolatile) {
-							m_builder.addMethod({name, returnType, argstr, true, true, isPureVirtual, false, access, user});
-						} else if (isConst) {
-							m_builder.addMethod({name, returnType, argstr, true, false, isPureVirtual, false, access, user});
-						} else if (isVolatile) {
-							m_builder.addMethod({name, returnType, argstr, false, true, isPureVirtual, false, access, user});
-						} else {
-							m_builder.addMethod({name, returnType, argstr, false, false, isPureVirtual, false, access, user});
-						}
-					}
-				} else if (fd->hasLinkage() && fd->getLinkage() == ExternalLinkage) {
-					if (!isInMainFile) {
-						return;
-					}
-					// is not a method
-                    string nameWithNamespace;
-                    raw_string_ostream ss(nameWithNamespace);
-                    fd->getNameForDiagnostic(ss, m_printPol, true);
-					string a = string(args.empty() ? "" : ", ") + argstr;
-                    m_tu.functions.push_back({ss.str(), returnType, argstr});
-				}
-			} else if (clang::ClassTemplateDecl* td = llvm::dyn_cast<clang::ClassTemplateDecl>(decl)) {
-				if (m_instantiateTemplates) {
-					for (clang::ClassTemplateDecl::spec_iterator it = td->spec_begin(); it != td->spec_end(); ++it) {
-						//specializations are classes too
-						handleDecl(*it, isInMainFile);
-					}
+		if (CXXMethodDecl* md = dyn_cast<CXXMethodDecl>(fd)) {
+
+			if (!m_builder.inClass()) {
+				// out-of-class definitions are of no interest to us
+				return true;
+			}
+
+			if (isa<CXXConstructorDecl>(md)) {
+				Access access = convertClangsAccessSpec(md->getAccess());
+				m_builder.addConstructor({argstr, access});
+			} else if (isa<CXXConversionDecl>(md)) {
+				// TODO
+				// ex: operator bool();
+				// dont't know what to do with this yet
+			} else if (isa<CXXDestructorDecl>(md)) {
+				const bool isVirtual  = md->isVirtual();
+				Access access = convertClangsAccessSpec(md->getAccess());
+				if (access == Public && isVirtual) {
+					m_builder.currentClass().destructor_is_public_virtual = true;
 				}
-			} else if (clang::FunctionTemplateDecl* td = llvm::dyn_cast<clang::FunctionTemplateDecl>(decl)) {
-				if (m_instantiateTemplates) {
-					for (clang::FunctionTemplateDecl::spec_iterator it = td->spec_begin(); it != td->spec_end(); ++it) {
-						handleDecl(*it, isInMainFile);
-					}
+			} else {
+
+				QualType mqt = treatType(md->getType(), md->getSourceRange());
+				// this prints the method type: mqt.getAsString(m_printPol)
+
+				const FunctionProtoType* proto = dyn_cast<const FunctionProtoType>(mqt.getTypePtr());
+
+				Qualifiers quals = proto->getMethodQuals();
+
+				const bool isStatic      = md->isStatic();
+				const bool isPureVirtual = md->isPure();
+				const bool isConst       = quals.hasConst();
+				const bool isVolatile    = quals.hasVolatile();
+
+				Access access = convertClangsAccessSpec(md->getAccess());
+				const bool user = md->isUserProvided();
+				if (isStatic) {
+					m_builder.addMethod({name, returnType, argstr, false, false, false, true, access, user});
+				} else if (isConst && isVolatile) {
+					m_builder.addMethod({name, returnType, argstr, true, true, isPureVirtual, false, access, user});
+				} else if (isConst) {
+					m_builder.addMethod({name, returnType, argstr, true, false, isPureVirtual, false, access, user});
+				} else if (isVolatile) {
+					m_builder.addMethod({name, returnType, argstr, false, true, isPureVirtual, false, access, user});
+				} else {
+					m_builder.addMethod({name, returnType, argstr, false, false, isPureVirtual, false, access, user});
 				}
 			}
-		} catch (const IncompleteType& t) {
-			treatIncompleteType(t, decl);
-		} catch (const PrivateType& t) {
+		} else if (fd->hasLinkage() && fd->getFormalLinkage() == ExternalLinkage) {
+			if (!m_inMainFile) {
+				return true;
+			}
+			// is not a method
+            string nameWithNamespace;
+            raw_string_ostream ss(nameWithNamespace);
+            fd->getNameForDiagnostic(ss, m_printPol, true);
+            m_builder.addFunction({ss.str(), returnType, argstr});
 		}
+		return true;
 	}
 };
 
 
-int main(int argc, const char* argv[])
-{
-	vector<const char*> args;
-	set<int> skip;
-	bool foundCpp = false;
-	bool foundCpp11 = false;
-	bool foundSpellChecking = false;
-	bool iFaceDiags = false;
-	bool forceTemplates = true;
-	string output;
-
-	args.push_back(argv[0]);
-    args.push_back("-I/usr/lib64/clang/3.2/include"); // why can't clang find this from the resource path?
-    //args.push_back("-I/usr/lib/clang/3.2/include"); // why can't clang find this from the resource path?
-	args.push_back("-Qunused-arguments"); // why do I keep getting warnings about the unused linker if I'm only creating an ASTunit
-
-	for (int i = 1; i < argc; ++i) {
-		if (strcmp(argv[i], "-std=c++11") == 0) {
-			foundCpp11 = true;
-		} else if (strcmp(argv[i], "-x") == 0) {
-			if (((i+1) < argc) && (strcmp(argv[i+1], "c++") == 0)) {
-				foundCpp = true;
+namespace {
+
+	// file relative to directory, as the compiler run from there sees it
+	string absolutePath(const string& directory, const string& file)
+	{
+		SmallString<256> path(file);
+		if (!sys::path::is_absolute(path)) {
+			path = directory;
+			sys::path::append(path, file);
+		}
+		sys::path::remove_dots(path, /*remove_dot_dot=*/true);
+		return path.str().str();
+	}
+
+	class DeclarationConsumer : public SemaConsumer
+	{
+		parser::Result& m_result;
+		const parser::Command& m_command;
+		bool m_forceTemplates;
+		DeclarationSink* m_sink;
+		bool m_keepDeclarations;
+		Sema* m_sema;
+
+	public:
+		DeclarationConsumer(parser::Result& result, const parser::Command& command, bool forceTemplates, DeclarationSink* sink, bool keepDeclarations)
+			: m_result(result)
+			, m_command(command)
+			, m_forceTemplates(forceTemplates)
+			, m_sink(sink)
+			, m_keepDeclarations(keepDeclarations)
+			, m_sema(nullptr) {}
+
+		void InitializeSema(Sema& sema) override {
+			m_sema = &sema;
+		}
+
+		void ForgetSema() override {
+			m_sema = nullptr;
+		}
+
+		void HandleTranslationUnit(ASTContext& astContext) override {
+			if (astContext.getDiagnostics().hasErrorOccurred() || !m_sema) {
+				return;
 			}
-		} else if (strcmp(argv[i], "-xc++") == 0) {
-			foundCpp = true;
-		} else if (strcmp(argv[i], "-fno-spell-checking") == 0) {
-			foundSpellChecking = true;
-		} else if (strcmp(argv[i], "-fspell-checking") == 0) {
-			foundSpellChecking = true;
-		} else if (strncmp(argv[i], "-o", 2) == 0) {
-
-			if (argv[i][2] != '\0') {
-				output = &argv[i][2];
-			} else {
-				if ((i+1) == argc) {
-					cerr << "No argument given to -o option" << endl;
-					exit(1);
+
+			DeclarationVisitor visitor(m_result.tu, m_command.file, astContext, *m_sema, m_forceTemplates, m_sink, m_keepDeclarations);
+			visitor.TraverseDecl(astContext.getTranslationUnitDecl());
+
+			// the manifest stats them from wherever the parser runs
+			const SourceManager& sm = astContext.getSourceManager();
+			for (auto it = sm.fileinfo_begin(); it != sm.fileinfo_end(); ++it) {
+				m_result.dependencies.push_back(absolutePath(m_command.directory, it->first->getName().str()));
+			}
+		}
+	};
+
+	class DeclarationAction : public ASTFrontendAction
+	{
+		parser::Result& m_result;
+		const parser::Command& m_command;
+		bool m_forceTemplates;
+		DeclarationSink* m_sink;
+		bool m_keepDeclarations;
+
+	public:
+		DeclarationAction(parser::Result& result, const parser::Command& command, bool forceTemplates, DeclarationSink* sink, bool keepDeclarations)
+			: m_result(result)
+			, m_command(command)
+			, m_forceTemplates(forceTemplates)
+			, m_sink(sink)
+			, m_keepDeclarations(keepDeclarations) {}
+
+		std::unique_ptr<ASTConsumer> CreateASTConsumer(CompilerInstance&, StringRef) override {
+			return std::unique_ptr<ASTConsumer>(new DeclarationConsumer(m_result, m_command, m_forceTemplates, m_sink, m_keepDeclarations));
+		}
+	};
+
+	// a file to parse, with the command as the user gave it
+	struct Target {
+		const parser::Command* command;
+		parser::Result* result;
+	};
+
+	/* Creates the actions of all the files of a run, possibly on several
+	 * threads. Each file has its own Result, found by the absolute path
+	 * the compile commands were given with.
+	 */
+	class DeclarationActionFactory : public tooling::FrontendActionFactory
+	{
+		const unordered_map<string, Target>& m_targets;
+		bool m_forceTemplates;
+		DeclarationSink* m_sink;
+		bool m_keepDeclarations;
+		bool m_captureDiagnostics;
+
+		const Target* targetFor(const CompilerInvocation& invocation) const {
+			const FrontendOptions& options = invocation.getFrontendOpts();
+			if (options.Inputs.empty()) {
+				return nullptr;
+			}
+			auto it = m_targets.find(options.Inputs.front().getFile().str());
+			return it == m_targets.end() ? nullptr : &it->second;
+		}
+
+	public:
+		DeclarationActionFactory(const unordered_map<string, Target>& targets, bool forceTemplates, DeclarationSink* sink, bool keepDeclarations, bool captureDiagnostics)
+			: m_targets(targets)
+			, m_forceTemplates(forceTemplates)
+			, m_sink(sink)
+			, m_keepDeclarations(keepDeclarations)
+			, m_captureDiagnostics(captureDiagnostics) {}
+
+		// the actions are created by runInvocation
+		std::unique_ptr<FrontendAction> create() override {
+			return nullptr;
+		}
+
+		bool runInvocation(std::shared_ptr<CompilerInvocation> invocation, FileManager* files,
+						   std::shared_ptr<PCHContainerOperations> pchContainerOps, DiagnosticConsumer* diagConsumer) override
+		{
+			const Target* target = targetFor(*invocation);
+			if (!target) {
+				return false;
+			}
+			parser::Result& result = *target->result;
+			auto start = std::chrono::steady_clock::now();
+
+			string diagnostics;
+			raw_string_ostream diagOut(diagnostics);
+			std::unique_ptr<TextDiagnosticPrinter> printer;
+			if (m_captureDiagnostics) {
+				printer.reset(new TextDiagnosticPrinter(diagOut, &invocation->getDiagnosticOpts()));
+				diagConsumer = printer.get();
+			}
+
+			CompilerInstance compiler(std::move(pchContainerOps));
+			compiler.setInvocation(invocation);
+			compiler.setFileManager(files);
+			compiler.createDiagnostics(diagConsumer, /*ShouldOwnClient=*/false);
+			compiler.createSourceManager(*files);
+
+			DeclarationAction action(result, *target->command, m_forceTemplates, m_sink, m_keepDeclarations);
+			result.ok = compiler.ExecuteAction(action);
+			files->clearStatCache();
+
+			diagOut.flush();
+			result.diagnostics += diagnostics;
+			result.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			return result.ok;
+		}
+	};
+
+	// GeneratePCHAction that also tells which files went into the PCH
+	class PrecompileAction : public GeneratePCHAction
+	{
+		const parser::Command& m_command;
+		vector<string>* m_dependencies;
+
+	public:
+		PrecompileAction(const parser::Command& command, vector<string>* dependencies)
+			: m_command(command)
+			, m_dependencies(dependencies) {}
+
+		void EndSourceFileAction() override {
+			if (m_dependencies) {
+				const SourceManager& sm = getCompilerInstance().getSourceManager();
+				for (auto it = sm.fileinfo_begin(); it != sm.fileinfo_end(); ++it) {
+					m_dependencies->push_back(absolutePath(m_command.directory, it->first->getName().str()));
 				}
-				output = argv[i+1];
 			}
-		} else if (strcmp(argv[i], "--interface-diagnostics") == 0) {
-			iFaceDiags = true;
-			skip.insert(i);
-		} else if (strcmp(argv[i], "--no-force-templates") == 0) {
-			forceTemplates = false;
-			skip.insert(i);
+			GeneratePCHAction::EndSourceFileAction();
 		}
-	}
+	};
 
-	if (output.empty()) {
-		cerr << "No output given" << endl;
-		exit(1);
-	}
+	class PrecompileActionFactory : public tooling::FrontendActionFactory
+	{
+		const parser::Command& m_command;
+		vector<string>* m_dependencies;
 
+	public:
+		PrecompileActionFactory(const parser::Command& command, vector<string>* dependencies)
+			: m_command(command)
+			, m_dependencies(dependencies) {}
 
-	if (!foundCpp) {
-		args.push_back("-xc++");
-	}
+		std::unique_ptr<FrontendAction> create() override {
+			return std::unique_ptr<FrontendAction>(new PrecompileAction(m_command, m_dependencies));
+		}
+	};
 
-	if (!foundCpp11) {
-		args.push_back("-std=c++11");
+	string absolutePath(const parser::Command& command)
+	{
+		return absolutePath(command.directory, command.file);
 	}
 
-	if (!foundSpellChecking) {
-		args.push_back("-fno-spell-checking");
-	}
+	/* The commands in the form the tooling wants them. The file is given
+	 * with its absolute path, so that the actions find their Result.
+	 */
+	class CommandDatabase : public tooling::CompilationDatabase
+	{
+		unordered_map<string, tooling::CompileCommand> m_commands;
+		vector<string> m_files;
+
+	public:
+		void add(const parser::Command& command, const string& file) {
+			vector<string> commandLine;
+			commandLine.reserve(command.flags.size() + 2);
+			commandLine.push_back(command.flags.empty() ? "selfportraitc" : command.flags.front());
+#ifdef SELFPORTRAIT_CLANG_RESOURCE_DIR
+			// the builtin headers of the clang we were built with
+			commandLine.push_back("-resource-dir=" SELFPORTRAIT_CLANG_RESOURCE_DIR);
+#endif
+			if (command.flags.size() > 1) {
+				commandLine.insert(commandLine.end(), command.flags.begin() + 1, command.flags.end());
+			}
+			commandLine.push_back(file);
+			m_commands.emplace(file, tooling::CompileCommand(command.directory, file, std::move(commandLine), ""));
+			m_files.push_back(file);
+		}
 
-	for (int i = 1; i < argc; ++i) {
-		if (!contains(skip, i)) {
-			args.push_back(argv[i]);
+		std::vector<tooling::CompileCommand> getCompileCommands(StringRef file) const override {
+			auto it = m_commands.find(file.str());
+			if (it == m_commands.end()) {
+				return {};
+			}
+			return { it->second };
 		}
-	}
 
-    // TextDiagnosticPrinter deletes this on on destruction
-    DiagnosticOptions* options = new DiagnosticOptions();
-    options->ShowCarets = 1;
-    options->ShowColors = 1;
+		std::vector<std::string> getAllFiles() const override {
+			return m_files;
+		}
+	};
 
+}
 
-    TextDiagnosticPrinter DiagClient(llvm::errs(), options, /*OwnsOutputStream*/ false);
+namespace parser {
 
-	llvm::IntrusiveRefCntPtr<DiagnosticIDs> DiagID(new DiagnosticIDs());
-    llvm::IntrusiveRefCntPtr<DiagnosticsEngine> Diags(new DiagnosticsEngine(DiagID, options, &DiagClient, false));
+	bool parse(const Command& command, TranslationUnit& tu, bool forceTemplates, string* diagnostics,
+			   vector<string>* dependencies, DeclarationSink* sink, bool keepDeclarations, const VirtualFiles* virtualFiles)
+	{
+		const string file = absolutePath(command);
+		CommandDatabase database;
+		database.add(command, file);
+
+		IntrusiveRefCntPtr<vfs::FileSystem> fileSystem(vfs::createPhysicalFileSystem().release());
+		if (virtualFiles) {
+			IntrusiveRefCntPtr<vfs::OverlayFileSystem> overlay(new vfs::OverlayFileSystem(fileSystem));
+			IntrusiveRefCntPtr<vfs::InMemoryFileSystem> inMemory(new vfs::InMemoryFileSystem());
+			for (const auto& f: *virtualFiles) {
+				inMemory->addFile(f.first, 0, MemoryBuffer::getMemBufferCopy(f.second, f.first));
+			}
+			overlay->pushOverlay(inMemory);
+			fileSystem = overlay;
+		}
 
-    llvm::OwningPtr<ASTUnit> unit(ASTUnit::LoadFromCommandLine(&args[0], &args[0]+args.size(), Diags, "/usr/lib64/clang/3.2/", /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/false, 0, 0, true, /*PrecompilePreamble=*/false, /*TUKind=*/TU_Complete, /*CacheCodeCompletionResults=*/false, /*AllowPCHWithCompilerErrors=*/false));
-    //llvm::OwningPtr<ASTUnit> unit(ASTUnit::LoadFromCommandLine(&args[0], &args[0]+args.size(), Diags, "/usr/lib/clang/3.1/", /*OnlyLocalDecls=*/false, /*CaptureDiagnostics=*/false, 0, 0, true, /*PrecompilePreamble=*/false, /*TUKind=*/TU_Complete, /*CacheCodeCompletionResults=*/false, /*AllowPCHWithCompilerErrors=*/false));
+		Result result;
+		result.ok = false;
+		swap(result.tu, tu);
+		const unordered_map<string, Target> targets = { { file, { &command, &result } } };
 
+		tooling::ClangTool tool(database, { file }, std::make_shared<PCHContainerOperations>(), fileSystem);
+		DeclarationActionFactory factory(targets, forceTemplates, sink, keepDeclarations, diagnostics != nullptr);
+		const bool ok = tool.run(&factory) == 0 && result.ok;
 
-    if (DiagClient.getNumErrors() > 0) {
-		return 1;
+		swap(result.tu, tu);
+		if (diagnostics) {
+			*diagnostics += result.diagnostics;
+		}
+		if (dependencies) {
+			dependencies->insert(dependencies->end(), result.dependencies.begin(), result.dependencies.end());
+		}
+		return ok;
 	}
 
-	ASTContext& astContext = unit->getASTContext();
-	MyASTConsumer astConsumer(&unit->getSourceManager(), astContext, unit->getSema(), forceTemplates);
-
-	for (auto it = astContext.getTranslationUnitDecl()->decls_begin(); it != astContext.getTranslationUnitDecl()->decls_end(); ++it) {
-		Decl* subdecl = *it;
-		SourceLocation location = subdecl->getLocation();
+	vector<Result> parseAll(const vector<Command>& commands, bool forceTemplates, unsigned threads)
+	{
+		vector<Result> ret(commands.size());
+		CommandDatabase database;
+		unordered_map<string, Target> targets;
+		for (size_t i = 0; i < commands.size(); ++i) {
+			const string file = absolutePath(commands[i]);
+			ret[i].ok = false;
+			ret[i].milliseconds = 0;
+			if (!targets.emplace(file, Target{ &commands[i], &ret[i] }).second) {
+				ret[i].diagnostics = file + " is given more than once\n";
+				continue;
+			}
+			database.add(commands[i], file);
+		}
 
-		astConsumer.handleDecl(subdecl, unit->isInMainFileID(location));
+		tooling::AllTUsToolExecutor executor(database, threads);
+		// the results tell which files failed
+		llvm::consumeError(executor.execute(std::unique_ptr<tooling::FrontendActionFactory>(new DeclarationActionFactory(targets, forceTemplates, nullptr, true, true))));
+		return ret;
 	}
 
-	std::ofstream out;
-	if (output != "-") {
-		out.open(output);
-		if (!out.is_open()) {
-			cerr << "cannot open output file " << output << endl;
-			exit(1);
+	bool precompile(const Command& command, const string& pch, string* diagnostics, vector<string>* dependencies)
+	{
+		const string file = absolutePath(command);
+		Command pchCommand = command;
+		pchCommand.flags.push_back("-xc++-header");
+		pchCommand.flags.push_back("-o");
+		pchCommand.flags.push_back(pch);
+		CommandDatabase database;
+		database.add(pchCommand, file);
+
+		tooling::ClangTool tool(database, { file });
+		// keeps the output, the defaults would make this a syntax check
+		tool.clearArgumentsAdjusters();
+
+		string out;
+		raw_string_ostream diagOut(out);
+		IntrusiveRefCntPtr<DiagnosticOptions> options(new DiagnosticOptions());
+		TextDiagnosticPrinter printer(diagnostics ? static_cast<raw_ostream&>(diagOut) : llvm::errs(), options.get());
+		tool.setDiagnosticConsumer(&printer);
+
+		PrecompileActionFactory factory(command, dependencies);
+		const bool ok = tool.run(&factory) == 0;
+		if (diagnostics) {
+			diagOut.flush();
+			*diagnostics += out;
 		}
-	} else {
-		out.copyfmt(std::cout);
-		out.clear(std::cout.rdstate());
-		out.basic_ios<char>::rdbuf(std::cout.rdbuf());
+		return ok;
 	}
 
-	astConsumer.print(out, iFaceDiags);
+	string compilerVersion()
+	{
+		return getClangFullVersion();
+	}
+
+	vector<Command> readCompileCommands(const string& path)
+	{
+		string error;
+		std::unique_ptr<tooling::JSONCompilationDatabase> db = tooling::JSONCompilationDatabase::loadFromFile(path, error, tooling::JSONCommandLineSyntax::AutoDetect);
+		if (!db) {
+			throw std::runtime_error("cannot load compilation database " + path + ": " + error);
+		}
 
+		vector<Command> ret;
+		for (const string& file: db->getAllFiles()) {
+			vector<tooling::CompileCommand> commands = db->getCompileCommands(file);
+			if (commands.empty()) {
+				continue;
+			}
+			const tooling::CompileCommand& cmd = commands.front();
+
+			Command command;
+			command.directory = cmd.Directory;
+			command.file = cmd.Filename;
+
+			// skip the input and everything concerning the object file
+			for (size_t i = 0; i < cmd.CommandLine.size(); ++i) {
+				const string& arg = cmd.CommandLine[i];
+				if (i > 0 && (arg == "-c" || arg == cmd.Filename)) {
+					continue;
+				} else if (arg == "-o") {
+					++i;
+				} else if (arg.compare(0, 2, "-o") != 0) {
+					command.flags.push_back(arg);
+				}
+			}
+			ret.push_back(std::move(command));
+		}
+		return ret;
+	}
 
-	return 0;
 }
@@ -0,0 +1,71 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef PARSER_H
+#define PARSER_H
+
+#include "definitions.h"
+
+#include <string>
+#include <utility>
+#include <vector>
+
+/* The part of selfportraitc that talks to clang. Everything runs through
+ * clang's tooling library: a ClangTool per file, or its AllTUsToolExecutor
+ * for many files, with a RecursiveASTVisitor filling the TranslationUnit.
+ * Nothing of clang shows here, so that the unit tests need not be built
+ * with its flags.
+ */
+
+namespace parser {
+
+	//! A compile command, like the ones of a compilation database
+	struct Command {
+		std::string directory;
+
+		// relative to directory
+		std::string file;
+
+		// the command line without the input file, starting with the compiler
+		std::vector<std::string> flags;
+	};
+
+	//! Name and contents of files that only exist in memory
+	typedef std::vector<std::pair<std::string, std::string> > VirtualFiles;
+
+	/*! Parses the file of command. The declarations are passed to sink as soon
+	 * as they are visited, without keepDeclarations tu only gets what is
+	 * needed to go on parsing, see TranslationUnitBuilder.
+	 * The diagnostics are appended to diagnostics, or written to stderr if it
+	 * is null. The virtualFiles hide the real files of the same name.
+	 */
+	bool parse(const Command& command, definitions::TranslationUnit& tu, bool forceTemplates,
+			   std::string* diagnostics = nullptr, std::vector<std::string>* dependencies = nullptr,
+			   definitions::DeclarationSink* sink = nullptr, bool keepDeclarations = true,
+			   const VirtualFiles* virtualFiles = nullptr);
+
+	struct Result {
+		bool ok;
+		definitions::TranslationUnit tu;
+		std::vector<std::string> dependencies;
+		std::string diagnostics;
+		double milliseconds;
+	};
+
+	//! Parses the files of commands on threads threads, the results are in the same order
+	std::vector<Result> parseAll(const std::vector<Command>& commands, bool forceTemplates, unsigned threads);
+
+	//! Writes a precompiled header of command.file to pch, the files it was made of are appended to dependencies
+	bool precompile(const Command& command, const std::string& pch, std::string* diagnostics = nullptr,
+					std::vector<std::string>* dependencies = nullptr);
+
+	//! The version of clang the parser was built with, PCHs only load in the same one
+	std::string compilerVersion();
+
+	//! The commands of a compile_commands.json, throws std::runtime_error if it cannot be read
+	std::vector<Command> readCompileCommands(const std::string& path);
+
+}
+
+#endif /* PARSER_H */
@@ -13,6 +13,7 @@
 #include <string>
 
 #include "variant.h"
+#include "call_frame.h"
 #include "reflection.h"
 #include "str_utils.h"
 
@@ -34,6 +35,10 @@ struct assignable_helper {
         }
         object.*ptr = v;
     }
+    static void set(Clazz& object, ptr_to_attr ptr, CallFrame& frame, ::std::size_t i) {
+        frame_arg<Type> arg(frame, i);
+        object.*ptr = arg.get(i);
+    }
 };
 
 template<class Clazz, class Type>
@@ -42,6 +47,25 @@ struct assignable_helper<Clazz, Type, false> {
     static void set(Clazz&, ptr_to_attr, const VariantValue&) {
             throw ::std::runtime_error("this attribute is not assignable");
     }
+    static void set(Clazz&, ptr_to_attr, CallFrame&, ::std::size_t) {
+            throw ::std::runtime_error("this attribute is not assignable");
+    }
+};
+
+// attributes pushed to a frame by value, reflected objects as tables
+template<class Type, bool pushable = ::std::is_class<Type>::value
+	|| (::std::is_copy_constructible<Type>::value && ::std::is_same<typename ::std::decay<Type>::type, Type>::value)>
+struct attribute_push {
+    static void push(CallFrame& frame, const Type& value) {
+        frame_element<Type>::push(frame, value);
+    }
+};
+
+template<class Type>
+struct attribute_push<Type, false> {
+    static void push(CallFrame&, const Type&) {
+        throw ::std::runtime_error("this attribute cannot be copied");
+    }
 };
 
 
@@ -75,6 +99,10 @@ struct attribute_type<_Type _Clazz::*> {
         }
         object.*ptr = v;*/
 	}
+
+	static void set(Clazz& object, ptr_to_attr ptr, CallFrame& frame, ::std::size_t i) {
+        assignable_helper<Clazz, Type, std::is_copy_assignable<Type>::value>::set(object, ptr, frame, i);
+	}
 	
 	static void set(const Clazz& object, ptr_to_attr, const VariantValue& ) {
 		throw ::std::runtime_error("cannot change value of an attribute of a const object");
@@ -99,6 +127,10 @@ struct attribute_type<const _Type _Clazz::*> {
     static void set(const Clazz&, ptr_to_attr, const VariantValue&) {
         throw ::std::runtime_error("cannot change value of const attribute");
     }
+
+    static void set(const Clazz&, ptr_to_attr, CallFrame&, ::std::size_t) {
+        throw ::std::runtime_error("cannot change value of const attribute");
+    }
 };
 
 template<class Type>
@@ -200,6 +232,15 @@ public:
 	void set(const VariantValue& object, const VariantValue& value) const {
 		set(true, object, value);
 	}
+
+	// typed access for language bindings, by default through variants
+	virtual void set(VariantValue& object, CallFrame& frame, ::std::size_t i) const {
+		set(false, object, frame.variantArg(i));
+	}
+
+	virtual void push(VariantValue& object, CallFrame& frame) const {
+		frame.pushVariant(get(object, true));
+	}
 	
 	AbstractAttributeImpl(const AbstractAttributeImpl&) = delete;
 	AbstractAttributeImpl(AbstractAttributeImpl&&) = delete;
@@ -268,6 +309,23 @@ public:
 			return ADescr::set(ref, m_ptr, value);
 		}
 	}
+
+	virtual void set(VariantValue& object, CallFrame& frame, ::std::size_t i) const override {
+		if (!object.isA<Clazz>()) {
+			throw ::std::runtime_error("accessing attribute of an object of a different class");
+		}
+		Clazz& ref = object.convertTo<Clazz&>();
+		ADescr::set(ref, m_ptr, frame, i);
+	}
+
+	virtual void push(VariantValue& object, CallFrame& frame) const override {
+		bool success = false;
+		const Clazz& ref = object.convertTo<const Clazz&>(&success);
+		if (!success) {
+			throw ::std::runtime_error("accessing attribute of an object of a different class");
+		}
+		attribute_push<Type>::push(frame, ref.*m_ptr);
+	}
 	
 private:
 	ptr_to_attr m_ptr;
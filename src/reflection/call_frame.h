@@ -0,0 +1,533 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef CALL_FRAME_H
+#define CALL_FRAME_H
+
+#include "selfportrait_config.h"
+#include "typelist.h"
+#include "variant.h"
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+/* Arguments and result of a call as seen by a language binding.
+ * Methods and functions registered with the REFL_ macros read primitive
+ * arguments and push primitive results through it directly, only
+ * objects are wrapped in variants. Containers are read and pushed
+ * element by element through a nested frame, reflected objects inside
+ * them as tables of their attributes. Objects returned on their own
+ * stay variants so that their methods remain callable.
+ */
+class CallFrame {
+public:
+
+	enum Kind { Other, Boolean, Integer, Number, String, Table };
+
+	typedef ::std::function<void(CallFrame&)> Elements;
+
+	/* Result of a call that returned a std::future or std::shared_future.
+	 * wait blocks for at most the given seconds, forever if negative, and
+	 * tells whether the value is ready. result pushes the value or throws
+	 * the exception stored in the future.
+	 */
+	struct Pending {
+		::std::function<bool(double)> wait;
+		Elements result;
+	};
+
+	virtual ~CallFrame() {}
+
+	virtual ::std::size_t size() const = 0;
+	virtual Kind kind(::std::size_t i) const = 0;
+
+	virtual bool booleanArg(::std::size_t i) = 0;
+	virtual long long integerArg(::std::size_t i) = 0;
+	virtual double numberArg(::std::size_t i) = 0;
+	// the string must stay valid until the call returns
+	virtual const char* stringArg(::std::size_t i, ::std::size_t& length) = 0;
+	virtual VariantValue variantArg(::std::size_t i) = 0;
+	// f reads the elements of the table argument i in order
+	virtual void sequenceArg(::std::size_t i, const Elements& f) = 0;
+	// f reads the entries of the table argument i, key at 2k, value at 2k + 1
+	virtual void mapArg(::std::size_t i, const Elements& f) = 0;
+
+	virtual void pushBoolean(bool b) = 0;
+	virtual void pushInteger(long long i) = 0;
+	virtual void pushNumber(double d) = 0;
+	virtual void pushString(const char* s, ::std::size_t length) = 0;
+	virtual void pushVariant(VariantValue&& v) = 0;
+	// f pushes the elements of a table, size is a hint
+	virtual void pushSequence(::std::size_t size, const Elements& f) = 0;
+	// f pushes the entries of a table as key, value, key, value...
+	virtual void pushMap(::std::size_t size, const Elements& f) = 0;
+	// a binding may suspend its caller until the value is ready,
+	// by default the call blocks
+	virtual void pushPending(Pending&& p) {
+		p.wait(-1);
+		p.result(*this);
+	}
+};
+
+#ifndef NO_RTTI
+// sets the attributes of a reflected object from the entries of
+// table argument i, named by attribute
+void assignAttributes(CallFrame& frame, ::std::size_t i, VariantValue& object);
+
+// pushes the non static attributes of a reflected object as a table,
+// false if the class of the object is not reflected
+bool pushAttributes(CallFrame& frame, VariantValue& object);
+#endif
+
+
+typedef void (*framemethod)(const volatile VariantValue&, CallFrame& frame);
+typedef void (*framefunction)(CallFrame& frame);
+
+
+namespace {
+
+enum frame_category_kind { frame_variant, frame_boolean, frame_arithmetic, frame_string, frame_c_string, frame_string_ref, frame_sequence, frame_map, frame_future };
+
+// elements that point into the frame cannot be stored in a container
+template<class T>
+struct frame_borrowed {
+	enum { value = ::std::is_same<T, const char*>::value || ::std::is_same<T, StringRef>::value };
+};
+
+// containers converted element by element
+template<class T>
+struct frame_container {
+	enum { sequence = false, map = false };
+};
+
+template<class E, class A>
+struct frame_container< ::std::vector<E, A>> {
+	enum { sequence = ::std::is_copy_constructible<E>::value && !frame_borrowed<E>::value, map = false };
+};
+
+template<class K, class V, class C, class A>
+struct frame_container< ::std::map<K, V, C, A>> {
+	enum { sequence = false, map = ::std::is_copy_constructible<K>::value && ::std::is_copy_constructible<V>::value
+		&& !frame_borrowed<K>::value && !frame_borrowed<V>::value };
+};
+
+template<class K, class V, class H, class P, class A>
+struct frame_container< ::std::unordered_map<K, V, H, P, A>> {
+	enum { sequence = false, map = ::std::is_copy_constructible<K>::value && ::std::is_copy_constructible<V>::value
+		&& !frame_borrowed<K>::value && !frame_borrowed<V>::value };
+};
+
+// results of asynchronous calls, pushed when they are ready
+template<class T>
+struct frame_async {
+	enum { value = false };
+};
+
+template<class T>
+struct frame_async< ::std::future<T>> {
+	typedef T type;
+	enum { value = ::std::is_void<T>::value || ::std::is_reference<T>::value || ::std::is_copy_constructible<T>::value };
+};
+
+template<class T>
+struct frame_async< ::std::shared_future<T>> : public frame_async< ::std::future<T>> {};
+
+// how a parameter or result of type T is passed through a CallFrame
+template<class T>
+struct frame_category {
+	typedef typename ::std::decay<T>::type D;
+
+	// a non-const reference must refer to the caller's object
+	enum { by_value = !(::std::is_lvalue_reference<T>::value && !::std::is_const<typename ::std::remove_reference<T>::type>::value)
+		&& !::std::is_volatile<typename ::std::remove_reference<T>::type>::value };
+
+	static const frame_category_kind value = !by_value ? frame_variant
+		: ::std::is_same<D, bool>::value ? frame_boolean
+		: ::std::is_arithmetic<D>::value ? frame_arithmetic
+		: ::std::is_same<D, ::std::string>::value ? frame_string
+		: ::std::is_same<D, const char*>::value ? frame_c_string
+		: ::std::is_same<D, StringRef>::value ? frame_string_ref
+		: frame_container<D>::sequence ? frame_sequence
+		: frame_container<D>::map ? frame_map
+		: frame_async<D>::value ? frame_future
+		: frame_variant;
+};
+
+
+template<class T, frame_category_kind category = frame_category<T>::value>
+struct frame_arg {
+	typedef typename frame_category<T>::D D;
+
+	// objects passed as a table are default constructed and their attributes assigned
+	typedef ::std::integral_constant<bool, frame_category<T>::by_value && ::std::is_class<D>::value
+		&& ::std::is_default_constructible<D>::value && !::std::is_same<D, VariantValue>::value> from_table;
+
+	frame_arg(CallFrame& frame, ::std::size_t i) {
+		init(frame, i, from_table());
+	}
+
+	typename VariantValue::converter<T>::type get(::std::size_t i) {
+		return m_v.convertToThrow<T>("error at argument %1: %2", i);
+	}
+
+	void init(CallFrame& frame, ::std::size_t i, ::std::true_type) {
+#ifndef NO_RTTI
+		if (frame.kind(i) == CallFrame::Table) {
+			m_v.construct<D>();
+			assignAttributes(frame, i, m_v);
+			return;
+		}
+#endif
+		m_v = frame.variantArg(i);
+	}
+
+	void init(CallFrame& frame, ::std::size_t i, ::std::false_type) {
+		m_v = frame.variantArg(i);
+	}
+
+	VariantValue m_v;
+};
+
+template<class T>
+struct frame_arg<T, frame_boolean> {
+	typedef typename frame_category<T>::D D;
+
+	frame_arg(CallFrame& frame, ::std::size_t i) {
+		if (frame.kind(i) == CallFrame::Boolean) {
+			m_value = frame.booleanArg(i);
+		} else {
+			m_value = frame.variantArg(i).convertToThrow<D>("error at argument %1: %2", i);
+		}
+	}
+
+	D&& get(::std::size_t) { return ::std::move(m_value); }
+
+	D m_value;
+};
+
+template<class T>
+struct frame_arg<T, frame_arithmetic> {
+	typedef typename frame_category<T>::D D;
+
+	frame_arg(CallFrame& frame, ::std::size_t i) {
+		switch (frame.kind(i)) {
+		case CallFrame::Integer:
+			m_value = static_cast<D>(frame.integerArg(i));
+			break;
+		case CallFrame::Number:
+			m_value = static_cast<D>(frame.numberArg(i));
+			break;
+		default:
+			m_value = frame.variantArg(i).convertToThrow<D>("error at argument %1: %2", i);
+		}
+	}
+
+	D&& get(::std::size_t) { return ::std::move(m_value); }
+
+	D m_value;
+};
+
+template<class T>
+struct frame_arg<T, frame_string> {
+
+	frame_arg(CallFrame& frame, ::std::size_t i) {
+		if (frame.kind(i) == CallFrame::String) {
+			::std::size_t length = 0;
+			const char* s = frame.stringArg(i, length);
+			m_value.assign(s, length);
+		} else {
+			m_value = frame.variantArg(i).convertToThrow< ::std::string>("error at argument %1: %2", i);
+		}
+	}
+
+	::std::string&& get(::std::size_t) { return ::std::move(m_value); }
+
+	::std::string m_value;
+};
+
+template<class T>
+struct frame_arg<T, frame_c_string> {
+
+	frame_arg(CallFrame& frame, ::std::size_t i) : m_value(nullptr) {
+		if (frame.kind(i) == CallFrame::String) {
+			::std::size_t length = 0;
+			m_value = frame.stringArg(i, length);
+		} else {
+			// the variant owns the characters
+			m_v = frame.variantArg(i);
+			m_value = m_v.convertToThrow<const char*>("error at argument %1: %2", i);
+		}
+	}
+
+	const char* get(::std::size_t) { return m_value; }
+
+	VariantValue m_v;
+	const char* m_value;
+};
+
+template<class T>
+struct frame_arg<T, frame_string_ref> {
+
+	frame_arg(CallFrame& frame, ::std::size_t i) : m_data(nullptr), m_size(0) {
+		if (frame.kind(i) == CallFrame::String) {
+			m_data = frame.stringArg(i, m_size);
+		} else {
+			m_string = frame.variantArg(i).convertToThrow< ::std::string>("error at argument %1: %2", i);
+		}
+	}
+
+	// the argument may be moved, so a copied string is only referenced here
+	StringRef get(::std::size_t) { return m_data ? StringRef(m_data, m_size) : StringRef(m_string); }
+
+	const char* m_data;
+	::std::size_t m_size;
+	::std::string m_string;
+};
+
+template<class T>
+struct frame_arg<T, frame_sequence> {
+	typedef typename frame_category<T>::D D;
+	typedef typename D::value_type E;
+
+	frame_arg(CallFrame& frame, ::std::size_t i) {
+		if (frame.kind(i) == CallFrame::Table) {
+			frame.sequenceArg(i, [this](CallFrame& elements) {
+				m_value.reserve(elements.size());
+				for (::std::size_t j = 0; j < elements.size(); ++j) {
+					frame_arg<E> element(elements, j);
+					m_value.push_back(element.get(j));
+				}
+			});
+		} else {
+			m_value = frame.variantArg(i).convertToThrow<D>("error at argument %1: %2", i);
+		}
+	}
+
+	D&& get(::std::size_t) { return ::std::move(m_value); }
+
+	D m_value;
+};
+
+template<class T>
+struct frame_arg<T, frame_map> {
+	typedef typename frame_category<T>::D D;
+	typedef typename D::key_type K;
+	typedef typename D::mapped_type V;
+
+	frame_arg(CallFrame& frame, ::std::size_t i) {
+		if (frame.kind(i) == CallFrame::Table) {
+			frame.mapArg(i, [this](CallFrame& entries) {
+				for (::std::size_t k = 0; k + 1 < entries.size(); k += 2) {
+					frame_arg<K> key(entries, k);
+					frame_arg<V> value(entries, k + 1);
+					m_value.emplace(key.get(k), value.get(k + 1));
+				}
+			});
+		} else {
+			m_value = frame.variantArg(i).convertToThrow<D>("error at argument %1: %2", i);
+		}
+	}
+
+	D&& get(::std::size_t) { return ::std::move(m_value); }
+
+	D m_value;
+};
+
+
+template<class R, frame_category_kind category = frame_category<R>::value>
+struct frame_result {
+	template<class T>
+	static void push(CallFrame& frame, T&& value) {
+		VariantValue ret;
+		ret.construct<R>(::std::forward<T>(value));
+		frame.pushVariant(::std::move(ret));
+	}
+};
+
+template<class R>
+struct frame_result<R, frame_boolean> {
+	static void push(CallFrame& frame, bool value) { frame.pushBoolean(value); }
+};
+
+template<class R>
+struct frame_result<R, frame_arithmetic> {
+	typedef typename frame_category<R>::D D;
+
+	template<class T>
+	static void push(CallFrame& frame, const T& value) {
+		if (::std::is_integral<D>::value) {
+			frame.pushInteger(static_cast<long long>(value));
+		} else {
+			frame.pushNumber(static_cast<double>(value));
+		}
+	}
+};
+
+template<class R>
+struct frame_result<R, frame_string> {
+	static void push(CallFrame& frame, const ::std::string& value) { frame.pushString(value.data(), value.size()); }
+};
+
+template<class R>
+struct frame_result<R, frame_string_ref> {
+	static void push(CallFrame& frame, const StringRef& value) { frame.pushString(value.data(), value.size()); }
+};
+
+// elements of the tables pushed for containers and objects. Reflected
+// objects become tables of their attributes, others are copied
+template<class T, bool object = frame_category<T>::value == frame_variant && ::std::is_class<typename frame_category<T>::D>::value
+	&& !::std::is_same<typename frame_category<T>::D, VariantValue>::value>
+struct frame_element : public frame_result<T> {};
+
+template<class T>
+struct frame_element<T, true> {
+	typedef typename frame_category<T>::D D;
+
+	static void push(CallFrame& frame, const D& value) {
+#ifndef NO_RTTI
+		VariantValue ref;
+		ref.construct<const D&>(value);
+		if (pushAttributes(frame, ref)) {
+			return;
+		}
+#endif
+		copy(frame, value, ::std::is_copy_constructible<D>());
+	}
+
+	static void copy(CallFrame& frame, const D& value, ::std::true_type) {
+		frame_result<T>::push(frame, value);
+	}
+
+	static void copy(CallFrame&, const D&, ::std::false_type) {
+		throw ::std::runtime_error("an object that cannot be copied cannot be pushed as a table element");
+	}
+};
+
+template<class R>
+struct frame_result<R, frame_sequence> {
+	typedef typename frame_category<R>::D D;
+
+	static void push(CallFrame& frame, const D& value) {
+		frame.pushSequence(value.size(), [&value](CallFrame& elements) {
+			for (const auto& e: value) {
+				frame_element<typename D::value_type>::push(elements, e);
+			}
+		});
+	}
+};
+
+template<class R>
+struct frame_result<R, frame_map> {
+	typedef typename frame_category<R>::D D;
+
+	static void push(CallFrame& frame, const D& value) {
+		frame.pushMap(value.size(), [&value](CallFrame& entries) {
+			for (const auto& e: value) {
+				frame_result<typename D::key_type>::push(entries, e.first);
+				frame_element<typename D::mapped_type>::push(entries, e.second);
+			}
+		});
+	}
+};
+
+template<class T>
+struct frame_future_value {
+	static void push(CallFrame& frame, const ::std::shared_future<T>& f) { frame_result<T>::push(frame, f.get()); }
+};
+
+template<>
+struct frame_future_value<void> {
+	static void push(CallFrame&, const ::std::shared_future<void>& f) { f.get(); }
+};
+
+template<class R>
+struct frame_result<R, frame_future> {
+	typedef typename frame_category<R>::D D;
+	typedef typename frame_async<D>::type T;
+
+	static void push(CallFrame& frame, D value) {
+		::std::shared_future<T> shared(::std::move(value));
+		frame.pushPending(CallFrame::Pending{
+			[shared](double seconds) {
+				if (seconds < 0) {
+					shared.wait();
+					return true;
+				}
+				// deferred functions run when the value is read
+				return shared.wait_for(::std::chrono::duration<double>(seconds)) != ::std::future_status::timeout;
+			},
+			[shared](CallFrame& result) { frame_future_value<T>::push(result, shared); }
+		});
+	}
+};
+
+// reads the arguments from the frame, calls the function or method and pushes the result.
+// Like the variant call helpers, arguments are passed straight to the callee
+// so that objects taken by value are copied only once
+template<class R, class... Args>
+struct frame_invoke {
+
+	template<class F, ::std::size_t... I, template< ::std::size_t...> class Ind>
+	static void call(CallFrame& frame, F f, Ind<I...>*) {
+		// braced initialization reads the arguments in order
+		::std::tuple<frame_arg<Args>...> args{ frame_arg<Args>(frame, I)... };
+		frame_result<R>::push(frame, f(::std::get<I>(args).get(I)...));
+	}
+
+	template<class C, class M, ::std::size_t... I, template< ::std::size_t...> class Ind>
+	static void call(CallFrame& frame, C& object, M m, Ind<I...>*) {
+		::std::tuple<frame_arg<Args>...> args{ frame_arg<Args>(frame, I)... };
+		frame_result<R>::push(frame, (object.*m)(::std::get<I>(args).get(I)...));
+	}
+
+	template<class F>
+	static void call(CallFrame& frame, F f) {
+		call(frame, f, static_cast<typename make_indices<sizeof...(Args)>::type*>(nullptr));
+	}
+
+	template<class C, class M>
+	static void call(CallFrame& frame, C& object, M m) {
+		call(frame, object, m, static_cast<typename make_indices<sizeof...(Args)>::type*>(nullptr));
+	}
+};
+
+template<class... Args>
+struct frame_invoke<void, Args...> {
+
+	template<class F, ::std::size_t... I, template< ::std::size_t...> class Ind>
+	static void call(CallFrame& frame, F f, Ind<I...>*) {
+		::std::tuple<frame_arg<Args>...> args{ frame_arg<Args>(frame, I)... };
+		f(::std::get<I>(args).get(I)...);
+	}
+
+	template<class C, class M, ::std::size_t... I, template< ::std::size_t...> class Ind>
+	static void call(CallFrame& frame, C& object, M m, Ind<I...>*) {
+		::std::tuple<frame_arg<Args>...> args{ frame_arg<Args>(frame, I)... };
+		(object.*m)(::std::get<I>(args).get(I)...);
+	}
+
+	template<class F>
+	static void call(CallFrame& frame, F f) {
+		call(frame, f, static_cast<typename make_indices<sizeof...(Args)>::type*>(nullptr));
+	}
+
+	template<class C, class M>
+	static void call(CallFrame& frame, C& object, M m) {
+		call(frame, object, m, static_cast<typename make_indices<sizeof...(Args)>::type*>(nullptr));
+	}
+};
+
+}
+
+#endif /* CALL_FRAME_H */
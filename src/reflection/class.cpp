@@ -55,6 +55,41 @@ void ClassImpl::setFullyQualifiedName(const ::std::string& fqn)
 	m_fqn = fqn;
 }
 
+namespace {
+	void assignSlots(const Class::MethodList& methods, const Class::ClassList& bases, ClassImpl::SlotMap& slots)
+	{
+		std::hash<Method> h;
+		for (const Method& m: methods) {
+			if (!m.isStatic()) {
+				slots.emplace(h(m), slots.size());
+			}
+		}
+		for (const Class& base: bases) {
+			assignSlots(base.methods(), base.superclasses(), slots);
+		}
+	}
+}
+
+const ClassImpl::SlotMap& ClassImpl::methodSlots() const
+{
+	// bases must be resolved before the first proxy is built, so the
+	// slots are assigned lazily and never change afterwards
+	std::call_once(m_slotsAssigned, [this]() {
+		assignSlots(m_methods, m_superclasses, m_slots);
+	});
+	return m_slots;
+}
+
+const ClassImpl::AttributeSlotMap& ClassImpl::attributeSlots() const
+{
+	std::call_once(m_attributeSlotsAssigned, [this]() {
+		for (const Attribute& a: m_attributes) {
+			m_attributeSlots.emplace(a.name(), a);
+		}
+	});
+	return m_attributeSlots;
+}
+
 void ClassImpl::registerMethod(Method m)
 { // Method is just a lightweigth handle
 	assert_open();
@@ -80,7 +115,7 @@ void ClassImpl::registerSuperClass(const char* className, std::function<VariantV
 {
 	assert_open();
     m_unresolvedBases.emplace_back(className, castFunction);
-
+	m_unresolvedCount.store(m_unresolvedBases.size(), std::memory_order_release);
 }
 
 void ClassImpl::registerSuperClassInternal(Class c)
@@ -99,20 +134,31 @@ void ClassImpl::registerSuperClassInternal(Class c)
 
 bool ClassImpl::hasUnresolvedBases() const
 {
-	return !m_unresolvedBases.empty();
+	return m_unresolvedCount.load(std::memory_order_acquire) != 0;
 }
 
 void ClassImpl::resolveBases()
 {
-	for (auto it = m_unresolvedBases.begin(); it!= m_unresolvedBases.end(); ++it) {
+	// every Class handle resolves, usually there is nothing left to do
+	if (m_unresolvedCount.load(std::memory_order_acquire) == 0) {
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(m_resolveMutex);
+
+	auto it = m_unresolvedBases.begin();
+	while (it != m_unresolvedBases.end()) {
         Class c = Class::lookup(it->first);
 		if (c.isValid()) {
             auto f = it->second;
 			it = m_unresolvedBases.erase(it);
 			registerSuperClassInternal(c);
             m_castFunctions.emplace(c, f);
+		} else {
+			++it;
 		}
 	}
+	m_unresolvedCount.store(m_unresolvedBases.size(), std::memory_order_release);
 }
 
 #ifndef NO_RTTI
@@ -131,12 +177,12 @@ bool ClassImpl::isInterface() const
 	return m_stubCreator != nullptr;
 }
 
-VariantValue ClassImpl::newInterface(std::shared_ptr<ProxyImpl>& proxyImpl) const
+VariantValue ClassImpl::newInterface(std::shared_ptr<ProxyImpl>& proxyImpl, const ProxyVTable& vtable) const
 {
 	if (m_stubCreator == nullptr) {
 		return VariantValue();
 	} else {
-		return m_stubCreator(proxyImpl);
+		return m_stubCreator(proxyImpl, vtable);
 	}
 }
 
@@ -6,9 +6,11 @@
 #define CLASS_H
 
 #include <algorithm>
+#include <atomic>
 #include <string>
 #include <list>
 #include <memory>
+#include <mutex>
 #include <unordered_map>
 #ifndef NO_RTTI
 #include <typeinfo>
@@ -22,7 +24,9 @@
 
 class ProxyImpl;
 
-typedef VariantValue (*StubCreator)(std::shared_ptr<ProxyImpl>&);
+class ProxyVTable;
+
+typedef VariantValue (*StubCreator)(std::shared_ptr<ProxyImpl>&, const ProxyVTable&);
 
 class ClassImpl: public Annotated {
 public:
@@ -30,6 +34,8 @@ public:
 	typedef Class::ConstructorList ConstructorList;
 	typedef Class::ClassList ClassList;
 	typedef Class::AttributeList AttributeList;
+	typedef std::unordered_map<size_t, size_t> SlotMap;
+	typedef std::unordered_map<std::string, Attribute> AttributeSlotMap;
 		
 	const std::string& fullyQualifiedName() const;
 	
@@ -77,10 +83,18 @@ public:
 
 	bool isInterface() const;
 
-	VariantValue newInterface(std::shared_ptr<ProxyImpl>& proxyImpl) const;
+	VariantValue newInterface(std::shared_ptr<ProxyImpl>& proxyImpl, const ProxyVTable& vtable) const;
 
 	void registerInterface(StubCreator c);
 
+	// dense slot numbers, keyed by method hash, for the non static methods
+	// of this class and its superclasses. Used to index proxy handler tables
+	const SlotMap& methodSlots() const;
+
+	// the attributes of this class and its superclasses by name, the
+	// class' own hide those of its bases. Only valid once the bases are resolved
+	const AttributeSlotMap& attributeSlots() const;
+
     VariantValue castUp(const Class& base, const VariantValue& baseRef) const;
 
 private:
@@ -92,6 +106,9 @@ private:
 	MethodList m_methods;
 	ConstructorList m_constructors;
     std::list<std::pair<const char*, std::function<VariantValue(const VariantValue&)>>> m_unresolvedBases;
+	// bases are resolved on first use, which may happen on several threads
+	std::atomic<std::size_t> m_unresolvedCount{0};
+	std::mutex m_resolveMutex;
 	ClassList m_superclasses;
     std::unordered_map<Class, std::function<VariantValue(const VariantValue&)>> m_castFunctions;
 	AttributeList m_attributes;
@@ -99,6 +116,12 @@ private:
 
 	StubCreator m_stubCreator;
 
+	mutable SlotMap m_slots;
+	mutable std::once_flag m_slotsAssigned;
+
+	mutable AttributeSlotMap m_attributeSlots;
+	mutable std::once_flag m_attributeSlotsAssigned;
+
 #ifndef NO_RTTI
 	const std::type_info* m_typeInfo;
 #endif
@@ -7,6 +7,10 @@
 
 #include "selfportrait_config.h"
 
+#include <cstddef>
+#include <iterator>
+#include <utility>
+
 inline void emplace(ArgArray& v )
 {
 	// nothing to do
@@ -33,5 +37,77 @@ inline void variant_construct(ArgArray& v, T&& t, U&&... u )
     variant_construct(v, u...);
 }
 
+/* Read-only view of a contiguous array that lives elsewhere,
+ * usually in static storage. Copying it is as cheap as copying a pointer.
+ */
+template<class T>
+class ArrayView {
+public:
+	typedef T value_type;
+	typedef const T* const_iterator;
+	typedef ::std::size_t size_type;
+
+	constexpr ArrayView() : m_data(nullptr), m_size(0) {}
+	constexpr ArrayView(const T* data, size_type size) : m_data(data), m_size(size) {}
+
+	const_iterator begin() const { return m_data; }
+	const_iterator end() const { return m_data + m_size; }
+
+	size_type size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	const T& operator[](size_type i) const { return m_data[i]; }
+
+	const T& front() const { return m_data[0]; }
+	const T& back() const { return m_data[m_size-1]; }
+
+private:
+	const T* m_data;
+	size_type m_size;
+};
+
+template<class T>
+inline bool operator==(const ArrayView<T>& a1, const ArrayView<T>& a2)
+{
+	if (a1.size() != a2.size()) {
+		return false;
+	}
+	for (typename ArrayView<T>::size_type i = 0; i < a1.size(); ++i) {
+		if (!(a1[i] == a2[i])) {
+			return false;
+		}
+	}
+	return true;
+}
+
+template<class T>
+inline bool operator!=(const ArrayView<T>& a1, const ArrayView<T>& a2)
+{
+	return !(a1 == a2);
+}
+
+/* Read-only view of [first, last) of a container that lives elsewhere.
+ */
+template<class Iterator>
+class IteratorRange {
+public:
+	typedef Iterator const_iterator;
+	typedef ::std::size_t size_type;
+
+	IteratorRange() : m_first(), m_last() {}
+	IteratorRange(Iterator first, Iterator last) : m_first(first), m_last(last) {}
+
+	const_iterator begin() const { return m_first; }
+	const_iterator end() const { return m_last; }
+
+	size_type size() const { return ::std::distance(m_first, m_last); }
+	bool empty() const { return m_first == m_last; }
+
+	decltype(*::std::declval<Iterator>()) front() const { return *m_first; }
+
+private:
+	Iterator m_first;
+	Iterator m_last;
+};
 
 #endif /* COLL_UTILS_H */
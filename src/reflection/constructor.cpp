@@ -9,7 +9,7 @@ ConstructorImpl::ConstructorImpl(
 		, int numArgs
 		, const char* argSpellings
 #ifndef NO_RTTI
-		, ::std::vector<const ::std::type_info*> argumentTypes
+		, const ::std::type_info* const* argumentTypes
 #endif
 		)
 	: m_numArgs(numArgs)
@@ -40,8 +40,8 @@ VariantValue ConstructorImpl::call(const ArgArray& args) const
 
 
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> ConstructorImpl::argumentTypes() const
+TypeInfoList ConstructorImpl::argumentTypes() const
 {
-	return m_argumentTypes;
+	return TypeInfoList(m_argumentTypes, m_numArgs);
 }
 #endif
@@ -60,7 +60,7 @@ public:
 			, int numArgs
 			, const char* argSpellings
 #ifndef NO_RTTI
-			, ::std::vector<const ::std::type_info*> argumentTypes
+			, const ::std::type_info* const* argumentTypes
 #endif
 			);
 
@@ -72,13 +72,13 @@ public:
 
 
 #ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	TypeInfoList argumentTypes() const;
 #endif
 private:
     unsigned int m_numArgs;
 	const char* m_argSpellings;
 #ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> m_argumentTypes;
+	const ::std::type_info* const* m_argumentTypes;
 #endif
 	boundcons m_c;
 };
@@ -13,8 +13,10 @@ FunctionImpl::FunctionImpl(
 		, const char* argSpellings
 #ifndef NO_RTTI
 		, const ::std::type_info& returnType
-		, ::std::vector<const ::std::type_info*> argumentTypes
+		, const ::std::type_info* const* argumentTypes
 #endif
+		, framefunction frameFunction
+		, nativeentry nativeEntry
 		)
 	: m_name(name)
 	, m_returnSpelling(returnSpelling)
@@ -25,6 +27,8 @@ FunctionImpl::FunctionImpl(
 	, m_argumentTypes(argumentTypes)
 #endif
 	, m_f(f)
+	, m_frameFunction(frameFunction)
+	, m_nativeEntry(nativeEntry)
 {}
 
 FunctionImpl::~FunctionImpl()
@@ -56,9 +60,9 @@ const ::std::type_info& FunctionImpl::returnType() const
 	return m_returnType;
 }
 
-::std::vector<const ::std::type_info*> FunctionImpl::argumentTypes() const
+TypeInfoList FunctionImpl::argumentTypes() const
 {
-	return m_argumentTypes;
+	return TypeInfoList(m_argumentTypes, m_numArgs);
 }
 #endif
 
@@ -69,3 +73,24 @@ VariantValue FunctionImpl::call(const ArgArray& args) const
     }
 	return m_f(args);
 }
+
+void FunctionImpl::call(CallFrame& frame) const
+{
+	if (frame.size() < m_numArgs) {
+		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
+	}
+	if (m_frameFunction != nullptr) {
+		m_frameFunction(frame);
+	} else {
+		ArgArray args;
+		for (::std::size_t i = 0; i < frame.size(); ++i) {
+			args.push_back(frame.variantArg(i));
+		}
+		frame.pushVariant(m_f(args));
+	}
+}
+
+const NativeEntry* FunctionImpl::nativeEntry() const
+{
+	return m_nativeEntry != nullptr ? m_nativeEntry() : nullptr;
+}
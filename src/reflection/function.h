@@ -19,6 +19,8 @@
 #include "str_conversion.h"
 #include "str_utils.h"
 #include "call_utils.h"
+#include "call_frame.h"
+#include "native_call.h"
 
 namespace {
 
@@ -57,6 +59,16 @@ struct function_type<_Result(*)(Args...)> {
     static VariantValue bindcall(const ArgArray& args) {
 		return call_helper<Result, typename make_indices<sizeof...(Args)>::type>::call(ptr, args);
 	}
+
+	template <_Result(*ptr)(Args...)>
+	static void framecall(CallFrame& frame) {
+		frame_invoke<Result, Args...>::call(frame, ptr);
+	}
+
+	template <_Result(*ptr)(Args...)>
+	static const NativeEntry* native() {
+		return native_function<all_native<Result, Args...>::value, Result, Args...>::template entry<ptr>();
+	}
 };
 
 }
@@ -73,8 +85,10 @@ public:
 			, const char* argSpellings
 #ifndef NO_RTTI
 			, const ::std::type_info& returnType
-			, ::std::vector<const ::std::type_info*> argumentTypes
+			, const ::std::type_info* const* argumentTypes
 #endif
+			, framefunction frameFunction = nullptr
+			, nativeentry nativeEntry = nullptr
 			);
 
 	~FunctionImpl();
@@ -85,10 +99,13 @@ public:
 	::std::vector< ::std::string> argumentSpellings() const;
 #ifndef NO_RTTI
 	const ::std::type_info& returnType() const;
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	TypeInfoList argumentTypes() const;
 #endif
 
     VariantValue call(const ArgArray& args) const;
+    void call(CallFrame& frame) const;
+
+    const NativeEntry* nativeEntry() const;
 	
 	FunctionImpl(const FunctionImpl&) = delete;
 	FunctionImpl(FunctionImpl&&) = delete;
@@ -102,9 +119,11 @@ public:
 
 #ifndef NO_RTTI
 	const ::std::type_info& m_returnType;
-	const ::std::vector<const ::std::type_info*> m_argumentTypes;
+	const ::std::type_info* const* const m_argumentTypes;
 #endif
 	const boundfunction m_f;
+	const framefunction m_frameFunction;
+	const nativeentry m_nativeEntry;
 };
 
 
@@ -130,6 +149,29 @@ Function make_function(boundfunction f, const char* name, const char* resultStri
 	return &impl;
 }
 
+template<class FuncPtr>
+Function make_function(boundfunction f, framefunction ff, nativeentry ne, const char* name, const char* resultString, const char* argString)
+{
+	typedef function_type<FuncPtr> FDescr;
+	typedef typename FDescr::Arguments Arguments;
+	typedef typename FDescr::Result Result;
+
+	static FunctionImpl impl(
+				f
+				, name
+				, resultString
+				, typelist_size<Arguments>::value
+				, argString
+#ifndef NO_RTTI
+				, typeid(Result)
+				, get_typeinfo<Arguments>()
+#endif
+				, ff
+				, ne
+				);
+	return &impl;
+}
+
 
 
 #endif /* FUNCTION_H */
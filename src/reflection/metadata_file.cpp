@@ -0,0 +1,326 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "metadata_file.h"
+#include "str_conversion.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+	template<class Record>
+	const Record* section(const char*& pos, std::uint32_t count)
+	{
+		const Record* ret = reinterpret_cast<const Record*>(pos);
+		pos += sizeof(Record) * static_cast<std::size_t>(count);
+		return ret;
+	}
+
+}
+
+// compares records with a name, for the binary searches
+struct MetadataFile::ByName {
+	const MetadataFile* file;
+
+	template<class Record>
+	bool operator()(const Record& r, const char* name) const {
+		return std::strcmp(file->string(r.name), name) < 0;
+	}
+
+	template<class Record>
+	bool operator()(const char* name, const Record& r) const {
+		return std::strcmp(name, file->string(r.name)) < 0;
+	}
+};
+
+//--------entries------------------------------------------------
+
+const char* MetadataFile::MethodEntry::name() const
+{
+	return m_file->string(m_record->name);
+}
+
+const char* MetadataFile::MethodEntry::returnSpelling() const
+{
+	return m_file->string(m_record->returnSpelling);
+}
+
+const char* MetadataFile::MethodEntry::argumentSpelling(std::size_t i) const
+{
+	return m_file->argumentSpelling(m_record->firstArgument, m_record->numArguments, i);
+}
+
+const char* MetadataFile::AttributeEntry::name() const
+{
+	return m_file->string(m_record->name);
+}
+
+const char* MetadataFile::AttributeEntry::typeSpelling() const
+{
+	return m_file->string(m_record->typeSpelling);
+}
+
+const char* MetadataFile::ConstructorEntry::argumentSpelling(std::size_t i) const
+{
+	return m_file->argumentSpelling(m_record->firstArgument, m_record->numArguments, i);
+}
+
+const char* MetadataFile::FunctionEntry::name() const
+{
+	return m_file->string(m_record->name);
+}
+
+const char* MetadataFile::FunctionEntry::returnSpelling() const
+{
+	return m_file->string(m_record->returnSpelling);
+}
+
+const char* MetadataFile::FunctionEntry::argumentSpelling(std::size_t i) const
+{
+	return m_file->argumentSpelling(m_record->firstArgument, m_record->numArguments, i);
+}
+
+void MetadataFile::ClassEntry::assertValid() const
+{
+	if (!isValid()) {
+		throw std::runtime_error("Invalid use of uninitialized class entry");
+	}
+}
+
+const char* MetadataFile::ClassEntry::fullyQualifiedName() const
+{
+	assertValid();
+	return m_file->string(m_record->name);
+}
+
+bool MetadataFile::ClassEntry::isInterface() const
+{
+	assertValid();
+	return (m_record->flags & ClassRecord::Interface) != 0;
+}
+
+std::size_t MetadataFile::ClassEntry::numMethods() const
+{
+	assertValid();
+	return m_record->numMethods;
+}
+
+MetadataFile::MethodEntry MetadataFile::ClassEntry::method(std::size_t i) const
+{
+	if (i >= numMethods()) {
+		throw std::runtime_error("method index out of range");
+	}
+	return MethodEntry(m_file, record(m_file->m_methods, m_file->m_header->numMethods, m_record->firstMethod, i));
+}
+
+std::size_t MetadataFile::ClassEntry::numAttributes() const
+{
+	assertValid();
+	return m_record->numAttributes;
+}
+
+MetadataFile::AttributeEntry MetadataFile::ClassEntry::attribute(std::size_t i) const
+{
+	if (i >= numAttributes()) {
+		throw std::runtime_error("attribute index out of range");
+	}
+	return AttributeEntry(m_file, record(m_file->m_attributes, m_file->m_header->numAttributes, m_record->firstAttribute, i));
+}
+
+std::size_t MetadataFile::ClassEntry::numConstructors() const
+{
+	assertValid();
+	return m_record->numConstructors;
+}
+
+MetadataFile::ConstructorEntry MetadataFile::ClassEntry::constructor(std::size_t i) const
+{
+	if (i >= numConstructors()) {
+		throw std::runtime_error("constructor index out of range");
+	}
+	return ConstructorEntry(m_file, record(m_file->m_constructors, m_file->m_header->numConstructors, m_record->firstConstructor, i));
+}
+
+std::size_t MetadataFile::ClassEntry::numSuperclasses() const
+{
+	assertValid();
+	return m_record->numBases;
+}
+
+const char* MetadataFile::ClassEntry::superclassName(std::size_t i) const
+{
+	if (i >= numSuperclasses()) {
+		throw std::runtime_error("superclass index out of range");
+	}
+	return m_file->string(record(m_file->m_bases, m_file->m_header->numBases, m_record->firstBase, i)->name);
+}
+
+MetadataFile::ClassEntry MetadataFile::ClassEntry::superclass(std::size_t i) const
+{
+	if (i >= numSuperclasses()) {
+		throw std::runtime_error("superclass index out of range");
+	}
+	const std::uint32_t index = record(m_file->m_bases, m_file->m_header->numBases, m_record->firstBase, i)->classIndex;
+	if (index == noClassIndex) {
+		return ClassEntry();
+	}
+	return ClassEntry(m_file, record(m_file->m_classes, m_file->m_header->numClasses, index, 0));
+}
+
+//--------file---------------------------------------------------
+
+MetadataFile::MetadataFile(const std::string& path)
+	: m_mapping(nullptr)
+	, m_mappingSize(0)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		throw std::runtime_error(strconv::fmt_str("cannot open meta-data file %1", path));
+	}
+
+	struct stat st;
+	if (fstat(fd, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(MetadataHeader))) {
+		close(fd);
+		throw std::runtime_error(strconv::fmt_str("%1 is not a meta-data file", path));
+	}
+
+	void* mapping = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (mapping == MAP_FAILED) {
+		throw std::runtime_error(strconv::fmt_str("cannot map meta-data file %1", path));
+	}
+	m_mapping = mapping;
+	m_mappingSize = st.st_size;
+
+	try {
+		m_header = static_cast<const MetadataHeader*>(mapping);
+		validate(m_mappingSize);
+	} catch (const std::runtime_error& ex) {
+		munmap(m_mapping, m_mappingSize);
+		throw std::runtime_error(strconv::fmt_str("%1: %2", path, ex.what()));
+	}
+}
+
+MetadataFile::MetadataFile(const void* data, std::size_t size)
+	: m_mapping(nullptr)
+	, m_mappingSize(0)
+	, m_header(static_cast<const MetadataHeader*>(data))
+{
+	if (reinterpret_cast<std::uintptr_t>(data) % alignof(MetadataHeader) != 0) {
+		throw std::runtime_error("meta-data is not aligned");
+	}
+	validate(size);
+}
+
+MetadataFile::~MetadataFile()
+{
+	if (m_mapping) {
+		munmap(m_mapping, m_mappingSize);
+	}
+}
+
+// Only the header and the section sizes, the records are checked when read
+void MetadataFile::validate(std::size_t size)
+{
+	if (size < sizeof(MetadataHeader) || std::memcmp(m_header->magic, metadataMagic, sizeof(metadataMagic)) != 0) {
+		throw std::runtime_error("not a meta-data file");
+	}
+	if (m_header->version != metadataVersion) {
+		throw std::runtime_error(strconv::fmt_str("unsupported meta-data version %1", m_header->version));
+	}
+
+	const MetadataHeader& h = *m_header;
+	const unsigned long long expected = sizeof(MetadataHeader)
+			+ sizeof(ClassRecord) * static_cast<unsigned long long>(h.numClasses)
+			+ sizeof(FunctionRecord) * static_cast<unsigned long long>(h.numFunctions)
+			+ sizeof(MethodRecord) * static_cast<unsigned long long>(h.numMethods)
+			+ sizeof(AttributeRecord) * static_cast<unsigned long long>(h.numAttributes)
+			+ sizeof(ConstructorRecord) * static_cast<unsigned long long>(h.numConstructors)
+			+ sizeof(BaseRecord) * static_cast<unsigned long long>(h.numBases)
+			+ sizeof(std::uint32_t) * static_cast<unsigned long long>(h.numArguments)
+			+ h.stringsSize;
+	if (expected != size) {
+		throw std::runtime_error("truncated meta-data file");
+	}
+
+	const char* pos = reinterpret_cast<const char*>(m_header + 1);
+	m_classes = section<ClassRecord>(pos, h.numClasses);
+	m_functions = section<FunctionRecord>(pos, h.numFunctions);
+	m_methods = section<MethodRecord>(pos, h.numMethods);
+	m_attributes = section<AttributeRecord>(pos, h.numAttributes);
+	m_constructors = section<ConstructorRecord>(pos, h.numConstructors);
+	m_bases = section<BaseRecord>(pos, h.numBases);
+	m_arguments = section<std::uint32_t>(pos, h.numArguments);
+	m_strings = pos;
+
+	// then any offset in range is a terminated string
+	if (h.stringsSize == 0 || m_strings[h.stringsSize - 1] != '\0') {
+		throw std::runtime_error("malformed string table");
+	}
+}
+
+const char* MetadataFile::string(std::uint32_t offset) const
+{
+	if (offset >= m_header->stringsSize) {
+		throw std::runtime_error("string offset out of range");
+	}
+	return m_strings + offset;
+}
+
+template<class Record>
+const Record* MetadataFile::record(const Record* section, std::uint32_t count, std::uint32_t first, std::size_t i)
+{
+	if (first >= count || i >= count - first) {
+		throw std::runtime_error("record out of range");
+	}
+	return section + first + i;
+}
+
+const char* MetadataFile::argumentSpelling(std::uint32_t firstArgument, std::uint32_t numArguments, std::size_t i) const
+{
+	if (i >= numArguments) {
+		throw std::runtime_error("argument index out of range");
+	}
+	return string(*record(m_arguments, m_header->numArguments, firstArgument, i));
+}
+
+MetadataFile::ClassEntry MetadataFile::classAt(std::size_t i) const
+{
+	if (i >= numClasses()) {
+		throw std::runtime_error("class index out of range");
+	}
+	return ClassEntry(this, m_classes + i);
+}
+
+MetadataFile::ClassEntry MetadataFile::findClass(const char* name) const
+{
+	const ClassRecord* end = m_classes + m_header->numClasses;
+	const ClassRecord* it = std::lower_bound(m_classes, end, name, ByName{this});
+	if (it != end && std::strcmp(string(it->name), name) == 0) {
+		return ClassEntry(this, it);
+	}
+	return ClassEntry();
+}
+
+MetadataFile::FunctionEntry MetadataFile::functionAt(std::size_t i) const
+{
+	if (i >= numFunctions()) {
+		throw std::runtime_error("function index out of range");
+	}
+	return FunctionEntry(this, m_functions + i);
+}
+
+std::pair<std::size_t, std::size_t> MetadataFile::findFunctions(const char* name) const
+{
+	const FunctionRecord* end = m_functions + m_header->numFunctions;
+	auto range = std::equal_range(m_functions, end, name, ByName{this});
+	return std::make_pair(range.first - m_functions, range.second - m_functions);
+}
@@ -0,0 +1,173 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef METADATA_FILE_H
+#define METADATA_FILE_H
+
+#include "metadata_format.h"
+
+#include <cstddef>
+#include <string>
+#include <utility>
+
+/* Read only view of a binary meta-data file written by
+ * selfportraitc --binary-metadata. The file is mapped and queried in place:
+ * beside opening it, nothing here allocates, and the annotated libraries
+ * do not have to be loaded. The entries are only valid while the
+ * MetadataFile lives.
+ * Opening only checks the header and the sizes of the sections, so that
+ * it does not touch every page. The offsets of a record are checked when
+ * they are read, a malformed record throws std::runtime_error then.
+ */
+class MetadataFile {
+public:
+
+	class MethodEntry {
+	public:
+		const char* name() const;
+		const char* returnSpelling() const;
+		// of argument i, as written in the declaration
+		const char* argumentSpelling(std::size_t i) const;
+		std::size_t numberOfArguments() const { return m_record->numArguments; }
+		bool isConst() const { return (m_record->flags & MethodRecord::Const) != 0; }
+		bool isVolatile() const { return (m_record->flags & MethodRecord::Volatile) != 0; }
+		bool isStatic() const { return (m_record->flags & MethodRecord::Static) != 0; }
+
+	private:
+		MethodEntry(const MetadataFile* file, const MethodRecord* record) : m_file(file), m_record(record) {}
+
+		const MetadataFile* m_file;
+		const MethodRecord* m_record;
+
+		friend class MetadataFile;
+	};
+
+	class AttributeEntry {
+	public:
+		const char* name() const;
+		const char* typeSpelling() const;
+
+	private:
+		AttributeEntry(const MetadataFile* file, const AttributeRecord* record) : m_file(file), m_record(record) {}
+
+		const MetadataFile* m_file;
+		const AttributeRecord* m_record;
+
+		friend class MetadataFile;
+	};
+
+	class ConstructorEntry {
+	public:
+		const char* argumentSpelling(std::size_t i) const;
+		std::size_t numberOfArguments() const { return m_record->numArguments; }
+
+	private:
+		ConstructorEntry(const MetadataFile* file, const ConstructorRecord* record) : m_file(file), m_record(record) {}
+
+		const MetadataFile* m_file;
+		const ConstructorRecord* m_record;
+
+		friend class MetadataFile;
+	};
+
+	class FunctionEntry {
+	public:
+		const char* name() const;
+		const char* returnSpelling() const;
+		const char* argumentSpelling(std::size_t i) const;
+		std::size_t numberOfArguments() const { return m_record->numArguments; }
+
+	private:
+		FunctionEntry(const MetadataFile* file, const FunctionRecord* record) : m_file(file), m_record(record) {}
+
+		const MetadataFile* m_file;
+		const FunctionRecord* m_record;
+
+		friend class MetadataFile;
+	};
+
+	class ClassEntry {
+	public:
+		ClassEntry() : m_file(nullptr), m_record(nullptr) {}
+
+		bool isValid() const { return m_record != nullptr; }
+
+		const char* fullyQualifiedName() const;
+		bool isInterface() const;
+
+		std::size_t numMethods() const;
+		MethodEntry method(std::size_t i) const;
+
+		std::size_t numAttributes() const;
+		AttributeEntry attribute(std::size_t i) const;
+
+		std::size_t numConstructors() const;
+		ConstructorEntry constructor(std::size_t i) const;
+
+		std::size_t numSuperclasses() const;
+		const char* superclassName(std::size_t i) const;
+		// invalid if the superclass is not in this file
+		ClassEntry superclass(std::size_t i) const;
+
+	private:
+		ClassEntry(const MetadataFile* file, const ClassRecord* record) : m_file(file), m_record(record) {}
+
+		void assertValid() const;
+
+		const MetadataFile* m_file;
+		const ClassRecord* m_record;
+
+		friend class MetadataFile;
+	};
+
+	// throws std::runtime_error if the file cannot be mapped or its header is malformed
+	explicit MetadataFile(const std::string& path);
+
+	// uses data in place, it must outlive the MetadataFile
+	MetadataFile(const void* data, std::size_t size);
+
+	~MetadataFile();
+
+	MetadataFile(const MetadataFile&) = delete;
+	MetadataFile& operator=(const MetadataFile&) = delete;
+
+	std::size_t numClasses() const { return m_header->numClasses; }
+	ClassEntry classAt(std::size_t i) const;
+	// binary search, an invalid entry if there is no such class
+	ClassEntry findClass(const char* name) const;
+
+	std::size_t numFunctions() const { return m_header->numFunctions; }
+	FunctionEntry functionAt(std::size_t i) const;
+	// the overloads of name are [first, second) in functionAt
+	std::pair<std::size_t, std::size_t> findFunctions(const char* name) const;
+
+private:
+
+	struct ByName;
+
+	void validate(std::size_t size);
+
+	const char* string(std::uint32_t offset) const;
+
+	// record first + i of a section of count records
+	template<class Record>
+	static const Record* record(const Record* section, std::uint32_t count, std::uint32_t first, std::size_t i);
+
+	const char* argumentSpelling(std::uint32_t firstArgument, std::uint32_t numArguments, std::size_t i) const;
+
+	void* m_mapping;
+	std::size_t m_mappingSize;
+
+	const MetadataHeader* m_header;
+	const ClassRecord* m_classes;
+	const FunctionRecord* m_functions;
+	const MethodRecord* m_methods;
+	const AttributeRecord* m_attributes;
+	const ConstructorRecord* m_constructors;
+	const BaseRecord* m_bases;
+	const std::uint32_t* m_arguments;
+	const char* m_strings;
+};
+
+#endif /* METADATA_FILE_H */
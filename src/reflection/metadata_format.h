@@ -0,0 +1,96 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef METADATA_FORMAT_H
+#define METADATA_FORMAT_H
+
+#include <cstdint>
+
+/* Layout of the binary meta-data written by selfportraitc --binary-metadata
+ * and read by MetadataFile. The file is meant to be mapped into memory and
+ * used in place, so it is made only of these records, in native byte order:
+ *
+ *   MetadataHeader
+ *   ClassRecord[numClasses]             sorted by name
+ *   FunctionRecord[numFunctions]        sorted by name
+ *   MethodRecord[numMethods]            the methods of each class are contiguous
+ *   AttributeRecord[numAttributes]      the attributes of each class are contiguous
+ *   ConstructorRecord[numConstructors]  the constructors of each class are contiguous
+ *   BaseRecord[numBases]                the bases of each class are contiguous
+ *   uint32_t arguments[numArguments]    the argument spellings of each signature are contiguous
+ *   char strings[stringsSize]           NUL terminated strings
+ *
+ * Names and spellings are offsets into the strings, spelled as in C++ (no
+ * COMMA macro). Every record is a multiple of 4 bytes and the sections
+ * follow each other without padding.
+ */
+
+static const char metadataMagic[8] = { 'S', 'P', 'M', 'E', 'T', 'A', '\0', '\0' };
+static const std::uint32_t metadataVersion = 2;
+
+// a base class that is not in the file
+static const std::uint32_t noClassIndex = 0xffffffff;
+
+struct MetadataHeader {
+	char magic[8];
+	std::uint32_t version;
+	std::uint32_t numClasses;
+	std::uint32_t numFunctions;
+	std::uint32_t numMethods;
+	std::uint32_t numAttributes;
+	std::uint32_t numConstructors;
+	std::uint32_t numBases;
+	std::uint32_t numArguments;
+	std::uint32_t stringsSize;
+};
+
+struct ClassRecord {
+	enum { Interface = 1 };
+
+	std::uint32_t name;
+	std::uint32_t flags;
+	std::uint32_t firstMethod;
+	std::uint32_t numMethods;
+	std::uint32_t firstAttribute;
+	std::uint32_t numAttributes;
+	std::uint32_t firstConstructor;
+	std::uint32_t numConstructors;
+	std::uint32_t firstBase;
+	std::uint32_t numBases;
+};
+
+struct FunctionRecord {
+	std::uint32_t name;
+	std::uint32_t returnSpelling;
+	std::uint32_t firstArgument;
+	std::uint32_t numArguments;
+};
+
+struct MethodRecord {
+	enum { Const = 1, Volatile = 2, Static = 4 };
+
+	std::uint32_t name;
+	std::uint32_t returnSpelling;
+	std::uint32_t firstArgument;
+	std::uint32_t numArguments;
+	std::uint32_t flags;
+};
+
+struct AttributeRecord {
+	std::uint32_t name;
+	std::uint32_t typeSpelling;
+};
+
+struct ConstructorRecord {
+	std::uint32_t firstArgument;
+	std::uint32_t numArguments;
+};
+
+struct BaseRecord {
+	std::uint32_t name;
+	// index of the base in the ClassRecords, or noClassIndex
+	std::uint32_t classIndex;
+};
+
+#endif /* METADATA_FORMAT_H */
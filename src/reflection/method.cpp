@@ -15,10 +15,15 @@ MethodImpl::MethodImpl(
 		bool isStatic
 #ifndef NO_RTTI
 		, const ::std::type_info& returnType
-		, ::std::vector<const ::std::type_info*> argumentTypes
+		, const ::std::type_info* const* argumentTypes
 #endif
+		, framemethod frameMethod
+		, nativeentry nativeEntry
 		)
 	: m_method(m)
+	, m_frameMethod(frameMethod)
+	, m_nativeEntry(nativeEntry)
+	, m_row(nullptr)
 	, m_name(name)
 	, m_returnSpelling(returnSpelling)
 	, m_argSpellings(argSpellings)
@@ -32,6 +37,24 @@ MethodImpl::MethodImpl(
 #endif
 {}
 
+MethodImpl::MethodImpl(const MethodRow& row)
+	: m_method(nullptr)
+	, m_frameMethod(nullptr)
+	, m_nativeEntry(nullptr)
+	, m_row(&row)
+	, m_name(row.name)
+	, m_returnSpelling(row.returnSpelling)
+	, m_argSpellings(row.argSpellings)
+	, m_numArgs(row.signature->numArgs)
+	, m_isConst(row.signature->isConst)
+	, m_isVolatile(row.signature->isVolatile)
+	, m_isStatic(row.signature->isStatic)
+#ifndef NO_RTTI
+	, m_returnType(*row.signature->returnType)
+	, m_argumentTypes(row.signature->argumentTypes)
+#endif
+{}
+
 
 const char* MethodImpl::name() const
 {
@@ -74,9 +97,9 @@ const ::std::type_info& MethodImpl::returnType() const
 	return m_returnType;
 }
 
-::std::vector<const ::std::type_info*> MethodImpl::argumentTypes() const
+TypeInfoList MethodImpl::argumentTypes() const
 {
-	return m_argumentTypes;
+	return TypeInfoList(m_argumentTypes, m_numArgs);
 }
 #endif
 
@@ -90,7 +113,7 @@ VariantValue MethodImpl::call(const ArgArray& args) const
 		throw ::std::runtime_error("cannnot call non-static method withtout object");
 	}
 	VariantValue v;
-	return m_method(v, args);
+	return invoke(v, args);
 }
 
 VariantValue MethodImpl::call(VariantValue& object, const ArgArray& args) const
@@ -98,7 +121,7 @@ VariantValue MethodImpl::call(VariantValue& object, const ArgArray& args) const
 	if (args.size() < m_numArgs) {
 		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
 	}
-	return m_method(object, args);
+	return invoke(object, args);
 }
 
 VariantValue MethodImpl::call(const VariantValue& object, const ArgArray& args) const
@@ -109,7 +132,7 @@ VariantValue MethodImpl::call(const VariantValue& object, const ArgArray& args)
 	if (!m_isConst) {
 		throw ::std::runtime_error("Called non-const method of const object");
 	}
-	return m_method(object, args);
+	return invoke(object, args);
 }
 
 VariantValue MethodImpl::call(volatile VariantValue& object, const ArgArray& args) const
@@ -120,7 +143,7 @@ VariantValue MethodImpl::call(volatile VariantValue& object, const ArgArray& arg
 	if (!m_isVolatile) {
 		throw ::std::runtime_error("Called non-volatile method of volatile object");
 	}
-	return m_method(object, args);
+	return invoke(object, args);
 }
 
 VariantValue MethodImpl::call(const volatile VariantValue& object, const ArgArray& args) const
@@ -134,5 +157,37 @@ VariantValue MethodImpl::call(const volatile VariantValue& object, const ArgArra
 	if (!m_isVolatile) {
 		throw ::std::runtime_error("Called non-volatile method of volatile object");
 	}
-	return m_method(object, args);
+	return invoke(object, args);
+}
+
+void MethodImpl::call(CallFrame& frame) const
+{
+	if (!m_isStatic) {
+		throw ::std::runtime_error("cannnot call non-static method withtout object");
+	}
+	VariantValue v;
+	call(v, frame);
+}
+
+void MethodImpl::call(VariantValue& object, CallFrame& frame) const
+{
+	if (frame.size() < m_numArgs) {
+		throw ::std::runtime_error("function or constructor called with insufficient number of arguments");
+	}
+	if (m_frameMethod != nullptr) {
+		m_frameMethod(object, frame);
+	} else if (m_row != nullptr) {
+		m_row->signature->frameCall(m_row->target, object, frame);
+	} else {
+		ArgArray args;
+		for (::std::size_t i = 0; i < frame.size(); ++i) {
+			args.push_back(frame.variantArg(i));
+		}
+		frame.pushVariant(invoke(object, args));
+	}
+}
+
+const NativeEntry* MethodImpl::nativeEntry() const
+{
+	return m_nativeEntry != nullptr ? m_nativeEntry() : nullptr;
 }
@@ -11,10 +11,102 @@
 #include "reflection.h"
 #include "str_utils.h"
 #include "call_utils.h"
+#include "call_frame.h"
+#include "native_call.h"
 
 #include <algorithm>
 
 
+/* A pointer to member function stored by address, so that all methods with
+ * the same signature can share one invoker instead of one per method. The
+ * pointer is kept in a constant of its own, so a MethodTarget is a constant
+ * expression too. Q is the type of the pointer as declared, see
+ * method_declaration, the constant has the type P of the reflected class.
+ */
+struct MethodTarget {
+
+	template<class P, class Q, Q ptr>
+	struct constant {
+		static constexpr P value = ptr;
+	};
+
+	template<class P, class Q, Q ptr>
+	static constexpr MethodTarget of() {
+		return MethodTarget{ &constant<P, Q, ptr>::value };
+	}
+
+	template<class P>
+	P get() const {
+		return *static_cast<const P*>(address);
+	}
+
+	const void* address;
+};
+
+template<class P, class Q, Q ptr>
+constexpr P MethodTarget::constant<P, Q, ptr>::value;
+
+/* An inherited method is a pointer to member of the base class, which does
+ * not convert to P as a template argument. decltype(of(&Class::method)) is
+ * the type of the overload with the signature of P in the class declaring it.
+ */
+template<class P>
+struct method_declaration;
+
+template<class C, class R, class... A>
+struct method_declaration<R (C::*)(A...)> {
+	template<class D>
+	static auto of(R (D::*p)(A...)) -> decltype(p);
+};
+
+template<class C, class R, class... A>
+struct method_declaration<R (C::*)(A...) const> {
+	template<class D>
+	static auto of(R (D::*p)(A...) const) -> decltype(p);
+};
+
+template<class C, class R, class... A>
+struct method_declaration<R (C::*)(A...) volatile> {
+	template<class D>
+	static auto of(R (D::*p)(A...) volatile) -> decltype(p);
+};
+
+template<class C, class R, class... A>
+struct method_declaration<R (C::*)(A...) const volatile> {
+	template<class D>
+	static auto of(R (D::*p)(A...) const volatile) -> decltype(p);
+};
+
+template<class R, class... A>
+struct method_declaration<R (*)(A...)> {
+	static auto of(R (*p)(A...)) -> decltype(p);
+};
+
+typedef VariantValue (*sharedmethod)(const MethodTarget&, const volatile VariantValue&, const ArgArray&);
+typedef void (*sharedframemethod)(const MethodTarget&, const volatile VariantValue&, CallFrame&);
+
+// Everything a method table row shares with the methods of the same signature
+struct MethodSignature {
+	sharedmethod call;
+	sharedframemethod frameCall;
+	unsigned int numArgs;
+	bool isConst;
+	bool isVolatile;
+	bool isStatic;
+#ifndef NO_RTTI
+	const ::std::type_info* returnType;
+	const ::std::type_info* const* argumentTypes;
+#endif
+};
+
+// A row of REFL_BEGIN_METHOD_TABLE, constant data the MethodImpl of the row refers to
+struct MethodRow {
+	const MethodSignature* signature;
+	MethodTarget target;
+	const char* name;
+	const char* returnSpelling;
+	const char* argSpellings;
+};
 
 
 namespace {
@@ -29,6 +121,7 @@ struct method_type<_Result(_Clazz::*)(Args...)> {
 	
 	enum { is_const = false };
 	enum { is_volatile = false };
+	enum { is_static = false };
 	
 	typedef _Clazz Clazz;
 	typedef _Result Result;
@@ -65,6 +158,27 @@ struct method_type<_Result(_Clazz::*)(Args...)> {
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
 
+	template<_Result(_Clazz::*ptr)(Args...)>
+	static void framecall(const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, ptr);
+	}
+
+	template<_Result(_Clazz::*ptr)(Args...)>
+	static const NativeEntry* native() {
+		return native_method<all_native<Result, Args...>::value, Clazz, is_const, Result, Args...>::template entry<ptr_to_method, ptr>();
+	}
+
+	static VariantValue sharedcall(const MethodTarget& target, const volatile VariantValue& object, const ArgArray& args)  {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, target.get<ptr_to_method>(), args);
+	}
+
+	static void sharedframecall(const MethodTarget& target, const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, target.get<ptr_to_method>());
+	}
+
 };
 
 
@@ -75,6 +189,7 @@ struct method_type<_Result(_Clazz::*)(Args...) const> {
 	
 	enum { is_const = true };
 	enum { is_volatile = false };
+	enum { is_static = false };
 
 	typedef _Clazz Clazz;
 	typedef _Result Result;
@@ -111,6 +226,27 @@ struct method_type<_Result(_Clazz::*)(Args...) const> {
 		Clazz& ref = verifyObject<Clazz>(object, is_const);
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
+
+	template<_Result(_Clazz::*ptr)(Args...) const>
+	static void framecall(const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, ptr);
+	}
+
+	template<_Result(_Clazz::*ptr)(Args...) const>
+	static const NativeEntry* native() {
+		return native_method<all_native<Result, Args...>::value, Clazz, is_const, Result, Args...>::template entry<ptr_to_method, ptr>();
+	}
+
+	static VariantValue sharedcall(const MethodTarget& target, const volatile VariantValue& object, const ArgArray& args)  {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, target.get<ptr_to_method>(), args);
+	}
+
+	static void sharedframecall(const MethodTarget& target, const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, target.get<ptr_to_method>());
+	}
 };
 
 template<class _Clazz, class _Result, class... Args>
@@ -120,6 +256,7 @@ struct method_type<_Result(_Clazz::*)(Args...) volatile> {
 	
 	enum { is_const = false };
 	enum { is_volatile = true };
+	enum { is_static = false };
 
 	typedef _Clazz Clazz;
 	typedef _Result Result;
@@ -156,6 +293,27 @@ struct method_type<_Result(_Clazz::*)(Args...) volatile> {
 		Clazz& ref = verifyObject<Clazz>(object, is_const);
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
+
+	template<_Result(_Clazz::*ptr)(Args...) volatile>
+	static void framecall(const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, ptr);
+	}
+
+	template<_Result(_Clazz::*ptr)(Args...) volatile>
+	static const NativeEntry* native() {
+		return native_method<all_native<Result, Args...>::value, Clazz, is_const, Result, Args...>::template entry<ptr_to_method, ptr>();
+	}
+
+	static VariantValue sharedcall(const MethodTarget& target, const volatile VariantValue& object, const ArgArray& args)  {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, target.get<ptr_to_method>(), args);
+	}
+
+	static void sharedframecall(const MethodTarget& target, const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, target.get<ptr_to_method>());
+	}
 };
 
 template<class _Clazz, class _Result, class... Args>
@@ -165,6 +323,7 @@ struct method_type<_Result(_Clazz::*)(Args...) const volatile> {
 
 	enum { is_const = true };
 	enum { is_volatile = true };
+	enum { is_static = false };
 
 	typedef _Clazz Clazz;
 	typedef _Result Result;
@@ -201,6 +360,27 @@ struct method_type<_Result(_Clazz::*)(Args...) const volatile> {
 		Clazz& ref = verifyObject<Clazz>(object, is_const);
 		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, ptr, args);
 	}
+
+	template<_Result(_Clazz::*ptr)(Args...) const volatile>
+	static void framecall(const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, ptr);
+	}
+
+	template<_Result(_Clazz::*ptr)(Args...) const volatile>
+	static const NativeEntry* native() {
+		return native_method<all_native<Result, Args...>::value, Clazz, is_const, Result, Args...>::template entry<ptr_to_method, ptr>();
+	}
+
+	static VariantValue sharedcall(const MethodTarget& target, const volatile VariantValue& object, const ArgArray& args)  {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		return call_helper<typename make_indices<sizeof...(Args)>::type, Result>::call(ref, target.get<ptr_to_method>(), args);
+	}
+
+	static void sharedframecall(const MethodTarget& target, const volatile VariantValue& object, CallFrame& frame) {
+		Clazz& ref = verifyObject<Clazz>(object, is_const);
+		frame_invoke<Result, Args...>::call(frame, ref, target.get<ptr_to_method>());
+	}
 };
 
 
@@ -211,6 +391,7 @@ struct method_type<_Result(*)(Args...)> {
 
 	enum { is_const = false };
 	enum { is_volatile = false };
+	enum { is_static = true };
 	typedef _Result Result;
 	typedef TypeList<Args...> Arguments;
 
@@ -238,6 +419,44 @@ struct method_type<_Result(*)(Args...)> {
     static VariantValue bindcall(const volatile VariantValue&, const ArgArray& args)  {
 		return call_helper<Result, typename make_indices<sizeof...(Args)>::type>::call(ptr, args);
 	}
+
+	template <_Result(*ptr)(Args...)>
+	static void framecall(const volatile VariantValue&, CallFrame& frame) {
+		frame_invoke<Result, Args...>::call(frame, ptr);
+	}
+
+	template <_Result(*ptr)(Args...)>
+	static const NativeEntry* native() {
+		return native_function<all_native<Result, Args...>::value, Result, Args...>::template entry<ptr>();
+	}
+
+	static VariantValue sharedcall(const MethodTarget& target, const volatile VariantValue&, const ArgArray& args)  {
+		return call_helper<Result, typename make_indices<sizeof...(Args)>::type>::call(target.get<ptr_to_method>(), args);
+	}
+
+	static void sharedframecall(const MethodTarget& target, const volatile VariantValue&, CallFrame& frame) {
+		frame_invoke<Result, Args...>::call(frame, target.get<ptr_to_method>());
+	}
+};
+
+
+template<class _Method>
+struct method_signature {
+	static const MethodSignature value;
+};
+
+template<class _Method>
+const MethodSignature method_signature<_Method>::value = {
+	&method_type<_Method>::sharedcall,
+	&method_type<_Method>::sharedframecall,
+	typelist_size<typename method_type<_Method>::Arguments>::value,
+	method_type<_Method>::is_const,
+	method_type<_Method>::is_volatile,
+	method_type<_Method>::is_static
+#ifndef NO_RTTI
+	, &typeid(typename method_type<_Method>::Result)
+	, get_typeinfo<typename method_type<_Method>::Arguments>()
+#endif
 };
 
 }
@@ -259,10 +478,15 @@ public:
 			bool isStatic
 #ifndef NO_RTTI
 			, const ::std::type_info& returnType
-			, ::std::vector<const ::std::type_info*> argumentTypes
+			, const ::std::type_info* const* argumentTypes
 #endif
+			, framemethod frameMethod = nullptr
+			, nativeentry nativeEntry = nullptr
 			);
 
+	// a row of a method table, see REFL_BEGIN_METHOD_TABLE
+	explicit MethodImpl(const MethodRow& row);
+
 	const char* name() const;
 	::std::size_t numberOfArguments() const;
 	::std::vector< ::std::string> argumentSpellings() const;
@@ -275,7 +499,7 @@ public:
 
 #ifndef NO_RTTI
 	const ::std::type_info& returnType() const;
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	TypeInfoList argumentTypes() const;
 #endif
 
 
@@ -284,13 +508,28 @@ public:
     VariantValue call(const VariantValue& object, const ArgArray& args) const;
     VariantValue call(volatile VariantValue& object, const ArgArray& args) const;
     VariantValue call(const volatile VariantValue& object, const ArgArray& args) const;
+
+    void call(CallFrame& frame) const;
+    void call(VariantValue& object, CallFrame& frame) const;
+
+    const NativeEntry* nativeEntry() const;
 	
 	MethodImpl(const MethodImpl&) = delete;
 	MethodImpl(MethodImpl&&) = delete;
 	MethodImpl& operator=(const MethodImpl&) = delete;
 	MethodImpl& operator=(MethodImpl&&) = delete;
 
+	VariantValue invoke(const volatile VariantValue& object, const ArgArray& args) const {
+		return m_method != nullptr ? m_method(object, args) : m_row->signature->call(m_row->target, object, args);
+	}
+
+	// null for method table rows
 	const boundmethod m_method;
+	// null for methods not registered with the REFL_ macros
+	const framemethod m_frameMethod;
+	const nativeentry m_nativeEntry;
+	// only for method table rows
+	const MethodRow* const m_row;
 	const char* const m_name;
 	const char* const m_returnSpelling;
 	const char* const m_argSpellings;
@@ -300,7 +539,7 @@ public:
 	const unsigned int m_isStatic : 1;
 #ifndef NO_RTTI
 	const ::std::type_info& m_returnType;
-	const ::std::vector<const ::std::type_info*> m_argumentTypes;
+	const ::std::type_info* const* const m_argumentTypes;
 #endif
 };
 
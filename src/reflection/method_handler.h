@@ -0,0 +1,132 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef METHOD_HANDLER_H
+#define METHOD_HANDLER_H
+
+#include "selfportrait_config.h"
+#include "typelist.h"
+#include "variant.h"
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// one id per function type, unique across translation units
+template<class Signature>
+struct signature_id {
+	static const char id;
+};
+
+template<class Signature>
+const char signature_id<Signature>::id = 0;
+
+
+class TypedMethodHandlerBase {
+public:
+	virtual ~TypedMethodHandlerBase() {}
+
+	const void* signature() const { return m_signature; }
+	::std::size_t numberOfArguments() const { return m_numArgs; }
+
+protected:
+	TypedMethodHandlerBase(const void* signature, ::std::size_t numArgs)
+		: m_signature(signature)
+		, m_numArgs(numArgs) {}
+
+private:
+	const void* const m_signature;
+	const ::std::size_t m_numArgs;
+};
+
+/* Proxy method handler called by stubs with the original arguments,
+ * used when the stub method has exactly this signature
+ */
+template<class Signature>
+class TypedMethodHandler;
+
+template<class R, class... Args>
+class TypedMethodHandler<R(Args...)>: public TypedMethodHandlerBase {
+public:
+	TypedMethodHandler() : TypedMethodHandlerBase(&signature_id<R(Args...)>::id, sizeof...(Args)) {}
+
+	virtual R invoke(Args&&... args) const = 0;
+};
+
+
+// used by the Proxy::addImplementation template, which has external
+// linkage, so they must not live in an anonymous namespace
+namespace detail {
+
+// the counterpart of make_indices, which lives in an anonymous namespace
+template< ::std::size_t...>
+struct handler_indices {};
+
+template< ::std::size_t N, ::std::size_t... I>
+struct make_handler_indices : public make_handler_indices<N-1, N-1, I...> {};
+
+template< ::std::size_t... I>
+struct make_handler_indices<0, I...> {
+	typedef handler_indices<I...> type;
+};
+
+template<class Signature, class F>
+class TypedMethodHandlerImpl;
+
+template<class R, class... Args, class F>
+class TypedMethodHandlerImpl<R(Args...), F>: public TypedMethodHandler<R(Args...)> {
+public:
+	TypedMethodHandlerImpl(F f) : m_f(std::move(f)) {}
+
+	R invoke(Args&&... args) const override {
+		return m_f(std::forward<Args>(args)...);
+	}
+
+private:
+	mutable F m_f;
+};
+
+
+// calls a typed handler from an ArgArray, for callers that only have variants
+template<class Signature>
+struct typed_handler_call;
+
+template<class R, class... Args>
+struct typed_handler_call<R(Args...)> {
+
+	typedef TypedMethodHandler<R(Args...)> Handler;
+
+	template<class Res, class Ind>
+	struct call_helper;
+
+	template<class Res, ::std::size_t... I>
+	struct call_helper<Res, handler_indices<I...>> {
+		static VariantValue call(const Handler& h, const ArgArray& args) {
+			VariantValue ret;
+			ret.construct<Res>(h.invoke(args[I].convertToThrow<Args>("error at argument %1: %2", I)...));
+			return ret;
+		}
+	};
+
+	template< ::std::size_t... I>
+	struct call_helper<void, handler_indices<I...>> {
+		static VariantValue call(const Handler& h, const ArgArray& args) {
+			h.invoke(args[I].convertToThrow<Args>("error at argument %1: %2", I)...);
+			return VariantValue();
+		}
+	};
+
+	static VariantValue call(const Handler& h, const ArgArray& args) {
+		if (args.size() != sizeof...(Args)) {
+			throw ::std::runtime_error("wrong number of arguments to proxy method handler, expected "
+				+ ::std::to_string(sizeof...(Args)) + " got " + ::std::to_string(args.size()));
+		}
+		return call_helper<R, typename make_handler_indices<sizeof...(Args)>::type>::call(h, args);
+	}
+};
+
+}
+
+#endif /* METHOD_HANDLER_H */
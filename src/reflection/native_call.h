@@ -0,0 +1,193 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef NATIVE_CALL_H
+#define NATIVE_CALL_H
+
+#include "selfportrait_config.h"
+#include "call_utils.h"
+#include "variant.h"
+
+#include <cstring>
+#include <exception>
+#include <string>
+
+
+typedef void (*nativefunction)();
+
+/* Plain C entry point of a method or function whose parameters and result
+ * are C scalars, for foreign function interfaces such as the LuaJIT FFI.
+ * Arguments are not converted or checked.
+ * The first argument is a buffer of nativeErrorSize chars: the entries never
+ * throw, the message of an exception is copied there and a zero value is
+ * returned. The buffer is left alone when the call succeeds, so callers
+ * clear it first.
+ * Methods take a pointer to the VariantValue holding the object next.
+ */
+struct NativeEntry {
+	nativefunction function;
+	// C type of function, e.g. "int (*)(char*, void*, int)"
+	const char* (*declaration)();
+};
+
+const ::std::size_t nativeErrorSize = 256;
+
+typedef const NativeEntry* (*nativeentry)();
+
+
+namespace {
+
+template<class T>
+struct native_type {
+	enum { value = false };
+	static const char* name() { return nullptr; }
+};
+
+#define NATIVE_TYPE(T) \
+template<> struct native_type<T> { \
+	enum { value = true }; \
+	static const char* name() { return #T; } \
+};
+
+NATIVE_TYPE(void)
+NATIVE_TYPE(bool)
+NATIVE_TYPE(char)
+NATIVE_TYPE(signed char)
+NATIVE_TYPE(unsigned char)
+NATIVE_TYPE(short)
+NATIVE_TYPE(unsigned short)
+NATIVE_TYPE(int)
+NATIVE_TYPE(unsigned int)
+NATIVE_TYPE(long)
+NATIVE_TYPE(unsigned long)
+NATIVE_TYPE(long long)
+NATIVE_TYPE(unsigned long long)
+NATIVE_TYPE(float)
+NATIVE_TYPE(double)
+NATIVE_TYPE(const char*)
+
+#undef NATIVE_TYPE
+
+
+template<class... T>
+struct all_native;
+
+template<>
+struct all_native<> {
+	enum { value = true };
+};
+
+template<class H, class... T>
+struct all_native<H, T...> {
+	enum { value = native_type<H>::value && all_native<T...>::value };
+};
+
+
+inline void native_error(char* error, const char* message) noexcept
+{
+	if (error != nullptr) {
+		::std::strncpy(error, *message ? message : "unknown error", nativeErrorSize - 1);
+		error[nativeErrorSize - 1] = '\0';
+	}
+}
+
+// calls f, reporting its exceptions in error
+template<class R, class F>
+R native_invoke(char* error, F&& f) noexcept
+{
+	try {
+		return f();
+	} catch (const ::std::exception& ex) {
+		native_error(error, ex.what());
+	} catch (...) {
+		native_error(error, "unknown exception");
+	}
+	return R();
+}
+
+
+template<bool isMethod, class R, class... Args>
+struct native_declaration {
+
+	static ::std::string build() {
+		const char* params[] = { "char*", (isMethod ? "void*" : nullptr), native_type<Args>::name()... };
+
+		::std::string ret = native_type<R>::name();
+		ret += " (*)(";
+		bool first = true;
+		for (const char* p: params) {
+			if (p != nullptr) {
+				if (!first) {
+					ret += ", ";
+				}
+				ret += p;
+				first = false;
+			}
+		}
+		ret += ")";
+		return ret;
+	}
+
+	static const char* get() {
+		static const ::std::string decl = build();
+		return decl.c_str();
+	}
+};
+
+
+template<bool representable, class C, bool isConst, class R, class... Args>
+struct native_method {
+	template<class P, P ptr>
+	static const NativeEntry* entry() { return nullptr; }
+};
+
+template<class C, bool isConst, class R, class... Args>
+struct native_method<true, C, isConst, R, Args...> {
+
+	template<class P, P ptr>
+	static R call(char* error, void* object, Args... args) noexcept {
+		if (object == nullptr) {
+			native_error(error, "no object given");
+			return R();
+		}
+		return native_invoke<R>(error, [&]() -> R {
+			C& ref = verifyObject<C>(*static_cast<const volatile VariantValue*>(object), isConst);
+			return (ref.*ptr)(args...);
+		});
+	}
+
+	template<class P, P ptr>
+	static const NativeEntry* entry() {
+		static const NativeEntry e = { reinterpret_cast<nativefunction>(&call<P, ptr>), &native_declaration<true, R, Args...>::get };
+		return &e;
+	}
+};
+
+
+template<bool representable, class R, class... Args>
+struct native_function {
+	template<R(*ptr)(Args...)>
+	static const NativeEntry* entry() { return nullptr; }
+};
+
+template<class R, class... Args>
+struct native_function<true, R, Args...> {
+
+	template<R(*ptr)(Args...)>
+	static R call(char* error, Args... args) noexcept {
+		return native_invoke<R>(error, [&]() -> R {
+			return ptr(args...);
+		});
+	}
+
+	template<R(*ptr)(Args...)>
+	static const NativeEntry* entry() {
+		static const NativeEntry e = { reinterpret_cast<nativefunction>(&call<ptr>), &native_declaration<false, R, Args...>::get };
+		return &e;
+	}
+};
+
+}
+
+#endif /* NATIVE_CALL_H */
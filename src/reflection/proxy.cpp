@@ -5,40 +5,158 @@
 #include "proxy.h"
 #include "class.h"
 
+#include <algorithm>
+#include <cstdint>
 #include <stdexcept>
 
 
-void ProxyImpl::registerInterface(ClassImpl* iface)
+std::atomic<uint64_t> HandlerEpochs::s_epoch{1};
+std::atomic<HandlerEpochs::Reader*> HandlerEpochs::s_readers{nullptr};
+
+namespace {
+	// gives the reader of a thread back when the thread ends
+	struct ReaderLease {
+		HandlerEpochs::Reader* reader = nullptr;
+
+		~ReaderLease() {
+			if (reader) {
+				reader->used.store(false, std::memory_order_release);
+			}
+		}
+	};
+}
+
+HandlerEpochs::Reader& HandlerEpochs::reader()
 {
-	std::shared_ptr<ProxyImpl> strongRef(weakThis);
-	m_interfaces[iface] = std::move(iface->newInterface(strongRef));
+	static thread_local ReaderLease lease;
+	if (lease.reader) {
+		return *lease.reader;
+	}
+
+	// readers are never freed, those of ended threads are reused
+	for (Reader* r = s_readers.load(std::memory_order_acquire); r; r = r->next) {
+		bool used = false;
+		if (!r->used.load(std::memory_order_relaxed) && r->used.compare_exchange_strong(used, true, std::memory_order_acquire)) {
+			lease.reader = r;
+			return *r;
+		}
+	}
+
+	Reader* r = new Reader;
+	r->next = s_readers.load(std::memory_order_relaxed);
+	while (!s_readers.compare_exchange_weak(r->next, r, std::memory_order_release, std::memory_order_relaxed)) {}
+	lease.reader = r;
+	return *r;
 }
 
-void ProxyImpl::registerHandler(size_t method_hash, Proxy::MethodHandler mh)
+uint64_t HandlerEpochs::retire()
 {
-	m_map[method_hash] = mh;
+	// a call that still reads the old table announced this epoch or an earlier one
+	return s_epoch.fetch_add(1);
 }
 
-bool ProxyImpl::hasHandler(size_t method_hash) const {
-	return (m_map.find(method_hash) != m_map.end());
+uint64_t HandlerEpochs::oldestReader()
+{
+	uint64_t ret = UINT64_MAX;
+	for (Reader* r = s_readers.load(std::memory_order_acquire); r; r = r->next) {
+		const uint64_t epoch = r->epoch.load();
+		if (epoch != 0 && epoch < ret) {
+			ret = epoch;
+		}
+	}
+	return ret;
+}
+
+
+ProxyVTable::ProxyVTable(ClassImpl* iface)
+	: m_iface(iface)
+	, m_slots(iface->methodSlots())
+	, m_table(new HandlerTable(m_slots.size()))
+{
 }
 
-VariantValue ProxyImpl::callArgArray(size_t method_hash, const ArgArray& vargs) const
+ProxyVTable::~ProxyVTable()
 {
-	auto it = m_map.find(method_hash);
-	if (it == m_map.end()) {
-		throw std::logic_error("method not implemented");
+	for (auto& retired: m_retired) {
+		delete retired.second;
 	}
+	delete m_table.load();
+}
 
-	return it->second(vargs);
+size_t ProxyVTable::slotOf(size_t method_hash) const
+{
+	auto it = m_slots.find(method_hash);
+	if (it == m_slots.end()) {
+		return npos;
+	}
+	return it->second;
+}
+
+void ProxyVTable::setHandler(size_t slot, Proxy::MethodHandler mh, std::shared_ptr<TypedMethodHandlerBase> typed)
+{
+	std::lock_guard<std::mutex> lock(m_writeMutex);
+
+	std::unique_ptr<HandlerTable> table(new HandlerTable(*m_table.load()));
+
+	Entry& e = table->at(slot);
+	e.handler = std::move(mh);
+	e.typed = std::move(typed);
+
+	m_retired.reserve(m_retired.size() + 1);
+	const HandlerTable* old = m_table.exchange(table.release());
+	m_retired.emplace_back(HandlerEpochs::retire(), old);
+
+	// a handler that replaces itself is still running, its thread is a reader too
+	const uint64_t oldest = HandlerEpochs::oldestReader();
+	auto it = std::remove_if(m_retired.begin(), m_retired.end(), [oldest](const std::pair<uint64_t, const HandlerTable*>& retired) {
+		if (retired.first < oldest) {
+			delete retired.second;
+			return true;
+		}
+		return false;
+	});
+	m_retired.erase(it, m_retired.end());
+}
+
+
+void ProxyImpl::registerInterface(ClassImpl* iface)
+{
+	std::shared_ptr<ProxyImpl> strongRef(weakThis);
+	m_vtables.emplace_back(new ProxyVTable(iface));
+	ProxyVTable& vtable = *m_vtables.back();
+	vtable.m_stub = iface->newInterface(strongRef, vtable);
+}
+
+bool ProxyImpl::registerHandler(size_t method_hash, Proxy::MethodHandler mh, std::shared_ptr<TypedMethodHandlerBase> typed)
+{
+	bool found = false;
+	for (auto& vtable: m_vtables) {
+		size_t slot = vtable->slotOf(method_hash);
+		if (slot != ProxyVTable::npos) {
+			vtable->setHandler(slot, mh, typed);
+			found = true;
+		}
+	}
+	return found;
+}
+
+bool ProxyImpl::hasHandler(size_t method_hash) const {
+	for (auto& vtable: m_vtables) {
+		if (vtable->hasHandler(vtable->slotOf(method_hash))) {
+			return true;
+		}
+	}
+	return false;
 }
 
 std::list<ClassImpl*> ProxyImpl::interfaces() const
 {
 	std::list<ClassImpl*> ret;
 
-	for (auto it = m_interfaces.begin(); it != m_interfaces.end(); ++it) {
-		ret.push_back(it->first);
+	for (auto& vtable: m_vtables) {
+		if (vtable->m_stub.isValid()) {
+			ret.push_back(vtable->iface());
+		}
 	}
 
 	return std::move(ret);
@@ -47,24 +165,27 @@ std::list<ClassImpl*> ProxyImpl::interfaces() const
 
 VariantValue ProxyImpl::ref(ClassImpl* clazz) const
 {
-	auto it = m_interfaces.find(clazz);
-	if (it != m_interfaces.end()) {
-		return it->second.createReference();
+	for (auto& vtable: m_vtables) {
+		if (vtable->iface() == clazz && vtable->m_stub.isValid()) {
+			return vtable->m_stub.createReference();
+		}
 	}
 	return VariantValue();
 }
 
 void ProxyImpl::incHandleCount()
 {
-	++m_handleCount;
+	m_handleCount.fetch_add(1, std::memory_order_relaxed);
 }
 
 
 void ProxyImpl::decHandleCount()
 {
-	// if there are no handles we can clear the interfaces
+	// if there are no handles we can clear the stubs
 	// that form a circular reference to this object
-	if (--m_handleCount <= 0) {
-		m_interfaces.clear();
+	if (m_handleCount.fetch_sub(1, std::memory_order_acq_rel) <= 1) {
+		for (auto& vtable: m_vtables) {
+			vtable->m_stub = VariantValue();
+		}
 	}
 }
@@ -8,39 +8,192 @@
 #include "selfportrait_config.h"
 #include "collection_utils.h"
 #include "reflection.h"
+#include "class.h"
 
 
-#include <map>
+#include <atomic>
+#include <cstdint>
+#include <list>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 #include <functional>
 
 class ProxyImpl;
 class ClassImpl;
 
+/* Calls through a proxy announce the epoch in which they started to read
+ * handler tables, in a record of their own thread. A replaced table is
+ * freed once no running call can have started before it was replaced,
+ * so calls share neither a lock nor a reference count.
+ */
+class HandlerEpochs {
+public:
 
-class ProxyImpl {
+	struct Reader {
+		// 0 while the thread reads no table
+		std::atomic<uint64_t> epoch{0};
+		unsigned nesting = 0;
+		std::atomic<bool> used{true};
+		Reader* next = nullptr;
+	};
+
+	// held while a call reads a table and runs a handler of it, may nest
+	class Guard {
+	public:
+		Guard() : m_reader(reader()) {
+			if (m_reader.nesting++ == 0) {
+				m_reader.epoch.store(s_epoch.load());
+			}
+		}
+
+		~Guard() {
+			if (--m_reader.nesting == 0) {
+				m_reader.epoch.store(0, std::memory_order_release);
+			}
+		}
+
+		Guard(const Guard&) = delete;
+		Guard& operator=(const Guard&) = delete;
+
+	private:
+		Reader& m_reader;
+	};
+
+	// called once a table is no longer published, returns the epoch it was retired in
+	static uint64_t retire();
+
+	// tables retired in an epoch before this one are not read anymore
+	static uint64_t oldestReader();
+
+private:
+	static Reader& reader();
+
+	static std::atomic<uint64_t> s_epoch;
+	static std::atomic<Reader*> s_readers;
+};
+
+/* handlers of one interface of a proxy, indexed by the interface method slots.
+ * Calls read an immutable table, setHandler publishes a modified copy,
+ * so handlers can be added while other threads call the proxy.
+ */
+class ProxyVTable {
 public:
 
-	ProxyImpl() = default;
+	static const size_t npos = static_cast<size_t>(-1);
 
-	ProxyImpl(const ProxyImpl& that) = delete;
+	ProxyVTable(ClassImpl* iface);
 
-	void registerInterface(ClassImpl* cimpl);
+	~ProxyVTable();
 
-    void registerHandler(size_t method_hash, Proxy::MethodHandler);
+	ProxyVTable(const ProxyVTable& that) = delete;
 
-	bool hasHandler(size_t method_hash) const;
+	ClassImpl* iface() const { return m_iface; }
 
-    VariantValue callArgArray(size_t method_hash, const ArgArray& vargs) const;
+	size_t slotOf(size_t method_hash) const;
+
+	void setHandler(size_t slot, Proxy::MethodHandler mh, std::shared_ptr<TypedMethodHandlerBase> typed);
+
+	bool hasHandler(size_t slot) const {
+		HandlerEpochs::Guard guard;
+		const HandlerTable* table = m_table.load();
+		return slot < table->size() && (*table)[slot].handler;
+	}
+
+	// valid while this thread holds a HandlerEpochs::Guard
+	template<class Signature>
+	const TypedMethodHandler<Signature>* typedHandler(size_t slot) const {
+		const HandlerTable* table = m_table.load();
+		if (slot < table->size()) {
+			const TypedMethodHandlerBase* typed = (*table)[slot].typed.get();
+			if (typed && typed->signature() == &signature_id<Signature>::id) {
+				return static_cast<const TypedMethodHandler<Signature>*>(typed);
+			}
+		}
+		return nullptr;
+	}
+
+	VariantValue callArgArray(size_t slot, const ArgArray& vargs) const {
+		HandlerEpochs::Guard guard;
+		const HandlerTable* table = m_table.load();
+		if (slot >= table->size() || !(*table)[slot].handler) {
+			throw std::logic_error("method not implemented");
+		}
+		return (*table)[slot].handler(vargs);
+	}
 
 	template<class... Args>
-    VariantValue call(size_t method_hash, Args&&... args) const {
-        ArgArray vargs;
+	VariantValue call(size_t slot, Args&&... args) const {
+		ArgArray vargs;
+
+		variant_construct(vargs, std::forward<Args>(args)...);
+		return callArgArray(slot, vargs);
+	}
+
+private:
+	ClassImpl* m_iface;
+	const ClassImpl::SlotMap& m_slots;
+
+	struct Entry {
+		std::shared_ptr<TypedMethodHandlerBase> typed;
+		Proxy::MethodHandler handler;
+	};
+	typedef std::vector<Entry> HandlerTable;
+
+	std::atomic<const HandlerTable*> m_table;
+	// replaced tables and the epochs they were retired in
+	std::vector<std::pair<uint64_t, const HandlerTable*>> m_retired;
+	std::mutex m_writeMutex;
+	VariantValue m_stub;
+
+	friend class ProxyImpl;
+};
+
+
+// used by stub methods: calls the typed handler when its signature
+// is the same as the stub's, otherwise goes through variants
+template<class Signature>
+struct proxy_stub_call;
+
+template<class R, class... Args>
+struct proxy_stub_call<R(Args...)> {
+	template<class... A>
+	static R call(const ProxyVTable& vtable, size_t slot, A&... args) {
+		HandlerEpochs::Guard guard;
+		if (const TypedMethodHandler<R(Args...)>* typed = vtable.typedHandler<R(Args...)>(slot)) {
+			return typed->invoke(static_cast<Args&&>(args)...);
+		}
+		return vtable.call(slot, args...).template moveValueThrow<R>();
+	}
+};
 
-        variant_construct(vargs, std::forward<Args>(args)...);
-		return callArgArray(method_hash, vargs );
+template<class... Args>
+struct proxy_stub_call<void(Args...)> {
+	template<class... A>
+	static void call(const ProxyVTable& vtable, size_t slot, A&... args) {
+		HandlerEpochs::Guard guard;
+		if (const TypedMethodHandler<void(Args...)>* typed = vtable.typedHandler<void(Args...)>(slot)) {
+			typed->invoke(static_cast<Args&&>(args)...);
+		} else {
+			vtable.call(slot, args...);
+		}
 	}
+};
+
+
+class ProxyImpl {
+public:
+
+	ProxyImpl() = default;
+
+	ProxyImpl(const ProxyImpl& that) = delete;
+
+	void registerInterface(ClassImpl* cimpl);
+
+	bool registerHandler(size_t method_hash, Proxy::MethodHandler, std::shared_ptr<TypedMethodHandlerBase> typed);
+
+	bool hasHandler(size_t method_hash) const;
 
 	VariantValue ref(ClassImpl* clazz) const;
 
@@ -53,15 +206,12 @@ public:
 
 
 private:
-	typedef size_t hash_t;
-	typedef std::map<hash_t, Proxy::MethodHandler > methmap;
-	typedef std::map<ClassImpl*, VariantValue > ifacemap;
+	// stubs keep a reference to their table, so it must not move
+	typedef std::vector<std::unique_ptr<ProxyVTable>> vtables;
 
-	methmap m_map;
-	ifacemap m_interfaces;
-	int m_handleCount = 0;
+	vtables m_vtables;
+	std::atomic<int> m_handleCount{0};
 };
 
 
 #endif /* PROXY_H */
-
@@ -96,6 +96,16 @@ void Attribute::set(const VariantValue& object, const VariantValue& value) const
 	return m_impl->set(object, value);
 }
 
+void Attribute::set(VariantValue& object, CallFrame& frame, std::size_t i) const {
+	check_valid();
+	m_impl->set(object, frame, i);
+}
+
+void Attribute::push(const VariantValue& object, CallFrame& frame) const {
+	check_valid();
+	m_impl->push(const_cast<VariantValue&>(object), frame);
+}
+
 Class Attribute::getClass() const
 {
 	return Class(m_class);
@@ -107,6 +117,63 @@ namespace std {
 	}
 }
 
+#ifndef NO_RTTI
+void assignAttributes(CallFrame& frame, std::size_t i, VariantValue& object)
+{
+	Class clazz = Class::lookup(object.typeId());
+	if (!clazz.isValid()) {
+		throw std::runtime_error(strconv::fmt_str("error at argument %1: a table cannot be converted to an unreflected class", i));
+	}
+
+	frame.mapArg(i, [&](CallFrame& entries) {
+		std::string name;
+		for (std::size_t k = 0; k + 1 < entries.size(); k += 2) {
+			if (entries.kind(k) != CallFrame::String) {
+				throw std::runtime_error(strconv::fmt_str("error at argument %1: attribute names must be strings", i));
+			}
+			std::size_t length = 0;
+			const char* s = entries.stringArg(k, length);
+			name.assign(s, length);
+
+			Attribute attr = clazz.getAttribute(name);
+			if (!attr.isValid()) {
+				throw std::runtime_error(strconv::fmt_str("error at argument %1: class %2 has no attribute %3", i, clazz.fullyQualifiedName(), name));
+			}
+
+			if (entries.kind(k + 1) == CallFrame::Table && Class::lookup(attr.type()).isValid()) {
+				// nested objects are assigned in place
+				VariantValue field = attr.get(object);
+				assignAttributes(entries, k + 1, field);
+			} else {
+				attr.set(object, entries, k + 1);
+			}
+		}
+	});
+}
+
+bool pushAttributes(CallFrame& frame, VariantValue& object)
+{
+	Class clazz = Class::lookup(object.typeId());
+	if (!clazz.isValid()) {
+		return false;
+	}
+
+	const Class::AttributeList& attributes = clazz.attributes();
+	frame.pushMap(attributes.size(), [&](CallFrame& entries) {
+		for (const Attribute& attr: attributes) {
+			const std::string name = attr.name();
+			// hidden attributes of base classes are left out
+			if (attr.isStatic() || clazz.getAttribute(name) != attr) {
+				continue;
+			}
+			entries.pushString(name.data(), name.size());
+			attr.push(object, entries);
+		}
+	});
+	return true;
+}
+#endif
+
 
 //--------class---------------------------------------------------
 
@@ -228,7 +295,13 @@ const Class::AttributeList& Class::attributes() const {
 
 Attribute Class::getAttribute(const std::string& name) const
 {
-	return findAttribute([&](const Attribute& a){ return a.name() == name; });
+	check_valid();
+	if (m_impl->hasUnresolvedBases()) {
+		return findAttribute([&](const Attribute& a){ return a.name() == name; });
+	}
+	const ClassImpl::AttributeSlotMap& slots = m_impl->attributeSlots();
+	auto it = slots.find(name);
+	return it != slots.end() ? it->second : Attribute();
 }
 
 Attribute Class::findAttribute(std::function<bool(const Attribute& m)> criteria) const
@@ -335,14 +408,63 @@ VariantValue Class::castUp(const VariantValue& baseRef, const Class& base) const
     return std::move(v);
 }
 
+::std::atomic<ClassNode*> ClassRegistry::s_pending{nullptr};
+
+void ClassRegistry::link(ClassNode* node)
+{
+	node->next = s_pending.load(::std::memory_order_relaxed);
+	while (!s_pending.compare_exchange_weak(node->next, node, ::std::memory_order_release, ::std::memory_order_relaxed)) {}
+}
+
+const ClassRegistry::NodeIndex* ClassRegistry::nodes() const
+{
+	if (s_pending.load() == nullptr) {
+		return m_nodes.load();
+	}
+
+	::std::lock_guard< ::std::mutex> lock(m_nodesMutex);
+	ClassNode* pending = s_pending.exchange(nullptr);
+	if (pending == nullptr) {
+		// another thread took them
+		return m_nodes.load();
+	}
+	const NodeIndex* current = m_nodes.load();
+	::std::unique_ptr<NodeIndex> index(current ? new NodeIndex(*current) : new NodeIndex());
+	for (ClassNode* node = pending; node != nullptr; node = node->next) {
+		index->byName.emplace(node->name, node);
+#ifndef NO_RTTI
+		index->byTypeId.emplace(*node->typeInfo, node);
+#endif
+	}
+	m_nodes.store(index.get());
+	m_nodeIndexes.push_back(::std::move(index));
+	return m_nodes.load();
+}
+
+Class ClassRegistry::build(const ClassNode* node)
+{
+	ClassImpl* impl = node->impl.load(::std::memory_order_acquire);
+	if (impl == nullptr) {
+		// built outside any lock, it may look up other classes
+		impl = node->inst();
+		node->impl.store(impl, ::std::memory_order_release);
+	}
+	return Class(impl);
+}
+
 const Class ClassRegistry::forName(const ::std::string& name) const
 {
 	auto it = m_registryByName.find(name);
 	if (it != m_registryByName.end()) {
 		return it->second;
-	} else {
+	}
+
+	const NodeIndex* index = nodes();
+	if (index == nullptr) {
 		return Class();
 	}
+	auto n = index->byName.find(name);
+	return n != index->byName.end() ? build(n->second) : Class();
 }
 
 #ifndef NO_RTTI
@@ -351,9 +473,14 @@ const Class ClassRegistry::forTypeId(const ::std::type_info& id) const
 	auto it = m_registryByTypeId.find(id);
 	if (it != m_registryByTypeId.end()) {
 		return it->second;
-	} else {
+	}
+
+	const NodeIndex* index = nodes();
+	if (index == nullptr) {
 		return Class();
 	}
+	auto n = index->byTypeId.find(id);
+	return n != index->byTypeId.end() ? build(n->second) : Class();
 }
 #endif
 
@@ -365,6 +492,24 @@ void ClassRegistry::registerClass(const Class& c)
 #endif
 }
 
+void ClassRegistry::addMetadata(::std::shared_ptr<const MetadataFile> file)
+{
+	::std::lock_guard< ::std::mutex> lock(m_metadataMutex);
+	m_metadata.push_back(file);
+}
+
+MetadataFile::ClassEntry ClassRegistry::declaration(const ::std::string& name) const
+{
+	::std::lock_guard< ::std::mutex> lock(m_metadataMutex);
+	for (const auto& file: m_metadata) {
+		MetadataFile::ClassEntry entry = file->findClass(name.c_str());
+		if (entry.isValid()) {
+			return entry;
+		}
+	}
+	return MetadataFile::ClassEntry();
+}
+
 ClassRegistry& ClassRegistry::instance()
 {
 	static ClassRegistry instance;
@@ -453,7 +598,7 @@ bool Constructor::isDefaultConstructor() const {
 }
 
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> Constructor::argumentTypes() const {
+TypeInfoList Constructor::argumentTypes() const {
 	check_valid();
 	return m_impl->argumentTypes();
 }
@@ -564,7 +709,7 @@ Method& Method::operator=(Method&& rhs) {
 }
 
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> Method::argumentTypes() const {
+TypeInfoList Method::argumentTypes() const {
 	check_valid();
 	return m_impl->argumentTypes();	
 }
@@ -615,6 +760,21 @@ VariantValue Method::callArgArray(const volatile VariantValue& object, const Arg
 	return m_impl->call(object, vargs );	
 }
 
+void Method::callFrame(CallFrame& frame) const {
+	check_valid();
+	m_impl->call(frame);
+}
+
+void Method::callFrame(VariantValue& object, CallFrame& frame) const {
+	check_valid();
+	m_impl->call(object, frame);
+}
+
+const NativeEntry* Method::nativeEntry() const {
+	check_valid();
+	return m_impl->nativeEntry();
+}
+
 Class Method::getClass() const {
 	return Class(m_class);
 }
@@ -626,8 +786,11 @@ namespace std {
 	size_t hash<Method>::operator()(const Method& m) const {
 		if (m.m_impl == nullptr) {
 			return 0;
-		} else {
+		} else if (m.m_impl->m_method != nullptr) {
 			return reinterpret_cast<size_t>(m.m_impl->m_method);
+		} else {
+			// method table rows share their invoker
+			return reinterpret_cast<size_t>(m.m_impl);
 		}
 	}
 }
@@ -791,7 +954,7 @@ const ::std::type_info& Function::returnType() const {
 }
 
 #ifndef NO_RTTI
-::std::vector<const ::std::type_info*> Function::argumentTypes() const {
+TypeInfoList Function::argumentTypes() const {
 	check_valid();
 	return m_impl->argumentTypes();
 }
@@ -803,18 +966,45 @@ VariantValue Function::callArgArray(const ArgArray& vargs) const
 	return m_impl->call(vargs);
 }
 
+void Function::callFrame(CallFrame& frame) const
+{
+	check_valid();
+	m_impl->call(frame);
+}
+
+const NativeEntry* Function::nativeEntry() const
+{
+	check_valid();
+	return m_impl->nativeEntry();
+}
+
 Function::Function(FunctionImpl* impl)
 	: AnnotatedFrontend(*impl)
 	, m_impl(impl)
 {}
 
-const ::std::list<Function>& Function::findFunctions(const ::std::string& name)
+const Function::FunctionList& Function::findFunctions(const ::std::string& name)
 {
 	return FunctionRegistry::instance().findFunction(name);
 }
 
+Function::FunctionList Function::findFunctions(const ::std::string& name, ::std::size_t numArgs)
+{
+	return FunctionRegistry::instance().findFunction(name, numArgs);
+}
 
-const ::std::list<Function>& FunctionRegistry::findFunction(const ::std::string& name) const
+Function::FunctionList Function::findNamespaceFunctions(const ::std::string& ns)
+{
+	return FunctionRegistry::instance().findNamespace(ns);
+}
+
+namespace {
+	bool lessArity(const Function& f1, const Function& f2) {
+		return f1.numberOfArguments() < f2.numberOfArguments();
+	}
+}
+
+const Function::FunctionList& FunctionRegistry::findFunction(const ::std::string& name) const
 {
 	auto it = m_registry.find(name);
 	if (it == m_registry.end()) {
@@ -824,13 +1014,63 @@ const ::std::list<Function>& FunctionRegistry::findFunction(const ::std::string&
 	}
 }
 
+Function::FunctionList FunctionRegistry::findFunction(const ::std::string& name, ::std::size_t numArgs) const
+{
+	const Function::FunctionList& overloads = findFunction(name);
+
+	auto first = ::std::lower_bound(overloads.begin(), overloads.end(), numArgs, [](const Function& f, ::std::size_t n) {
+		return f.numberOfArguments() < n;
+	});
+	auto last = ::std::upper_bound(first, overloads.end(), numArgs, [](::std::size_t n, const Function& f) {
+		return n < f.numberOfArguments();
+	});
+	// a copy, later overloads of the same arity would be inserted in the range
+	return Function::FunctionList(first, last);
+}
+
+Function::FunctionList FunctionRegistry::findNamespace(const ::std::string& ns) const
+{
+	::std::string key = ns;
+	if (key.size() >= 2 && key.compare(key.size()-2, 2, "::") == 0) {
+		key.resize(key.size()-2);
+	}
+
+	Function::FunctionList ret;
+
+	auto it = m_namespaces.find(key);
+	if (it != m_namespaces.end()) {
+		for (const ::std::string* name: it->second) {
+			const Function::FunctionList& overloads = findFunction(*name);
+			ret.insert(ret.end(), overloads.begin(), overloads.end());
+		}
+	}
+	return ret;
+}
+
 void FunctionRegistry::registerFunction(const ::std::string& name, const Function& func)
 {
 	auto it = m_registry.find(name);
 	if (it == m_registry.end()) {
-		it = m_registry.insert(make_pair(name, ::std::list<Function>())).first;
+		it = m_registry.insert(make_pair(name, Function::FunctionList())).first;
+
+		// index the new name under every enclosing namespace,
+		// ignoring "::" inside template arguments
+		const ::std::string* interned = &it->first;
+		m_namespaces[""].push_back(interned);
+		int depth = 0;
+		for (::std::size_t i = 0; i + 1 < name.size(); ++i) {
+			if (name[i] == '<') {
+				++depth;
+			} else if (name[i] == '>') {
+				--depth;
+			} else if (depth == 0 && name[i] == ':' && name[i+1] == ':') {
+				m_namespaces[name.substr(0, i)].push_back(interned);
+				++i;
+			}
+		}
 	}
-	it->second.push_back(func);
+	Function::FunctionList& overloads = it->second;
+	overloads.insert(::std::upper_bound(overloads.begin(), overloads.end(), func, lessArity), func);
 }
 
 FunctionRegistry& FunctionRegistry::instance() {
@@ -911,8 +1151,18 @@ Proxy::IFaceList Proxy::interfaces() const
 
 void Proxy::addImplementation(const Method& m, MethodHandler handler)
 {
+	addImplementation(m, std::move(handler), nullptr);
+}
+
+void Proxy::addImplementation(const Method& m, MethodHandler handler, std::shared_ptr<TypedMethodHandlerBase> typed)
+{
+	if (typed && typed->numberOfArguments() != m.numberOfArguments()) {
+		throw std::logic_error(strconv::fmt_str("handler for method %1 takes %2 arguments instead of %3", m.name(), typed->numberOfArguments(), m.numberOfArguments()));
+	}
 	std::hash<Method> h;
-    m_impl->registerHandler(h(m), std::move(handler));
+	if (!m_impl->registerHandler(h(m), std::move(handler), std::move(typed))) {
+		throw std::logic_error(strconv::fmt_str("method %1 does not belong to any interface of this proxy", m.name()));
+	}
 }
 
 bool Proxy::hasImplementation(const Method& m) const
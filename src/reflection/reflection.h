@@ -29,6 +29,9 @@
 #include "selfportrait_config.h"
 #include "collection_utils.h"
 #include "variant.h"
+#include "method_handler.h"
+#include "call_frame.h"
+#include "native_call.h"
 
 #include <set>
 #include <list>
@@ -39,12 +42,17 @@
 #include <map>
 #include <functional>
 #include <initializer_list>
+#include <vector>
 
 // All user front-end classes
 
 class ClassImpl;
 class Class;
 
+#ifndef NO_RTTI
+typedef ArrayView<const ::std::type_info*> TypeInfoList;
+#endif
+
 typedef ::std::string Annotation;
 typedef ::std::set<Annotation> AnnotationSet;
 
@@ -94,6 +102,11 @@ public:
 	void set(VariantValue& object, const VariantValue& value) const;
 	void set(const VariantValue& object, const VariantValue& value) const;
 
+	// typed access for language bindings: set reads the value from argument i
+	// of the frame, push pushes it with reflected objects as tables
+	void set(VariantValue& object, CallFrame& frame, ::std::size_t i) const;
+	void push(const VariantValue& object, CallFrame& frame) const;
+
     bool isValid() const
     {
         return (m_impl != nullptr);
@@ -167,7 +180,7 @@ public:
 	bool isDefaultConstructor() const;
 	
 #ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	TypeInfoList argumentTypes() const;
 #endif
 
 	template<class... Args>
@@ -237,7 +250,7 @@ public:
 	::std::vector< ::std::string> argumentSpellings() const;
 
 #ifndef NO_RTTI
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	TypeInfoList argumentTypes() const;
 	const ::std::type_info& returnType() const;
 #endif
 
@@ -282,6 +295,15 @@ public:
     VariantValue callArgArray(volatile VariantValue& object, const ArgArray& vargs) const;
     VariantValue callArgArray(const volatile VariantValue& object, const ArgArray& vargs) const;
 
+	/* reads the arguments from the frame and pushes the result to it,
+	 * used by language bindings (see call_frame.h)
+	 */
+	void callFrame(CallFrame& frame) const;
+	void callFrame(VariantValue& object, CallFrame& frame) const;
+
+	// null unless the signature only has C scalars (see native_call.h)
+	const NativeEntry* nativeEntry() const;
+
 	Class getClass() const;
 
 	Method(MethodImpl* impl);
@@ -431,6 +453,7 @@ private:
 	ClassImpl* m_impl;
 	
 	template<class T> friend Class ClassOf();
+	friend class ClassRegistry;
 	friend struct std::hash<Class>;
 	friend class Constructor;
 	friend class Attribute;
@@ -497,7 +520,7 @@ public:
 
 #ifndef NO_RTTI
 	const ::std::type_info& returnType() const;
-	::std::vector<const ::std::type_info*> argumentTypes() const;
+	TypeInfoList argumentTypes() const;
 #endif
 
 	template<class... Args>
@@ -509,8 +532,22 @@ public:
 
     VariantValue callArgArray(const ArgArray& vargs) const;
 
+	// see Method::callFrame
+	void callFrame(CallFrame& frame) const;
+
+	// see Method::nativeEntry
+	const NativeEntry* nativeEntry() const;
+
 	static const FunctionList& findFunctions(const ::std::string& name);
 
+	//! overloads of name taking exactly numArgs arguments, as registered by now
+	static FunctionList findFunctions(const ::std::string& name, ::std::size_t numArgs);
+
+	/* every function declared in namespace ns (and its nested namespaces),
+	 * e.g. "test_functions" or "test_functions::"
+	 */
+	static FunctionList findNamespaceFunctions(const ::std::string& ns);
+
 private:
 
     //void check_valid() const;
@@ -527,6 +564,8 @@ private:
 
 	template<class FuncPtr>
 	friend Function make_function(boundfunction bf, const char* name, const char* rString, const char* argString);
+	template<class FuncPtr>
+	friend Function make_function(boundfunction bf, framefunction ff, nativeentry ne, const char* name, const char* rString, const char* argString);
 	friend struct std::hash<Function>;
 };
 
@@ -578,12 +617,26 @@ public:
 
     void addImplementation(const Method& m, MethodHandler);
 
+	/* handler with a fixed signature, e.g. addImplementation<int(int, int)>(m, f).
+	 * Stubs whose method has exactly this signature call it directly,
+	 * without boxing the arguments and the result into variants
+	 */
+	template<class Signature, class F>
+	void addImplementation(const Method& m, F handler) {
+		::std::shared_ptr<TypedMethodHandler<Signature>> typed = ::std::make_shared<detail::TypedMethodHandlerImpl<Signature, F>>(::std::move(handler));
+		addImplementation(m, [typed](const ArgArray& args) -> VariantValue {
+			return detail::typed_handler_call<Signature>::call(*typed, args);
+		}, typed);
+	}
+
 	bool hasImplementation(const Method& m) const;
 
 	VariantValue reference(const Class& c) const;
 
 private:
 
+	void addImplementation(const Method& m, MethodHandler handler, ::std::shared_ptr<TypedMethodHandlerBase> typed);
+
 	std::shared_ptr<ProxyImpl> m_impl;
 };
 
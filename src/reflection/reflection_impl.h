@@ -9,11 +9,16 @@
 #include "class.h"
 #include "constructor.h"
 #include "function.h"
+#include "metadata_file.h"
 #include "method.h"
 #include "proxy.h"
 #include "reflection.h"
-#include <unordered_map>
+#include <atomic>
 #include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 #ifndef NO_RTTI
 #include <typeindex>
@@ -24,10 +29,38 @@
 #define UNIQUE TOKENPASTE2(Unique_, __LINE__)
 #define COMMA ,
 
+/* With REFL_STATIC_METADATA a class is registered by a node that is
+ * constant initialized, its meta-class is only built when it is first looked
+ * up. The node still has to be linked into the registry by a dynamic
+ * initializer (ClassLink), which writes next: loading a library runs one
+ * such initializer per class, but no meta-data constructor.
+ */
+struct ClassNode {
+	const char* name;
+#ifndef NO_RTTI
+	const ::std::type_info* typeInfo;
+#endif
+	ClassImpl* (*inst)();
+	ClassNode* next;
+	// the meta-class once built
+	mutable ::std::atomic<ClassImpl*> impl;
+};
+
 class ClassRegistry {
 public:
 	void registerClass(const Class& c);
 
+	// lock free, can be called during static initialization
+	static void link(ClassNode* node);
+
+	/*! Meta-data files describe classes without loading or building them,
+	 * declaration looks a class up in the files added so far. The files
+	 * are kept as long as the registry.
+	 */
+	void addMetadata(::std::shared_ptr<const MetadataFile> file);
+
+	MetadataFile::ClassEntry declaration(const ::std::string& name) const;
+
 	const Class forName(const ::std::string& name) const;
 
 #ifndef NO_RTTI
@@ -39,10 +72,33 @@ public:
 private:
 	ClassRegistry() {}
 
+	struct NodeIndex {
+		::std::unordered_map< ::std::string, const ClassNode* > byName;
+#ifndef NO_RTTI
+		::std::unordered_map< ::std::type_index, const ClassNode* > byTypeId;
+#endif
+	};
+
+	// the nodes linked so far, null if there are none
+	const NodeIndex* nodes() const;
+
+	static Class build(const ClassNode* node);
+
 	::std::unordered_map< ::std::string, Class > m_registryByName;
 #ifndef NO_RTTI
 	::std::unordered_map< ::std::type_index, Class > m_registryByTypeId;
 #endif
+
+	static ::std::atomic<ClassNode*> s_pending;
+	// Read without locking. A new index is only made when a library
+	// linked more nodes, the old ones are kept for the readers still
+	// using them.
+	mutable ::std::atomic<const NodeIndex*> m_nodes{nullptr};
+	mutable ::std::mutex m_nodesMutex;
+	mutable ::std::vector< ::std::unique_ptr<const NodeIndex> > m_nodeIndexes;
+
+	mutable ::std::mutex m_metadataMutex;
+	::std::vector< ::std::shared_ptr<const MetadataFile> > m_metadata;
 };
 
 namespace {
@@ -54,12 +110,38 @@ namespace {
 		}
 	};
 
+	struct ClassLink {
+		ClassLink(ClassNode& node) {
+			ClassRegistry::link(&node);
+		}
+	};
+
 }
 
+#ifdef REFL_STATIC_METADATA
+
+#ifndef NO_RTTI
+#define REFL_CLASS_NODE(CLASS_NAME) { #CLASS_NAME, &typeid(CLASS_NAME), &ClassImpl::inst<CLASS_NAME>, nullptr, {nullptr} }
+#else
+#define REFL_CLASS_NODE(CLASS_NAME) { #CLASS_NAME, &ClassImpl::inst<CLASS_NAME>, nullptr, {nullptr} }
+#endif
+
+#define REFL_REGISTER_CLASS(CLASS_NAME) \
+template<> ClassImpl* ClassImpl::inst<CLASS_NAME>(); \
+static ClassNode UNIQUE = REFL_CLASS_NODE(CLASS_NAME); \
+static ClassLink TOKENPASTE2(Link_, __LINE__)(UNIQUE);
+
+#else
+
+#define REFL_REGISTER_CLASS(CLASS_NAME) \
+	static ClassRegHelper<CLASS_NAME> UNIQUE(#CLASS_NAME);
+
+#endif
+
 #ifndef NO_RTTI
 
 #define REFL_BEGIN_CLASS(CLASS_NAME) \
-	static ClassRegHelper<CLASS_NAME> UNIQUE(#CLASS_NAME); \
+REFL_REGISTER_CLASS(CLASS_NAME) \
 template<> ClassImpl* ClassImpl::inst<CLASS_NAME>() {\
 	typedef CLASS_NAME ThisClass;\
 	static ClassImpl instance;\
@@ -70,7 +152,7 @@ template<> ClassImpl* ClassImpl::inst<CLASS_NAME>() {\
 #else
 
 #define REFL_BEGIN_CLASS(CLASS_NAME) \
-	static ClassRegHelper<CLASS_NAME> UNIQUE(#CLASS_NAME); \
+REFL_REGISTER_CLASS(CLASS_NAME) \
 template<> ClassImpl* ClassImpl::inst<CLASS_NAME>() {\
 	typedef CLASS_NAME ThisClass;\
 	static ClassImpl instance;\
@@ -124,6 +206,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -141,6 +225,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -158,6 +244,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -175,6 +263,8 @@ static MethodImpl impl(\
 			  false\
 			  , typeid(typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::Result)\
 			  , get_typeinfo<typename method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::Arguments>()\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -192,6 +282,8 @@ static MethodImpl impl(\
 			true\
 			, typeid(typename method_type<RESULT(*)(__VA_ARGS__)>::Result)\
 			, get_typeinfo<typename method_type<RESULT(*)(__VA_ARGS__)>::Arguments>()\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::framecall<&ThisClass::METHOD_NAME>\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::native<&ThisClass::METHOD_NAME>\
 			);\
 instance.registerMethod(Method(&impl));\
 }
@@ -210,6 +302,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__)>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -225,6 +319,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -240,6 +336,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -255,6 +353,8 @@ static MethodImpl impl(\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::is_const,\
 			  method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::is_volatile,\
 			  false\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::framecall<&ThisClass::METHOD_NAME>\
+			  , &method_type<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::native<&ThisClass::METHOD_NAME>\
 			  );\
 instance.registerMethod(Method(&impl));\
 }
@@ -270,11 +370,50 @@ static MethodImpl impl(\
 			false,\
 			false,\
 			true\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::framecall<&ThisClass::METHOD_NAME>\
+			, &method_type<RESULT(*)(__VA_ARGS__)>::native<&ThisClass::METHOD_NAME>\
 			);\
 instance.registerMethod(Method(&impl));\
 }
 #endif
 
+/* Method tables: the methods of a class are the rows of one array instead
+ * of a static MethodImpl and three call instantiations each. A row is
+ * constant data, the names, the signature and the member pointer, so the
+ * table is in read-only memory without any code to initialize it. Only the
+ * MethodImpl referring to each row is built when the class is registered,
+ * whatever depends only on the signature is shared by all methods with that
+ * signature. Rows have no native entry for the FFI, and interfaces with
+ * stubs must use REFL_METHOD and friends.
+ */
+#define REFL_BEGIN_METHOD_TABLE \
+{\
+static constexpr MethodRow methodTable[] = {
+
+#define REFL_METHOD_ROW(METHOD_NAME, RESULT, ...) \
+	{ &method_signature<RESULT(ThisClass::*)(__VA_ARGS__)>::value, MethodTarget::of<RESULT(ThisClass::*)(__VA_ARGS__), decltype(method_declaration<RESULT(ThisClass::*)(__VA_ARGS__)>::of(&ThisClass::METHOD_NAME)), &ThisClass::METHOD_NAME>(), #METHOD_NAME, #RESULT, #__VA_ARGS__ },
+
+#define REFL_CONST_METHOD_ROW(METHOD_NAME, RESULT, ...) \
+	{ &method_signature<RESULT(ThisClass::*)(__VA_ARGS__) const>::value, MethodTarget::of<RESULT(ThisClass::*)(__VA_ARGS__) const, decltype(method_declaration<RESULT(ThisClass::*)(__VA_ARGS__) const>::of(&ThisClass::METHOD_NAME)), &ThisClass::METHOD_NAME>(), #METHOD_NAME, #RESULT, #__VA_ARGS__ },
+
+#define REFL_VOLATILE_METHOD_ROW(METHOD_NAME, RESULT, ...) \
+	{ &method_signature<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::value, MethodTarget::of<RESULT(ThisClass::*)(__VA_ARGS__) volatile, decltype(method_declaration<RESULT(ThisClass::*)(__VA_ARGS__) volatile>::of(&ThisClass::METHOD_NAME)), &ThisClass::METHOD_NAME>(), #METHOD_NAME, #RESULT, #__VA_ARGS__ },
+
+#define REFL_CONST_VOLATILE_METHOD_ROW(METHOD_NAME, RESULT, ...) \
+	{ &method_signature<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::value, MethodTarget::of<RESULT(ThisClass::*)(__VA_ARGS__) const volatile, decltype(method_declaration<RESULT(ThisClass::*)(__VA_ARGS__) const volatile>::of(&ThisClass::METHOD_NAME)), &ThisClass::METHOD_NAME>(), #METHOD_NAME, #RESULT, #__VA_ARGS__ },
+
+#define REFL_STATIC_METHOD_ROW(METHOD_NAME, RESULT, ...) \
+	{ &method_signature<RESULT(*)(__VA_ARGS__)>::value, MethodTarget::of<RESULT(*)(__VA_ARGS__), decltype(method_declaration<RESULT(*)(__VA_ARGS__)>::of(&ThisClass::METHOD_NAME)), &ThisClass::METHOD_NAME>(), #METHOD_NAME, #RESULT, #__VA_ARGS__ },
+
+#define REFL_END_METHOD_TABLE \
+};\
+static ::std::list<MethodImpl> methodImpls;\
+for (const MethodRow& row: methodTable) {\
+	methodImpls.emplace_back(row);\
+	instance.registerMethod(Method(&methodImpls.back()));\
+}\
+}
+
 #define REFL_ATTRIBUTE(ATTRIBUTE_NAME, TYPE_SPELLING) \
 	static AttributeImpl<decltype(&ThisClass::ATTRIBUTE_NAME)> impl##ATTRIBUTE_NAME(#ATTRIBUTE_NAME, &ThisClass::ATTRIBUTE_NAME, #TYPE_SPELLING);\
 	instance.registerAttribute(&impl##ATTRIBUTE_NAME);
@@ -297,7 +436,10 @@ instance.registerMethod(Method(&impl));\
 class FunctionRegistry {
 public:
 
-	const ::std::list<Function>& findFunction(const ::std::string& name) const;
+	const Function::FunctionList& findFunction(const ::std::string& name) const;
+	Function::FunctionList findFunction(const ::std::string& name, ::std::size_t numArgs) const;
+	Function::FunctionList findNamespace(const ::std::string& ns) const;
+
 	void registerFunction(const ::std::string& name, const Function& func);
 
 	static FunctionRegistry& instance();
@@ -305,16 +447,19 @@ public:
 private:
 	FunctionRegistry() {}
 
-	::std::map< ::std::string, ::std::list<Function> > m_registry;
-	const ::std::list<Function> emptyList;
+	// overloads are kept sorted by number of arguments
+	::std::unordered_map< ::std::string, Function::FunctionList > m_registry;
+	// namespace -> names (interned keys of m_registry) declared in it, directly or nested
+	::std::unordered_map< ::std::string, ::std::vector<const ::std::string*> > m_namespaces;
+	const Function::FunctionList emptyList;
 };
 
 
 
 template<class FuncType>
 struct FuncRegHelper {
-	FuncRegHelper( boundfunction bf, const char* name, const char* rString, const char* args ) {
-		FunctionRegistry::instance().registerFunction(name, make_function<FuncType>(bf, name, rString, args));
+	FuncRegHelper( boundfunction bf, framefunction ff, nativeentry ne, const char* name, const char* rString, const char* args ) {
+		FunctionRegistry::instance().registerFunction(name, make_function<FuncType>(bf, ff, ne, name, rString, args));
 	}
 };
 
@@ -323,7 +468,7 @@ struct FuncRegHelper {
 	static FuncRegHelper<RESULT (*)(__VA_ARGS__)> UNIQUE(#NAME, &NAME, #RESULT, #__VA_ARGS__);
 */
 #define REFL_FUNCTION(NAME, RESULT, ...) \
-	static FuncRegHelper<RESULT (*)(__VA_ARGS__)> UNIQUE(&function_type<RESULT (*)(__VA_ARGS__)>::bindcall<&NAME>, #NAME, #RESULT, #__VA_ARGS__);
+	static FuncRegHelper<RESULT (*)(__VA_ARGS__)> UNIQUE(&function_type<RESULT (*)(__VA_ARGS__)>::bindcall<&NAME>, &function_type<RESULT (*)(__VA_ARGS__)>::framecall<&NAME>, &function_type<RESULT (*)(__VA_ARGS__)>::native<&NAME>, #NAME, #RESULT, #__VA_ARGS__);
 
 
 /* macro wizardry reference:
@@ -567,10 +712,11 @@ struct FuncRegHelper {
 	namespace {\
 		class STUBCLASSNAME: public CLASS {\
 			std::shared_ptr<ProxyImpl> impl;\
+			const ProxyVTable& vtable;\
 		public:\
-			STUBCLASSNAME(std::shared_ptr<ProxyImpl>& pi) : impl(pi){}\
+			STUBCLASSNAME(std::shared_ptr<ProxyImpl>& pi, const ProxyVTable& vt) : impl(pi), vtable(vt) {}\
 			typedef CLASS ThisClass;\
-			static VariantValue create(std::shared_ptr<ProxyImpl>& pImpl) { VariantValue ret; ret.construct<STUBCLASSNAME>(pImpl); return std::move(ret); }
+			static VariantValue create(std::shared_ptr<ProxyImpl>& pImpl, const ProxyVTable& vt) { VariantValue ret; ret.construct<STUBCLASSNAME>(pImpl, vt); return std::move(ret); }
 
 #define CHECK_N(x, n, ...) n
 #define CHECK(...) CHECK_N(__VA_ARGS__, 0,)
@@ -599,27 +745,27 @@ struct FuncRegHelper {
 
 #define REFL_STUB_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) override {\
-        IF_VOID(RESULT)(NOTHING, return) impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__)>::bindcall<&CLASS::METHOD_NAME>) PRODUCE_COMMA(ARGNAME(__VA_ARGS__))) \
-            IF_VOID(RESULT)(NOTHING, .moveValueThrow<RESULT>());\
+		static const size_t slot = vtable.slotOf(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__)>::bindcall<&CLASS::METHOD_NAME>));\
+		return proxy_stub_call<RESULT(__VA_ARGS__)>::call(vtable, slot PRODUCE_COMMA(ARGNAME(__VA_ARGS__)));\
 	}
 
 #define REFL_STUB_CONST_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) const override {\
-        IF_VOID(RESULT)(NOTHING, return) impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const>::bindcall<&CLASS::METHOD_NAME>) PRODUCE_COMMA(ARGNAME(__VA_ARGS__))) \
-            IF_VOID(RESULT)(NOTHING, .moveValueThrow<RESULT>());\
+		static const size_t slot = vtable.slotOf(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const>::bindcall<&CLASS::METHOD_NAME>));\
+		return proxy_stub_call<RESULT(__VA_ARGS__)>::call(vtable, slot PRODUCE_COMMA(ARGNAME(__VA_ARGS__)));\
 	}
 
 #define REFL_STUB_VOLATILE_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) volatile override {\
-        IF_VOID(RESULT)(NOTHING, return) impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) volatile>::bindcall<&CLASS::METHOD_NAME>) PRODUCE_COMMA(ARGNAME(__VA_ARGS__))) \
-            IF_VOID(RESULT)(NOTHING, .moveValueThrow<RESULT>());\
+		static const size_t slot = vtable.slotOf(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) volatile>::bindcall<&CLASS::METHOD_NAME>));\
+		return proxy_stub_call<RESULT(__VA_ARGS__)>::call(vtable, slot PRODUCE_COMMA(ARGNAME(__VA_ARGS__)));\
 	}
 
 
 #define REFL_STUB_CONST_VOLATILE_METHOD(CLASS, METHOD_NAME, RESULT, ...) \
 	RESULT METHOD_NAME ( TYPE_ARGNAME(__VA_ARGS__) ) const volatile override {\
-        IF_VOID(RESULT)(NOTHING, return) impl->call(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const volatile>::bindcall<&ThisClass::METHOD_NAME>) PRODUCE_COMMA(ARGNAME(__VA_ARGS__))) \
-            IF_VOID(RESULT)(NOTHING, .moveValueThrow<RESULT>());\
+		static const size_t slot = vtable.slotOf(reinterpret_cast<size_t>(&method_type<RESULT(CLASS::*)(__VA_ARGS__) const volatile>::bindcall<&ThisClass::METHOD_NAME>));\
+		return proxy_stub_call<RESULT(__VA_ARGS__)>::call(vtable, slot PRODUCE_COMMA(ARGNAME(__VA_ARGS__)));\
 	}
 
 
@@ -0,0 +1,67 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef STRING_REF_H
+#define STRING_REF_H
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <ostream>
+#include <string>
+
+/* Characters borrowed from the caller, like std::string_view.
+ * A reflected function taking a StringRef reads a Lua string in place,
+ * the characters are only valid until the call returns.
+ */
+class StringRef {
+public:
+	static const ::std::size_t npos = static_cast< ::std::size_t>(-1);
+
+	StringRef() : m_data(""), m_size(0) {}
+	StringRef(const char* data, ::std::size_t size) : m_data(data), m_size(size) {}
+	StringRef(const char* s) : m_data(s), m_size(::std::strlen(s)) {}
+	StringRef(const ::std::string& s) : m_data(s.data()), m_size(s.size()) {}
+
+	const char* data() const { return m_data; }
+	::std::size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+
+	const char* begin() const { return m_data; }
+	const char* end() const { return m_data + m_size; }
+
+	char operator[](::std::size_t i) const { return m_data[i]; }
+
+	StringRef substr(::std::size_t pos, ::std::size_t n = npos) const {
+		pos = ::std::min(pos, m_size);
+		return StringRef(m_data + pos, ::std::min(n, m_size - pos));
+	}
+
+	::std::size_t find(char c, ::std::size_t pos = 0) const {
+		for (; pos < m_size; ++pos) {
+			if (m_data[pos] == c) {
+				return pos;
+			}
+		}
+		return npos;
+	}
+
+	::std::string str() const { return ::std::string(m_data, m_size); }
+	operator ::std::string() const { return str(); }
+
+	bool operator==(const StringRef& rhs) const {
+		return m_size == rhs.m_size && ::std::equal(begin(), end(), rhs.begin());
+	}
+	bool operator!=(const StringRef& rhs) const { return !(*this == rhs); }
+
+private:
+	const char* m_data;
+	::std::size_t m_size;
+};
+
+inline ::std::ostream& operator<<(::std::ostream& out, const StringRef& s) {
+	return out.write(s.data(), s.size());
+}
+
+#endif /* STRING_REF_H */
@@ -57,18 +57,20 @@ struct make_indices {
 template<class TL>
 struct get_typeinfo_impl;
 
+// The type_info pointers are constant expressions, so the table is
+// constant-initialized and no code runs at static initialization time.
+// The trailing nullptr keeps the array non-empty for empty type lists.
 template<typename... T, template<typename...> class TL>
 struct get_typeinfo_impl<TL<T...>> {
-	//typedef ::std::initializer_list<const ::std::type_info*> tlist; // I wanted to return initializer_list, but had strange memory corruption issues	
-	typedef ::std::vector<const ::std::type_info*> tlist;
-	static tlist list() {
-		return { (&typeid(T))... };
-	}
+	static constexpr const ::std::type_info* list[sizeof...(T)+1] = { (&typeid(T))..., nullptr };
 };
 
+template<typename... T, template<typename...> class TL>
+constexpr const ::std::type_info* get_typeinfo_impl<TL<T...>>::list[sizeof...(T)+1];
+
 template<class TL>
-static typename get_typeinfo_impl<TL>::tlist get_typeinfo() {
-		return get_typeinfo_impl<TL>::list();
+constexpr const ::std::type_info* const* get_typeinfo() {
+		return get_typeinfo_impl<TL>::list;
 }
 #endif
 
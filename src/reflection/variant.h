@@ -18,6 +18,7 @@
 #include <utility>
 
 #include "str_conversion.h"
+#include "string_ref.h"
 #include "typeutils.h"
 #include "conversion_cache.h"
 #include <cassert>
@@ -417,7 +418,7 @@ public:
                        ::std::is_integral<ValueType>::value,
                        ::std::is_floating_point<ValueType>::value,
                        ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       ::std::is_same<std::string, typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
         m_value( ::std::forward<Args>(args)...)
     {
@@ -440,7 +441,7 @@ public:
                        ::std::is_integral<ValueType>::value,
                        ::std::is_floating_point<ValueType>::value,
                        ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       ::std::is_same<std::string, typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
         m_value( that.m_value )
     {}
@@ -456,7 +457,7 @@ public:
                        ::std::is_integral<ValueType>::value,
                        ::std::is_floating_point<ValueType>::value,
                        ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       ::std::is_same<std::string, typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
         m_value( that.m_value )
     {}
@@ -557,7 +558,7 @@ public:
                        ::std::is_integral<ValueType>::value,
                        ::std::is_floating_point<ValueType>::value,
                        ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       ::std::is_same<std::string, typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
           m_value(v), m_ptr(&v) {
         static_assert(alignof(ValueType) <= alignment_helper::max_alignment, "unsupported alignment size");
@@ -665,7 +666,7 @@ public:
                        ::std::is_integral<ValueType>::value,
                        ::std::is_floating_point<ValueType>::value,
                        ::std::is_pointer<ValueType>::value,
-                       ::std::is_same<std::string, ValueType>::value,
+                       ::std::is_same<std::string, typename ::std::remove_cv<ValueType>::type>::value,
                        normalize_type<T>::is_const),
           m_value(v), m_ptr(&v) {
         static_assert(alignof(ValueType) <= alignment_helper::max_alignment, "unsupported alignment size");
@@ -1061,6 +1062,35 @@ private:
 		}
 	};
 
+	// borrows the characters of a string held by the variant
+	template<class ValueType>
+    struct stringRefConversion {
+        typedef StringRef type;
+        static type value(const IValueHolder* holder, bool * success) {
+			if (success != nullptr) *success = true;
+			if (holder->isStdString()) {
+				return StringRef(*reinterpret_cast<const ::std::string*>(holder->ptrToValue()));
+			}
+			try {
+				holder->throwCast();
+			} catch (const char* const* s) {
+				if (*s != nullptr) {
+					return StringRef(*s);
+				}
+			} catch (...) {}
+			if (success != nullptr) *success = false;
+			return StringRef();
+		}
+        static type value(const IValueHolder* holder) {
+			bool success = false;
+			StringRef ret = value(holder, &success);
+			if (!success) {
+				throw std::runtime_error("variant does not hold a string");
+			}
+			return ret;
+		}
+	};
+
 	template<class ValueType>
     struct impossibleConversion {
         typedef ValueType type;
@@ -1126,9 +1156,11 @@ public:
                             stringConversion<ValueType>,
                                 typename Select<std::is_same<ValueType, const ::std::string&>::value,
                                     stringConversion<ValueType>,
-                                    typename Select<std::is_pointer<ValueType>::value,
-                                            pointerConversion<ValueType>,
-                                            impossibleConversion<ValueType>>::type>::type>::type>::type>::type;
+                                    typename Select<std::is_same<typename ::std::decay<ValueType>::type, StringRef>::value,
+                                        stringRefConversion<ValueType>,
+                                        typename Select<std::is_pointer<ValueType>::value,
+                                                pointerConversion<ValueType>,
+                                                impossibleConversion<ValueType>>::type>::type>::type>::type>::type>::type;
 	
     template<class ValueType>
     typename converter<ValueType>::type convertTo(bool * success = nullptr) const {
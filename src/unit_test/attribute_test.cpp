@@ -58,6 +58,18 @@ namespace AttributeTest {
         char attr2[36];
     };
 
+    struct Base {
+        int a = 1;
+        int b = 2;
+    };
+
+    // hides b of the base class
+    struct Derived: public Base {
+        int b = 20;
+        double c = 3.5;
+        std::string d = "d";
+    };
+
 }
 
 REFL_BEGIN_CLASS(AttributeTest::Test)
@@ -82,6 +94,20 @@ REFL_ATTRIBUTE(attr1, AttributeTest::NonCopyable)
 REFL_ATTRIBUTE(attr2, char[36])
 REFL_END_CLASS
 
+REFL_BEGIN_CLASS(AttributeTest::Base)
+	REFL_ATTRIBUTE(a, int)
+	REFL_ATTRIBUTE(b, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(AttributeTest::Derived)
+	REFL_SUPER_CLASS(AttributeTest::Base)
+	REFL_ATTRIBUTE(b, int)
+	REFL_ATTRIBUTE(c, double)
+	REFL_ATTRIBUTE(d, std::string)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
 using namespace AttributeTest;
 
 void AttributeTestSuite::testVanillaAttribute()
@@ -184,6 +210,19 @@ void AttributeTestSuite::testLuaAPI()
 	LuaUtils::callFunc<bool>(L, "testAttribute");
 }
 
+void AttributeTestSuite::testLuaBulkAccess()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/attribute_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testBulkAccess");
+}
+
 
 void AttributeTestSuite::testHash()
 {
@@ -17,6 +17,7 @@ public:
 	void testConstAttribute();
 	void testStaticAttribute();
 	void testLuaAPI();
+	void testLuaBulkAccess();
 	void testHash();
 	void testClassRef();
     void testNonAssignableAttribute();
@@ -115,3 +115,51 @@ function testAttribute()
 
     return true
 end
+
+function testBulkAccess()
+
+    local Derived = Class.lookup("AttributeTest::Derived")
+    local v = Derived:construct()
+
+    -- the attributes of the class hide those of its bases
+    TS_ASSERT[[ v.a:tonumber() == 1 ]]
+    TS_ASSERT[[ v.b:tonumber() == 20 ]]
+
+    local a, b, c, d = v:getAttributes{"a", "b", "c", "d"}
+    TS_ASSERT[[ a:tonumber() == 1 ]]
+    TS_ASSERT[[ b:tonumber() == 20 ]]
+    TS_ASSERT[[ c:tonumber() == 3.5 ]]
+    TS_ASSERT[[ d:tostring() == "d" ]]
+    TS_ASSERT[[ select("#", v:getAttributes{}) == 0 ]]
+
+    v:setAttributes{a = 10, b = 200, c = 0.5, d = "dd"}
+    TS_ASSERT[[ v.a:tonumber() == 10 ]]
+    TS_ASSERT[[ v.b:tonumber() == 200 ]]
+    TS_ASSERT[[ v.c:tonumber() == 0.5 ]]
+    TS_ASSERT[[ v.d:tostring() == "dd" ]]
+
+    v.c = 1.5
+    TS_ASSERT[[ v.c:tonumber() == 1.5 ]]
+
+    TS_ASSERT[[ not pcall(function() return v:getAttributes{"a", "z"} end) ]]
+    TS_ASSERT[[ not pcall(function() v:setAttributes{z = 1} end) ]]
+    TS_ASSERT[[ not pcall(function() v.z = 1 end) ]]
+    TS_ASSERT[[ not pcall(function() return Variant.new(1):getAttributes{"a"} end) ]]
+
+    local accessor = Derived:attributeAccessor{"d", "a"}
+    TS_ASSERT[[ table.concat(accessor:names(), ",") == "d,a" ]]
+
+    local d, a = accessor:get(v)
+    TS_ASSERT[[ d:tostring() == "dd" ]]
+    TS_ASSERT[[ a:tonumber() == 10 ]]
+
+    local w = Derived:construct()
+    accessor:set(w, "x", 7)
+    d, a = accessor:get(w)
+    TS_ASSERT[[ d:tostring() == "x" and a:tonumber() == 7 ]]
+    TS_ASSERT[[ w.b:tonumber() == 20 ]]
+
+    TS_ASSERT[[ not pcall(function() return Derived:attributeAccessor{"z"} end) ]]
+
+    return true
+end
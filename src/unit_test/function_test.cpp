@@ -12,8 +12,17 @@
 
 #include <lua.hpp>
 
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <future>
 #include <iostream>
+#include <map>
+#include <stdexcept>
 #include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 using namespace std;
 
 
@@ -35,7 +44,7 @@ REFL_FUNCTION(FunctionTest::globalFunction, int, int, int)
 
 void FunctionTestSuite::testFunction()
 {
-	std::list<Function> functions = Function::findFunctions("FunctionTest::globalFunction");
+	Function::FunctionList functions = Function::findFunctions("FunctionTest::globalFunction");
 
 	Function overload1;
 	Function overload2;
@@ -421,7 +430,7 @@ void FunctionTestSuite::testFunctionHash()
 	using namespace std;
 	unordered_map<Function, int> fmap;
 
-	std::list<Function> functions = Function::findFunctions("FunctionTest::globalFunction");
+	Function::FunctionList functions = Function::findFunctions("FunctionTest::globalFunction");
 	auto it = functions.begin();
 
 	Function f1 = *it++;
@@ -433,3 +442,431 @@ void FunctionTestSuite::testFunctionHash()
 	TS_ASSERT_EQUALS(fmap[f1], 1);
 	TS_ASSERT_EQUALS(fmap[f2], 2);
 }
+
+namespace FunctionTest {
+namespace Arity {
+
+	int sum(int a) {
+		return a;
+	}
+
+	int sum(int a, int b) {
+		return a + b;
+	}
+
+	int sum(int a, int b, int c) {
+		return a + b + c;
+	}
+
+}
+}
+
+REFL_FUNCTION(FunctionTest::Arity::sum, int, int, int, int)
+REFL_FUNCTION(FunctionTest::Arity::sum, int, int)
+REFL_FUNCTION(FunctionTest::Arity::sum, int, int, int)
+
+void FunctionTestSuite::testFunctionIndex()
+{
+	const Function::FunctionList& all = Function::findFunctions("FunctionTest::Arity::sum");
+	TS_ASSERT_EQUALS(all.size(), 3);
+
+	size_t arity = 0;
+	for (const Function& f: all) {
+		TS_ASSERT_EQUALS(f.numberOfArguments(), ++arity);
+	}
+
+	Function::FunctionList r = Function::findFunctions("FunctionTest::Arity::sum", 2);
+	TS_ASSERT_EQUALS(r.size(), 1);
+	TS_ASSERT_EQUALS(r.front().call(3, 4).value<int>(), 7);
+
+	TS_ASSERT(Function::findFunctions("FunctionTest::Arity::sum", 0).empty());
+	TS_ASSERT(Function::findFunctions("FunctionTest::Arity::sum", 4).empty());
+	TS_ASSERT(Function::findFunctions("FunctionTest::Arity::nothere", 1).empty());
+
+	TS_ASSERT_EQUALS(Function::findFunctions("FunctionTest::globalFunction", 2).size(), 2);
+
+	Function::FunctionList ns = Function::findNamespaceFunctions("FunctionTest::Arity");
+	TS_ASSERT_EQUALS(ns.size(), 3);
+	TS_ASSERT_EQUALS(Function::findNamespaceFunctions("FunctionTest::Arity::").size(), 3);
+
+	Function::FunctionList outer = Function::findNamespaceFunctions("FunctionTest");
+	TS_ASSERT_EQUALS(outer.size(), 11);
+	TS_ASSERT(std::find(outer.begin(), outer.end(), all.front()) != outer.end());
+
+	TS_ASSERT(Function::findNamespaceFunctions("FunctionTes").empty());
+
+	// registering overloads later leaves the lists found before intact,
+	// and does not add to the overloads of an arity found before
+	auto it = all.begin();
+	const Function& sum1 = *it++;
+	const Function& sum2 = *it++;
+	const Function& sum3 = *it;
+	FunctionRegistry::instance().registerFunction("FunctionIndexTest::sum", sum2);
+	const Function::FunctionList& later = Function::findFunctions("FunctionIndexTest::sum");
+	const Function& first = later.front();
+	Function::FunctionList binary = Function::findFunctions("FunctionIndexTest::sum", 2);
+
+	FunctionRegistry::instance().registerFunction("FunctionIndexTest::sum", sum1);
+	FunctionRegistry::instance().registerFunction("FunctionIndexTest::sum", sum2);
+	FunctionRegistry::instance().registerFunction("FunctionIndexTest::sum", sum3);
+	TS_ASSERT_EQUALS(later.size(), 4);
+	TS_ASSERT_EQUALS(&*std::next(later.begin()), &first);
+	TS_ASSERT_EQUALS(binary.size(), 1);
+	TS_ASSERT_EQUALS(Function::findFunctions("FunctionIndexTest::sum", 2).size(), 2);
+	TS_ASSERT_EQUALS(first.call(3, 4).value<int>(), 7);
+}
+
+namespace ContainerTest {
+
+	typedef std::vector<int> IntVector;
+	typedef std::vector<IntVector> Matrix;
+	typedef std::vector<std::string> StringVector;
+	typedef std::map<std::string, int> Counts;
+
+	int total(const IntVector& v) {
+		int ret = 0;
+		for (int i: v) {
+			ret += i;
+		}
+		return ret;
+	}
+
+	IntVector iota(int n) {
+		IntVector ret;
+		for (int i = 1; i <= n; ++i) {
+			ret.push_back(i);
+		}
+		return ret;
+	}
+
+	Counts count(const StringVector& words) {
+		Counts ret;
+		for (const std::string& w: words) {
+			++ret[w];
+		}
+		return ret;
+	}
+
+	int countOf(const Counts& counts, const std::string& word) {
+		auto it = counts.find(word);
+		return it == counts.end() ? 0 : it->second;
+	}
+
+	Matrix identity(int n) {
+		Matrix ret(n, IntVector(n, 0));
+		for (int i = 0; i < n; ++i) {
+			ret[i][i] = 1;
+		}
+		return ret;
+	}
+
+	int trace(Matrix m) {
+		int ret = 0;
+		for (std::size_t i = 0; i < m.size() && i < m[i].size(); ++i) {
+			ret += m[i][i];
+		}
+		return ret;
+	}
+
+	struct Point {
+		Point() : x(0), y(0) {}
+		int x;
+		int y;
+	};
+
+	struct Segment {
+		Point from;
+		Point to;
+	};
+
+	int manhattan(const Point& p) {
+		return std::abs(p.x) + std::abs(p.y);
+	}
+
+	int length(const Segment& s) {
+		return std::abs(s.to.x - s.from.x) + std::abs(s.to.y - s.from.y);
+	}
+
+	typedef std::vector<Point> PointVector;
+	typedef std::vector<Segment> SegmentVector;
+
+	struct Path {
+		PointVector points;
+		std::string name;
+	};
+
+	int pathLength(const Path& p) {
+		int ret = 0;
+		for (std::size_t i = 1; i < p.points.size(); ++i) {
+			ret += std::abs(p.points[i].x - p.points[i-1].x) + std::abs(p.points[i].y - p.points[i-1].y);
+		}
+		return ret;
+	}
+
+	PointVector ends(const Segment& s) {
+		return { s.from, s.to };
+	}
+
+	SegmentVector halves(const Segment& s) {
+		Segment first = s, second = s;
+		first.to.x = second.from.x = (s.from.x + s.to.x) / 2;
+		first.to.y = second.from.y = (s.from.y + s.to.y) / 2;
+		return { first, second };
+	}
+
+}
+
+REFL_BEGIN_CLASS(ContainerTest::Point)
+	REFL_ATTRIBUTE(x, int)
+	REFL_ATTRIBUTE(y, int)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ContainerTest::Segment)
+	REFL_ATTRIBUTE(from, ContainerTest::Point)
+	REFL_ATTRIBUTE(to, ContainerTest::Point)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(ContainerTest::Path)
+	REFL_ATTRIBUTE(points, ContainerTest::PointVector)
+	REFL_ATTRIBUTE(name, std::string)
+	REFL_DEFAULT_CONSTRUCTOR()
+REFL_END_CLASS
+
+REFL_FUNCTION(ContainerTest::total, int, const ContainerTest::IntVector&)
+REFL_FUNCTION(ContainerTest::iota, ContainerTest::IntVector, int)
+REFL_FUNCTION(ContainerTest::count, ContainerTest::Counts, const ContainerTest::StringVector&)
+REFL_FUNCTION(ContainerTest::countOf, int, const ContainerTest::Counts&, const std::string&)
+REFL_FUNCTION(ContainerTest::identity, ContainerTest::Matrix, int)
+REFL_FUNCTION(ContainerTest::trace, int, ContainerTest::Matrix)
+REFL_FUNCTION(ContainerTest::manhattan, int, const ContainerTest::Point&)
+REFL_FUNCTION(ContainerTest::length, int, const ContainerTest::Segment&)
+REFL_FUNCTION(ContainerTest::pathLength, int, const ContainerTest::Path&)
+REFL_FUNCTION(ContainerTest::ends, ContainerTest::PointVector, const ContainerTest::Segment&)
+REFL_FUNCTION(ContainerTest::halves, ContainerTest::SegmentVector, const ContainerTest::Segment&)
+
+void FunctionTestSuite::testLuaContainers()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testContainers");
+}
+
+void FunctionTestSuite::testLuaObjectFromTable()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testObjectFromTable");
+}
+
+namespace StringTest {
+
+	std::size_t length(StringRef s) {
+		return s.size();
+	}
+
+	std::size_t countLines(const StringRef& text) {
+		return std::count(text.begin(), text.end(), '\n');
+	}
+
+	// a view into the argument, copied into Lua before the argument is released
+	StringRef field(StringRef line, int index) {
+		std::size_t begin = 0;
+		for (int i = 0; i < index; ++i) {
+			begin = line.find(',', begin);
+			if (begin == StringRef::npos) {
+				return StringRef();
+			}
+			++begin;
+		}
+		std::size_t end = line.find(',', begin);
+		return line.substr(begin, end == StringRef::npos ? StringRef::npos : end - begin);
+	}
+
+	std::string repeat(const std::string& s, int times) {
+		std::string ret;
+		for (int i = 0; i < times; ++i) {
+			ret += s;
+		}
+		return ret;
+	}
+
+}
+
+REFL_FUNCTION(StringTest::length, std::size_t, StringRef)
+REFL_FUNCTION(StringTest::countLines, std::size_t, const StringRef&)
+REFL_FUNCTION(StringTest::field, StringRef, StringRef, int)
+REFL_FUNCTION(StringTest::repeat, std::string, const std::string&, int)
+
+void FunctionTestSuite::testLuaStrings()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testStrings");
+}
+
+namespace AsyncTest {
+
+	// hands out futures that are completed together when fire is called
+	class Ticker {
+	public:
+		Ticker() = default;
+		Ticker(const Ticker&) = delete;
+		Ticker& operator=(const Ticker&) = delete;
+
+		std::future<int> next(int value) {
+			m_pending.emplace_back(std::promise<int>(), value);
+			return m_pending.back().first.get_future();
+		}
+
+		int fire() {
+			const int fired = m_pending.size();
+			for (auto& p: m_pending) {
+				p.first.set_value(p.second);
+			}
+			m_pending.clear();
+			return fired;
+		}
+
+		int pending() const {
+			return m_pending.size();
+		}
+
+	private:
+		std::vector<std::pair<std::promise<int>, int>> m_pending;
+	};
+
+	std::shared_future<std::string> ready(const std::string& s) {
+		std::promise<std::string> p;
+		p.set_value(s);
+		return p.get_future().share();
+	}
+
+	std::future<int> later(int x, int ms) {
+		return std::async(std::launch::async, [x, ms]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+			if (x < 0) {
+				throw std::runtime_error("negative value");
+			}
+			return x;
+		});
+	}
+
+}
+
+REFL_BEGIN_CLASS(AsyncTest::Ticker)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_METHOD(next, std::future<int>, int)
+	REFL_METHOD(fire, int)
+	REFL_CONST_METHOD(pending, int)
+REFL_END_CLASS
+
+REFL_FUNCTION(AsyncTest::ready, std::shared_future<std::string>, const std::string&)
+REFL_FUNCTION(AsyncTest::later, std::future<int>, int, int)
+
+void FunctionTestSuite::testLuaAsync()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testAsync");
+}
+
+void FunctionTestSuite::testLuaInvoke()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testInvoke");
+}
+
+void FunctionTestSuite::testNativeEntry()
+{
+	Function sum2 = Function::findFunctions("FunctionTest::Arity::sum", 2).front();
+	const NativeEntry* e = sum2.nativeEntry();
+	TS_ASSERT(e != nullptr);
+	TS_ASSERT_EQUALS(std::string(e->declaration()), "int (*)(char*, int, int)");
+
+	typedef int (*Sum)(char*, int, int);
+	char error[nativeErrorSize] = "";
+	TS_ASSERT_EQUALS(reinterpret_cast<Sum>(e->function)(error, 5, 6), 11);
+	TS_ASSERT_EQUALS(error[0], '\0');
+
+	Function byValue = Function::findFunctions("FunctionTest::returnObjectByValue").front();
+	TS_ASSERT(byValue.nativeEntry() == nullptr);
+}
+
+namespace NativeTest {
+
+	long negative(int x) {
+		return -static_cast<long>(x);
+	}
+
+	unsigned long twice(unsigned long x) {
+		return 2 * x;
+	}
+
+	long long big(int x) {
+		return (1LL << 40) + x;
+	}
+
+	unsigned long long bigUnsigned(int x) {
+		return (1ULL << 52) + x;
+	}
+
+	const char* name(int i) {
+		static const char* const names[] = { "zero", "one" };
+		return i >= 0 && i < 2 ? names[i] : nullptr;
+	}
+
+}
+
+REFL_FUNCTION(NativeTest::negative, long, int)
+REFL_FUNCTION(NativeTest::twice, unsigned long, unsigned long)
+REFL_FUNCTION(NativeTest::big, long long, int)
+REFL_FUNCTION(NativeTest::bigUnsigned, unsigned long long, int)
+REFL_FUNCTION(NativeTest::name, const char*, int)
+
+void FunctionTestSuite::testLuaFFI()
+{
+	TS_ASSERT_EQUALS(std::string(Function::findFunctions("NativeTest::name").front().nativeEntry()->declaration()), "const char* (*)(char*, int)");
+
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/function_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testFFI");
+}
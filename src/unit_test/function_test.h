@@ -28,6 +28,14 @@ public:
 	void testLuaParameterByReference();
 	void testLuaParameterByConstReference();
 	void testFunctionHash();
+	void testFunctionIndex();
+	void testLuaInvoke();
+	void testLuaContainers();
+	void testLuaObjectFromTable();
+	void testLuaStrings();
+	void testLuaAsync();
+	void testNativeEntry();
+	void testLuaFFI();
 };
 
 
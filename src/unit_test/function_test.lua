@@ -17,16 +17,16 @@ function testFunction()
 
     TS_ASSERT(func1)
     TS_ASSERT[[ func1:numberOfArguments() == 2 ]]
-    TS_ASSERT[[ func1:call(3, 5):tonumber() == 8 ]]
-    TS_ASSERT[[ func1:call(2, 4):tonumber() == 6 ]]
+    TS_ASSERT[[ func1:call(3, 5) == 8 ]]
+    TS_ASSERT[[ func1:call(2, 4) == 6 ]]
 
 
     local func2 = funcs["int,int"]
     TS_ASSERT(func2)
     TS_ASSERT[[ func2:numberOfArguments() == 2 ]]
-    TS_ASSERT[[ func2:call(3.3, 5.5):tonumber() == 8 ]]
-    TS_ASSERT[[ func2:call(2, 4):tonumber() == 6 ]]
-    TS_ASSERT[[ func2(2, 4):tonumber() == 6 ]]
+    TS_ASSERT[[ func2:call(3.3, 5.5) == 8 ]]
+    TS_ASSERT[[ func2:call(2, 4) == 6 ]]
+    TS_ASSERT[[ func2(2, 4) == 6 ]]
 
 
     return true
@@ -51,10 +51,10 @@ function testReturnByValue()
     local c = Function.lookup("FunctionTest::returnObjectByValue"):call()
 
     TS_ASSERT(c)
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 33 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 33 ]]
 
     local copies = methods["numberOfCopies"]:call()
-    TS_ASSERT[[ copies:tonumber() == 0 ]]
+    TS_ASSERT[[ copies == 0 ]]
 
     return true
 end
@@ -67,16 +67,16 @@ function testReturnByReference()
 
     TS_ASSERT(c)
     methods["changeId"]:call(c, 45)
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 45 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 45 ]]
 
     methods["changeId"]:call(c, 35)
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 35 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 35 ]]
 
     local c2 = Function.lookup("FunctionTest::returnObjectByReference"):call()
-    TS_ASSERT[[ methods["id"]:call(c2):tonumber() == 35 ]]
+    TS_ASSERT[[ methods["id"]:call(c2) == 35 ]]
 
     local copies = methods["numberOfCopies"]:call()
-    TS_ASSERT[[ copies:tonumber() == 0 ]]
+    TS_ASSERT[[ copies == 0 ]]
 
     return true
 end
@@ -88,13 +88,13 @@ function testReturnByConstReference()
     local c = Function.lookup("FunctionTest::returnObjectByConstReference"):call()
 
     TS_ASSERT(c)
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 888 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 888 ]]
     if pcall( function() methods["changeId"]:call(c, 999) end) then
         TS_FAIL("expected exception when changing const object")
     end
 
     local copies = methods["numberOfCopies"]:call()
-    TS_ASSERT[[ copies:tonumber() == 0 ]]
+    TS_ASSERT[[ copies == 0 ]]
     return true
 end
 
@@ -104,16 +104,16 @@ function testParameterByValue()
 
     local c = constr:call(99)
     TS_ASSERT(c)
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 99 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 99 ]]
 
     local id = Function.lookup("FunctionTest::paramByValue"):call(c)
-    TS_ASSERT[[ id:tonumber() == 99 ]]
+    TS_ASSERT[[ id == 99 ]]
 
     local copies = methods["numberOfCopies"]:call()
     local moves = methods["numberOfMoves"]:call()
 
-    TS_ASSERT[[ copies:tonumber() == 1 ]]
-    TS_ASSERT[[ moves:tonumber() == 0 ]]
+    TS_ASSERT[[ copies == 1 ]]
+    TS_ASSERT[[ moves == 0 ]]
 
     return true
 end
@@ -124,17 +124,17 @@ function testParameterByReference()
 
     local c = constr:call(99)
     TS_ASSERT(c)
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 99 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 99 ]]
 
     local id = Function.lookup("FunctionTest::paramByReference"):call(c)
-    TS_ASSERT[[ id:tonumber() == 100 ]]
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 100 ]]
+    TS_ASSERT[[ id == 100 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 100 ]]
 
     local copies = methods["numberOfCopies"]:call()
     local moves = methods["numberOfMoves"]:call()
 
-    TS_ASSERT[[ copies:tonumber() == 0 ]] --estranho
-    TS_ASSERT[[ moves:tonumber() == 0 ]]
+    TS_ASSERT[[ copies == 0 ]] --estranho
+    TS_ASSERT[[ moves == 0 ]]
     return true
 end
 
@@ -144,17 +144,218 @@ function testParameterByConstReference()
 
     local c = constr:call(99)
     TS_ASSERT(c)
-    TS_ASSERT[[ methods["id"]:call(c):tonumber() == 99 ]]
+    TS_ASSERT[[ methods["id"]:call(c) == 99 ]]
 
     local id = Function.lookup("FunctionTest::paramByConstReference"):call(c)
-    TS_ASSERT[[ id:tonumber() == 99 ]]
+    TS_ASSERT[[ id == 99 ]]
 
     local copies = methods["numberOfCopies"]:call()
     local moves = methods["numberOfMoves"]:call()
 
-    TS_ASSERT[[ copies:tonumber() == 0 ]] --estranho
-    TS_ASSERT[[ moves:tonumber() == 0 ]]
+    TS_ASSERT[[ copies == 0 ]] --estranho
+    TS_ASSERT[[ moves == 0 ]]
 
     return true
 end
 
+
+function testInvoke()
+
+    TS_ASSERT[[ Function.invoke("FunctionTest::Arity::sum", 5) == 5 ]]
+    TS_ASSERT[[ Function.invoke("FunctionTest::Arity::sum", 5, 6) == 11 ]]
+    TS_ASSERT[[ Function.invoke("FunctionTest::Arity::sum", 5, 6, 7) == 18 ]]
+
+    TS_ASSERT[[ not pcall(Function.invoke, "FunctionTest::Arity::sum") ]]
+    TS_ASSERT[[ not pcall(Function.invoke, "FunctionTest::globalFunction", 1, 2) ]]
+
+    local arity = Function.lookupNamespace("FunctionTest::Arity")
+    TS_ASSERT[[ #arity == 3 ]]
+    TS_ASSERT[[ #Function.lookupNamespace("NoSuchNamespace") == 0 ]]
+
+    return true
+end
+
+function testContainers()
+
+    TS_ASSERT[[ Function.invoke("ContainerTest::total", {1, 2, 3, 4}) == 10 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::total", {}) == 0 ]]
+
+    local v = Function.invoke("ContainerTest::iota", 5)
+    TS_ASSERT[[ type(v) == "table" ]]
+    TS_ASSERT[[ #v == 5 ]]
+    TS_ASSERT[[ v[1] == 1 and v[5] == 5 ]]
+
+    local counts = Function.invoke("ContainerTest::count", {"a", "b", "a"})
+    TS_ASSERT[[ type(counts) == "table" ]]
+    TS_ASSERT[[ counts.a == 2 ]]
+    TS_ASSERT[[ counts.b == 1 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::countOf", {x = 3, y = 4}, "y") == 4 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::countOf", counts, "c") == 0 ]]
+
+    local m = Function.invoke("ContainerTest::identity", 3)
+    TS_ASSERT[[ #m == 3 and #m[1] == 3 ]]
+    TS_ASSERT[[ m[2][2] == 1 and m[2][3] == 0 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::trace", m) == 3 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::trace", {{1, 2}, {3, 4}}) == 5 ]]
+
+    TS_ASSERT[[ not pcall(Function.invoke, "ContainerTest::total", {1, {2}}) ]]
+    TS_ASSERT[[ not pcall(Function.invoke, "ContainerTest::total", 1) ]]
+
+    return true
+end
+
+function testObjectFromTable()
+
+    TS_ASSERT[[ Function.invoke("ContainerTest::manhattan", {x = 3, y = -4}) == 7 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::manhattan", {x = 3}) == 3 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::length", {from = {x = 1, y = 1}, to = {x = 4, y = 5}}) == 7 ]]
+
+    TS_ASSERT[[ not pcall(Function.invoke, "ContainerTest::manhattan", {z = 1}) ]]
+    TS_ASSERT[[ not pcall(Function.invoke, "ContainerTest::manhattan", {1, 2}) ]]
+    TS_ASSERT[[ not pcall(Function.invoke, "ContainerTest::manhattan", {x = {1}}) ]]
+
+    -- attributes holding containers are converted too
+    TS_ASSERT[[ Function.invoke("ContainerTest::pathLength", {points = {{x = 1}, {x = 4}, {x = 4, y = 2}}}) == 5 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::pathLength", {points = {}, name = "empty"}) == 0 ]]
+
+    -- reflected objects inside containers come back as tables of their attributes
+    local e = Function.invoke("ContainerTest::ends", {from = {x = 1, y = 2}, to = {x = 3, y = 4}})
+    TS_ASSERT[[ #e == 2 ]]
+    TS_ASSERT[[ type(e[1]) == "table" ]]
+    TS_ASSERT[[ e[1].x == 1 and e[1].y == 2 and e[2].x == 3 and e[2].y == 4 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::pathLength", {points = e}) == 4 ]]
+
+    local h = Function.invoke("ContainerTest::halves", {to = {x = 4, y = 2}})
+    TS_ASSERT[[ #h == 2 ]]
+    TS_ASSERT[[ h[1].from.x == 0 and h[1].to.x == 2 and h[1].to.y == 1 ]]
+    TS_ASSERT[[ h[2].from.x == 2 and h[2].to.x == 4 ]]
+    TS_ASSERT[[ Function.invoke("ContainerTest::length", h[2]) == 3 ]]
+
+    return true
+end
+
+function testStrings()
+
+    TS_ASSERT[[ Function.invoke("StringTest::length", "a\0b") == 3 ]]
+    TS_ASSERT[[ Function.invoke("StringTest::length", "") == 0 ]]
+    TS_ASSERT[[ Function.invoke("StringTest::length", 123) == 3 ]]
+    TS_ASSERT[[ Function.invoke("StringTest::countLines", string.rep("line\n", 1000)) == 1000 ]]
+
+    TS_ASSERT[[ Function.invoke("StringTest::field", "a,bc,d", 1) == "bc" ]]
+    TS_ASSERT[[ Function.invoke("StringTest::field", "a,bc,d", 2) == "d" ]]
+    TS_ASSERT[[ Function.invoke("StringTest::field", "a,bc,d", 3) == "" ]]
+
+    local r = Function.invoke("StringTest::repeat", "x\0y", 3)
+    TS_ASSERT[[ r == "x\0yx\0yx\0y" ]]
+    TS_ASSERT[[ #r == 9 ]]
+
+    return true
+end
+
+function testAsync()
+
+    -- outside of a coroutine the calls wait for the value
+    TS_ASSERT[[ Function.invoke("AsyncTest::ready", "now") == "now" ]]
+    TS_ASSERT[[ Function.invoke("AsyncTest::later", 7, 1) == 7 ]]
+    TS_ASSERT[[ not pcall(Function.invoke, "AsyncTest::later", -1, 1) ]]
+
+    -- only 5.2 and later can continue a call after a yield
+    if _VERSION == "Lua 5.1" then
+        return true
+    end
+
+    local ticker = Class.lookup("AsyncTest::Ticker"):construct()
+
+    -- every task waits on its own future, all on this thread
+    local done, sum = 0, 0
+    for i = 1, 1000 do
+        Future.spawn(function()
+            local v = ticker:next(i)
+            sum = sum + v
+            done = done + 1
+        end)
+    end
+    TS_ASSERT[[ done == 0 ]]
+    TS_ASSERT[[ ticker:pending() == 1000 ]]
+    TS_ASSERT[[ ticker:fire() == 1000 ]]
+    Future.run()
+    TS_ASSERT[[ done == 1000 ]]
+    TS_ASSERT[[ sum == 500500 ]]
+
+    -- values computed by other threads, errors are raised in the task
+    local total, failed = 0, false
+    local function add(x, ms)
+        local v = Function.invoke("AsyncTest::later", x, ms)
+        total = total + v
+    end
+    Future.spawn(add, 3, 20)
+    Future.spawn(add, 4, 1)
+    Future.spawn(function()
+        local ok, err = pcall(Function.invoke, "AsyncTest::later", -1, 1)
+        failed = not ok and err:find("negative value") ~= nil
+    end)
+    Future.spawn(function() total = total + #Function.invoke("AsyncTest::ready", "abc") end)
+    TS_ASSERT[[ total == 3 ]]
+    Future.run()
+    TS_ASSERT[[ total == 10 ]]
+    TS_ASSERT(failed)
+
+    -- an error ends the run, the other tasks are still there for the next one
+    local finished = 0
+    Future.spawn(function() Function.invoke("AsyncTest::later", 1, 1); error("task failed") end)
+    Future.spawn(function() add(5, 30); finished = finished + 1 end)
+    Future.spawn(function() add(6, 30); finished = finished + 1 end)
+    local ok, err = pcall(Future.run)
+    TS_ASSERT[[ not ok and err:find("task failed") ~= nil ]]
+    Future.run()
+    TS_ASSERT[[ finished == 2 and total == 21 ]]
+
+    -- coroutines driven by hand get the Future
+    local co = coroutine.create(function() return ticker:next(5) + 1 end)
+    local ok, f = coroutine.resume(co)
+    TS_ASSERT[[ ok and not f:ready() ]]
+    TS_ASSERT[[ not f:wait(0.001) ]]
+    ticker:fire()
+    TS_ASSERT[[ f:wait() ]]
+    local ok, v = coroutine.resume(co)
+    TS_ASSERT[[ ok and v == 6 ]]
+
+    TS_ASSERT[[ not pcall(Future.spawn, function() coroutine.yield(1) end) ]]
+
+    return true
+end
+
+function testFFI()
+
+    local function ffi(name)
+        return Function.lookup(name):ffi()
+    end
+
+    -- only LuaJIT has the FFI
+    if not jit then
+        TS_ASSERT[[ ffi("NativeTest::name") == nil ]]
+        return true
+    end
+
+    -- results are Lua values, not cdata
+    local negative, twice = ffi("NativeTest::negative"), ffi("NativeTest::twice")
+    TS_ASSERT[[ negative(5) == -5 and type(negative(5)) == "number" ]]
+    TS_ASSERT[[ twice(21) == 42 and type(twice(21)) == "number" ]]
+
+    local big, bigUnsigned = ffi("NativeTest::big"), ffi("NativeTest::bigUnsigned")
+    TS_ASSERT[[ big(1) == 2^40 + 1 and type(big(1)) == "number" ]]
+    TS_ASSERT[[ bigUnsigned(1) == 2^52 + 1 and type(bigUnsigned(1)) == "number" ]]
+
+    local name = ffi("NativeTest::name")
+    TS_ASSERT[[ name(1) == "one" ]]
+    TS_ASSERT[[ name(2) == nil ]]
+
+    -- the same values as without the FFI
+    for i = 0, 2 do
+        TS_ASSERT(big(i) == Function.invoke("NativeTest::big", i))
+        TS_ASSERT(bigUnsigned(i) == Function.invoke("NativeTest::bigUnsigned", i))
+    end
+    TS_ASSERT[[ name(0) == tostring(Function.invoke("NativeTest::name", 0)) ]]
+
+    return true
+end
@@ -0,0 +1,252 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#include "metadata_file_test.h"
+#include "metadata_file.h"
+#include "reflection_impl.h"
+#include "test_utils.h"
+#include "str_utils.h"
+
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+namespace {
+
+	// what selfportraitc --binary-metadata writes for
+	//
+	//   namespace MetadataTest {
+	//       class Base { public: int method1(double, int) const; };
+	//       class Derived: public Base, public Other {
+	//       public:
+	//           Derived();
+	//           static void method2();
+	//           std::string attribute1;
+	//       };
+	//       int function1(); int function1(int);
+	//   }
+	class Builder {
+	public:
+		Builder() {
+			str("");
+		}
+
+		vector<char> build() {
+			const uint32_t base = str("MetadataTest::Base"), derived = str("MetadataTest::Derived");
+
+			classes.push_back({ base, 0, 0, 1, 0, 0, 0, 0, 0, 0 });
+			classes.push_back({ derived, 0, 1, 1, 0, 1, 0, 1, 0, 2 });
+			functions.push_back({ str("MetadataTest::function1"), str("int"), 0, 0 });
+			functions.push_back({ str("MetadataTest::function1"), str("int"), args({ "int" }), 1 });
+			methods.push_back({ str("method1"), str("int"), args({ "double", "int" }), 2, MethodRecord::Const });
+			methods.push_back({ str("method2"), str("void"), 0, 0, MethodRecord::Static });
+			attributes.push_back({ str("attribute1"), str("std::string") });
+			constructors.push_back({ 0, 0 });
+			bases.push_back({ base, 0 });
+			bases.push_back({ str("Other"), noClassIndex });
+			strings.resize((strings.size() + 3) & ~size_t(3), '\0');
+
+			MetadataHeader header;
+			memcpy(header.magic, metadataMagic, sizeof(metadataMagic));
+			header.version = metadataVersion;
+			header.numClasses = classes.size();
+			header.numFunctions = functions.size();
+			header.numMethods = methods.size();
+			header.numAttributes = attributes.size();
+			header.numConstructors = constructors.size();
+			header.numBases = bases.size();
+			header.numArguments = arguments.size();
+			header.stringsSize = strings.size();
+
+			vector<char> ret;
+			append(ret, &header, 1);
+			append(ret, classes.data(), classes.size());
+			append(ret, functions.data(), functions.size());
+			append(ret, methods.data(), methods.size());
+			append(ret, attributes.data(), attributes.size());
+			append(ret, constructors.data(), constructors.size());
+			append(ret, bases.data(), bases.size());
+			append(ret, arguments.data(), arguments.size());
+			ret.insert(ret.end(), strings.begin(), strings.end());
+			return ret;
+		}
+
+	private:
+		uint32_t str(const string& s) {
+			const uint32_t ret = strings.size();
+			strings.append(s.c_str(), s.size() + 1);
+			return ret;
+		}
+
+		uint32_t args(const vector<string>& spellings) {
+			const uint32_t ret = arguments.size();
+			for (const string& s: spellings) {
+				arguments.push_back(str(s));
+			}
+			return ret;
+		}
+
+		template<class T>
+		void append(vector<char>& v, const T* t, size_t n) {
+			const char* p = reinterpret_cast<const char*>(t);
+			v.insert(v.end(), p, p + n * sizeof(T));
+		}
+
+		string strings;
+		vector<ClassRecord> classes;
+		vector<FunctionRecord> functions;
+		vector<MethodRecord> methods;
+		vector<AttributeRecord> attributes;
+		vector<ConstructorRecord> constructors;
+		vector<BaseRecord> bases;
+		vector<uint32_t> arguments;
+	};
+
+	// vector<char> storage is suitably aligned for the records
+	vector<char> sample() {
+		return Builder().build();
+	}
+
+	string output_file(const string& name) {
+        return strconv::fmt_str("%1/%2", binpath(), name);
+	}
+}
+
+void MetadataFileTestSuite::testClasses()
+{
+	vector<char> data = sample();
+	MetadataFile file(data.data(), data.size());
+
+	TS_ASSERT_EQUALS(file.numClasses(), 2u);
+	TS_ASSERT(!file.findClass("MetadataTest::Other").isValid());
+	TS_ASSERT(!file.findClass("").isValid());
+	TS_ASSERT_THROWS(file.findClass("Other").fullyQualifiedName(), std::runtime_error);
+
+	MetadataFile::ClassEntry derived = file.findClass("MetadataTest::Derived");
+	TS_ASSERT(derived.isValid());
+	TS_ASSERT_EQUALS(string(derived.fullyQualifiedName()), "MetadataTest::Derived");
+	TS_ASSERT(!derived.isInterface());
+
+	TS_ASSERT_EQUALS(derived.numMethods(), 1u);
+	TS_ASSERT_EQUALS(string(derived.method(0).name()), "method2");
+	TS_ASSERT(derived.method(0).isStatic());
+	TS_ASSERT_THROWS(derived.method(1), std::runtime_error);
+
+	TS_ASSERT_EQUALS(derived.numAttributes(), 1u);
+	TS_ASSERT_EQUALS(string(derived.attribute(0).typeSpelling()), "std::string");
+	TS_ASSERT_EQUALS(derived.numConstructors(), 1u);
+	TS_ASSERT_EQUALS(derived.constructor(0).numberOfArguments(), 0u);
+
+	TS_ASSERT_EQUALS(derived.numSuperclasses(), 2u);
+	TS_ASSERT_EQUALS(string(derived.superclassName(1)), "Other");
+	TS_ASSERT(!derived.superclass(1).isValid());
+
+	MetadataFile::ClassEntry base = derived.superclass(0);
+	TS_ASSERT(base.isValid());
+	TS_ASSERT_EQUALS(string(base.fullyQualifiedName()), "MetadataTest::Base");
+	MetadataFile::MethodEntry method1 = base.method(0);
+	TS_ASSERT_EQUALS(string(method1.returnSpelling()), "int");
+	TS_ASSERT_EQUALS(string(method1.argumentSpelling(0)), "double");
+	TS_ASSERT_EQUALS(string(method1.argumentSpelling(1)), "int");
+	TS_ASSERT_THROWS(method1.argumentSpelling(2), std::runtime_error);
+	TS_ASSERT_EQUALS(method1.numberOfArguments(), 2u);
+	TS_ASSERT(method1.isConst());
+	TS_ASSERT(!method1.isVolatile());
+	TS_ASSERT(!method1.isStatic());
+}
+
+void MetadataFileTestSuite::testFunctions()
+{
+	vector<char> data = sample();
+	MetadataFile file(data.data(), data.size());
+
+	auto range = file.findFunctions("MetadataTest::function1");
+	TS_ASSERT_EQUALS(range.second - range.first, 2u);
+	TS_ASSERT_EQUALS(file.functionAt(range.first).numberOfArguments(), 0u);
+	TS_ASSERT_EQUALS(string(file.functionAt(range.first + 1).argumentSpelling(0)), "int");
+
+	range = file.findFunctions("MetadataTest::function2");
+	TS_ASSERT_EQUALS(range.first, range.second);
+}
+
+void MetadataFileTestSuite::testMapping()
+{
+	vector<char> data = sample();
+	const string path = output_file("metadata_test.meta");
+	{
+		ofstream out(path, ios::binary);
+		out.write(data.data(), data.size());
+	}
+
+	MetadataFile file(path);
+	TS_ASSERT(file.findClass("MetadataTest::Base").isValid());
+
+	TS_ASSERT_THROWS(MetadataFile(output_file("no_such_file.meta")), std::runtime_error);
+}
+
+void MetadataFileTestSuite::testMalformed()
+{
+	vector<char> data = sample();
+
+	TS_ASSERT_THROWS(MetadataFile(data.data(), data.size() - 4), std::runtime_error);
+	TS_ASSERT_THROWS(MetadataFile(data.data(), 4), std::runtime_error);
+
+	vector<char> magic = data;
+	magic[0] = 'X';
+	TS_ASSERT_THROWS(MetadataFile(magic.data(), magic.size()), std::runtime_error);
+
+	vector<char> version = data;
+	reinterpret_cast<MetadataHeader*>(version.data())->version = metadataVersion + 1;
+	TS_ASSERT_THROWS(MetadataFile(version.data(), version.size()), std::runtime_error);
+
+	// records are checked when they are read, not when the file is opened
+
+	// a method name pointing past the strings
+	vector<char> offset = data;
+	const MetadataHeader& h = *reinterpret_cast<const MetadataHeader*>(data.data());
+	MethodRecord* methods = reinterpret_cast<MethodRecord*>(offset.data() + sizeof(MetadataHeader) + h.numClasses * sizeof(ClassRecord) + h.numFunctions * sizeof(FunctionRecord));
+	methods[0].name = h.stringsSize;
+	MetadataFile offsetFile(offset.data(), offset.size());
+	TS_ASSERT_THROWS(offsetFile.findClass("MetadataTest::Base").method(0).name(), std::runtime_error);
+	TS_ASSERT_EQUALS(string(offsetFile.findClass("MetadataTest::Base").method(0).returnSpelling()), "int");
+
+	// more methods than there are
+	vector<char> range = data;
+	ClassRecord* classes = reinterpret_cast<ClassRecord*>(range.data() + sizeof(MetadataHeader));
+	classes[1].numMethods = 5;
+	MetadataFile rangeFile(range.data(), range.size());
+	MetadataFile::ClassEntry derived = rangeFile.findClass("MetadataTest::Derived");
+	TS_ASSERT_EQUALS(string(derived.method(0).name()), "method2");
+	TS_ASSERT_THROWS(derived.method(1), std::runtime_error);
+
+	// arguments past the arguments section
+	vector<char> arguments = data;
+	methods = reinterpret_cast<MethodRecord*>(arguments.data() + sizeof(MetadataHeader) + h.numClasses * sizeof(ClassRecord) + h.numFunctions * sizeof(FunctionRecord));
+	methods[0].firstArgument = h.numArguments;
+	MetadataFile argumentsFile(arguments.data(), arguments.size());
+	TS_ASSERT_THROWS(argumentsFile.findClass("MetadataTest::Base").method(0).argumentSpelling(0), std::runtime_error);
+}
+
+void MetadataFileTestSuite::testRegistryDeclaration()
+{
+	vector<char> data = sample();
+	const string path = output_file("metadata_registry_test.meta");
+	{
+		ofstream out(path, ios::binary);
+		out.write(data.data(), data.size());
+	}
+
+	// the classes are known without being reflected in this binary
+	TS_ASSERT(!Class::lookup("MetadataTest::Derived").isValid());
+	TS_ASSERT(!ClassRegistry::instance().declaration("MetadataTest::Derived").isValid());
+
+	ClassRegistry::instance().addMetadata(std::make_shared<MetadataFile>(path));
+
+	MetadataFile::ClassEntry derived = ClassRegistry::instance().declaration("MetadataTest::Derived");
+	TS_ASSERT(derived.isValid());
+	TS_ASSERT_EQUALS(derived.numSuperclasses(), 2u);
+	TS_ASSERT(!ClassRegistry::instance().declaration("MetadataTest::Other").isValid());
+}
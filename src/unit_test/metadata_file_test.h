@@ -0,0 +1,23 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef METADATA_FILE_TEST_H
+#define METADATA_FILE_TEST_H
+
+#include <cxxtest/TestSuite.h>
+
+class MetadataFileTestSuite : public CxxTest::TestSuite
+{
+public:
+
+	// test methods must begin with "test", otherwise cxxtestgen ignores them
+	void testClasses();
+	void testFunctions();
+	void testMapping();
+	void testMalformed();
+	void testRegistryDeclaration();
+};
+
+
+#endif /* METADATA_FILE_TEST_H */
@@ -12,8 +12,11 @@
 
 #include <lua.hpp>
 
+#include <atomic>
 #include <iostream>
 #include <string>
+#include <thread>
+#include <vector>
 using namespace std;
 
 namespace MethodTest {
@@ -29,6 +32,9 @@ namespace MethodTest {
 
 	class Test2 {};
 
+	// registered with a method table instead of one REFL_METHOD each
+	class Table1: public Test1 {};
+
 
 	class Base {
 	public:
@@ -172,6 +178,19 @@ REFL_BEGIN_CLASS(MethodTest::Test2)
 REFL_END_CLASS
 
 
+REFL_BEGIN_CLASS(MethodTest::Table1)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_BEGIN_METHOD_TABLE
+	REFL_METHOD_ROW(method1, int, int)
+	REFL_CONST_METHOD_ROW(method2, int, int)
+	REFL_VOLATILE_METHOD_ROW(method3, int, int)
+	REFL_CONST_VOLATILE_METHOD_ROW(method4, int, int)
+	REFL_CONST_VOLATILE_METHOD_ROW(method4, int, int, int)
+	REFL_STATIC_METHOD_ROW(method5, int, int)
+	REFL_END_METHOD_TABLE
+REFL_END_CLASS
+
+
 REFL_BEGIN_CLASS(MethodTest::Base)
 	REFL_DEFAULT_CONSTRUCTOR()
 	REFL_METHOD(method1, int)
@@ -364,6 +383,111 @@ void MethodTestSuite::testLuaAPI()
 	LuaUtils::callFunc<bool>(L, "testMethod");
 }
 
+void MethodTestSuite::testLuaClassMetatable()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/method_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testClassMetatable");
+}
+
+void MethodTestSuite::testLuaParallelStates()
+{
+	const int numStates = 64;
+	std::atomic<int> passed(0);
+	std::vector<std::thread> threads;
+
+	// each thread opens its own state, they share the class metadata
+	for (int id = 0; id < numStates; ++id) {
+		threads.emplace_back([id, &passed]() {
+			try {
+				LuaUtils::LuaStateHolder L;
+				LuaUtils::addTestFunctionsAndPaths(&*L);
+
+				if (luaL_loadfile(L, strconv::fmt_str("%1/method_test.lua", srcpath()).c_str()) || lua_pcall(L, 0, 0, 0)) {
+					return;
+				}
+				lua_getglobal(L, "parallelState");
+				lua_pushinteger(L, id);
+				if (lua_pcall(L, 1, 1, 0) == 0 && lua_tointeger(L, -1) == 300*id + 40400) {
+					++passed;
+				}
+			} catch (...) {
+			}
+		});
+	}
+	for (std::thread& t: threads) {
+		t.join();
+	}
+
+	TS_ASSERT_EQUALS(passed.load(), numStates);
+}
+
+void MethodTestSuite::testNativeEntry()
+{
+	Class test = Class::lookup("MethodTest::Test1");
+
+	Method method1 = test.findMethod([](const Method& m){ return m.name() == "method1";});
+	const NativeEntry* e1 = method1.nativeEntry();
+	TS_ASSERT(e1 != nullptr);
+	TS_ASSERT_EQUALS(std::string(e1->declaration()), "int (*)(char*, void*, int)");
+
+	typedef int (*Method1)(char*, void*, int);
+	Method1 f1 = reinterpret_cast<Method1>(e1->function);
+
+	char error[nativeErrorSize] = "";
+	VariantValue obj;
+	obj.construct<MethodTest::Test1>();
+	TS_ASSERT_EQUALS(f1(error, &obj, 3), 6);
+	TS_ASSERT_EQUALS(error[0], '\0');
+
+	// exceptions do not leave the entry
+	VariantValue wrong(3);
+	TS_ASSERT_EQUALS(f1(error, &wrong, 3), 0);
+	TS_ASSERT_DIFFERS(error[0], '\0');
+
+	error[0] = '\0';
+	TS_ASSERT_EQUALS(f1(error, nullptr, 3), 0);
+	TS_ASSERT_DIFFERS(error[0], '\0');
+
+	Method method5 = test.findMethod([](const Method& m){ return m.name() == "method5";});
+	const NativeEntry* e5 = method5.nativeEntry();
+	TS_ASSERT(e5 != nullptr);
+	TS_ASSERT_EQUALS(std::string(e5->declaration()), "int (*)(char*, int)");
+
+	typedef int (*Method5)(char*, int);
+	error[0] = '\0';
+	TS_ASSERT_EQUALS(reinterpret_cast<Method5>(e5->function)(error, 3), 18);
+	TS_ASSERT_EQUALS(error[0], '\0');
+
+	// references and objects have no native entry
+	Class factory = Class::lookup("MethodTest::LoggerFactory");
+	Method getLogger = factory.findMethod([](const Method& m){ return m.name() == "getLogger";});
+	TS_ASSERT(getLogger.nativeEntry() == nullptr);
+}
+
+void MethodTestSuite::testLuaFFI()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/method_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+#ifdef LUA_FFI
+	lua_pushboolean(L, 1);
+	lua_setglobal(L, "ffiMetatables");
+#endif
+	LuaUtils::callFunc<bool>(L, "testFFI");
+}
+
 
 void MethodTestSuite::testMethodHash()
 {
@@ -385,6 +509,62 @@ void MethodTestSuite::testMethodHash()
 	TS_ASSERT_EQUALS(mmap[m3], 3);
 }
 
+void MethodTestSuite::testMethodTable()
+{
+	Class table = Class::lookup("MethodTest::Table1");
+	TS_ASSERT_EQUALS(table.methods().size(), 6u);
+
+	auto find = [&](const string& name, size_t numArgs) -> Method {
+		auto found = table.findAllMethods([&](const Method& m) { return m.name() == name && m.numberOfArguments() == numArgs; });
+		TS_ASSERT_EQUALS(found.size(), 1u);
+		return found.front();
+	};
+
+	VariantValue v = Table1();
+	const VariantValue cv = Table1();
+	volatile VariantValue vv = Table1();
+
+	TS_ASSERT_EQUALS(find("method1", 1).call(v, 3).value<int>(), 6);
+	TS_ASSERT_THROWS(find("method1", 1).call(cv, 3), std::runtime_error);
+	TS_ASSERT_EQUALS(find("method2", 1).call(cv, 3).value<int>(), 9);
+	TS_ASSERT_EQUALS(find("method3", 1).call(vv, 3).value<int>(), 12);
+	TS_ASSERT_EQUALS(find("method4", 1).call(cv, 3).value<int>(), 15);
+	TS_ASSERT_EQUALS(find("method4", 2).call(v, 3, 4).value<int>(), 19);
+	TS_ASSERT_EQUALS(find("method5", 1).call(3).value<int>(), 18);
+
+	Method m2 = find("method2", 1);
+	TS_ASSERT(m2.isConst());
+	TS_ASSERT(!m2.isVolatile());
+	TS_ASSERT(!m2.isStatic());
+	TS_ASSERT(find("method5", 1).isStatic());
+	TS_ASSERT_EQUALS(m2.returnSpelling(), "int");
+	TS_ASSERT_EQUALS(m2.argumentSpellings().size(), 1u);
+	TS_ASSERT(m2.returnType() == typeid(int));
+	TS_ASSERT(m2.argumentTypes()[0] == &typeid(int));
+	TS_ASSERT(m2.nativeEntry() == nullptr);
+
+	// rows share their invoker but still hash apart
+	unordered_map<Method, int> mmap;
+	int i = 0;
+	for (const Method& m: table.methods()) {
+		mmap[m] = i++;
+	}
+	TS_ASSERT_EQUALS(mmap.size(), 6u);
+}
+
+void MethodTestSuite::testLuaMethodTable()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/method_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testMethodTable");
+}
+
 void MethodTestSuite::testClassRef()
 {
 
@@ -19,7 +19,13 @@ public:
 	void testCVMethod();
 	void testStaticMethod();
 	void testLuaAPI();
+	void testLuaClassMetatable();
+	void testLuaParallelStates();
+	void testNativeEntry();
+	void testLuaFFI();
 	void testMethodHash();
+	void testMethodTable();
+	void testLuaMethodTable();
 	void testClassRef();
 	void testFullName();
 	void testMethodOverriding();
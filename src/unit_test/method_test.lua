@@ -24,13 +24,13 @@ function testMethod()
 
     TS_ASSERT(v1)
 
-    TS_ASSERT[[ method1:call(v1, 3):tonumber() == 6 ]]
-    TS_ASSERT[[ method1(v1, 3):tonumber() == 6 ]]
+    TS_ASSERT[[ method1:call(v1, 3) == 6 ]]
+    TS_ASSERT[[ method1(v1, 3) == 6 ]]
 
-    TS_ASSERT[[ v1:method1(3):tonumber() == 6 ]]
+    TS_ASSERT[[ v1:method1(3) == 6 ]]
 
-    TS_ASSERT[[ v1:method4(3):tonumber() == 15 ]]
-    TS_ASSERT[[ v1:method4(3, 4):tonumber() == 19 ]]
+    TS_ASSERT[[ v1:method4(3) == 15 ]]
+    TS_ASSERT[[ v1:method4(3, 4) == 19 ]]
 
     local class = v1:class()
     TS_ASSERT(class)
@@ -40,7 +40,7 @@ function testMethod()
     local method5 = methods["method5(int)"]
     TS_ASSERT(method5)
 
-    TS_ASSERT[[ method5:call(3):tonumber() == 18 ]]
+    TS_ASSERT[[ method5:call(3) == 18 ]]
 
 
     local m1 = TestClass:findMethod(function(m) return m:name() == "method1" end)
@@ -79,3 +79,127 @@ function testMethod()
 
     return true
 end
+
+function testClassMetatable()
+
+    local TestClass = Class.lookup("MethodTest::Test1")
+    TS_ASSERT(TestClass)
+
+    local v1 = TestClass:construct()
+    local v2 = TestClass:construct()
+
+    -- all the instances of a class share the metatable and the method closures
+    TS_ASSERT[[ getmetatable(v1) == getmetatable(v2) ]]
+    TS_ASSERT[[ getmetatable(v1) ~= getmetatable(Variant.new(1)) ]]
+    TS_ASSERT[[ v1.method1 == v2.method1 ]]
+
+    TS_ASSERT[[ v1:method1(3) == 6 ]]
+    TS_ASSERT[[ v2:method2(3) == 9 ]]
+    TS_ASSERT[[ v1:method4(3) == 15 ]]
+    TS_ASSERT[[ v1:method4(3, 4) == 19 ]]
+    TS_ASSERT[[ v1:class():fullyQualifiedName() == "MethodTest::Test1" ]]
+
+    -- still variants for the rest of the api
+    TS_ASSERT[[ Variant.new(v1):isValid() ]]
+
+    TS_ASSERT[[ not pcall(function() return v1.method99 end) ]]
+    TS_ASSERT[[ not pcall(function() return v1:method4(1, 2, 3) end) ]]
+    TS_ASSERT[[ not pcall(function() return v1:method5(1) end) ]]
+
+    return true
+end
+
+function testMethodTable()
+
+    local Table1 = Class.lookup("MethodTest::Table1")
+    TS_ASSERT(Table1)
+
+    local v = Table1:construct()
+
+    TS_ASSERT[[ v:method1(3) == 6 ]]
+    TS_ASSERT[[ v:method2(3) == 9 ]]
+    TS_ASSERT[[ v:method4(3) == 15 ]]
+    TS_ASSERT[[ v:method4(3, 4) == 19 ]]
+
+    local m5 = Table1:findMethod(function(m) return m:name() == "method5" end)
+    TS_ASSERT[[ m5:call(3) == 18 ]]
+    TS_ASSERT[[ not pcall(function() return v:method4(1, 2, 3) end) ]]
+
+    return true
+end
+
+-- called concurrently from many threads, each one with its own state,
+-- so the result is checked in C++ instead of with TS_ASSERT
+function parallelState(id)
+
+    local TestClass = Class.lookup("MethodTest::Test1")
+    local v = TestClass:construct()
+
+    local sum = 0
+    for i = 1, 100 do
+        sum = sum + v:method1(id) + v:method2(i) + v:method4(i) + v:method4(0, id)
+    end
+    return sum
+end
+
+function testFFI()
+
+    local TestClass = Class.lookup("MethodTest::Test1")
+    TS_ASSERT(TestClass)
+
+    local methods = {}
+    for _, v in ipairs(TestClass:methods()) do
+        methods[v:name()..'('..table.concat(v:argumentSpellings(), ',')..')'] = v
+    end
+
+    local method1 = methods["method1(int)"]:ffi()
+    local method5 = methods["method5(int)"]:ffi()
+
+    -- only LuaJIT has the FFI
+    if not jit then
+        TS_ASSERT[[ method1 == nil ]]
+        return true
+    end
+
+    local v1 = TestClass:construct()
+
+    -- with SELFPORTRAIT_LUA_FFI the class metatable has the FFI wrapper
+    if ffiMetatables then
+        TS_ASSERT[[ debug.getinfo(v1.method1, "S").what == "Lua" ]]
+    else
+        TS_ASSERT[[ debug.getinfo(v1.method1, "S").what == "C" ]]
+    end
+
+    TS_ASSERT(method1)
+    TS_ASSERT[[ method1(v1, 3) == 6 ]]
+    TS_ASSERT[[ method5(3) == 18 ]]
+
+    -- errors are raised in Lua, anything but a variant is rejected before the call
+    local ok, message = pcall(method1, Variant.new(1), 3)
+    TS_ASSERT[[ not ok and type(message) == 'string' ]]
+    TS_ASSERT[[ not pcall(method1, nil, 3) ]]
+    TS_ASSERT[[ not pcall(method1, io.stdout, 3) ]]
+    TS_ASSERT[[ not pcall(method1, {}, 3) ]]
+    TS_ASSERT[[ method1(v1, 3) == 6 ]]
+
+    local sum = 0
+    for i = 1, 1000 do
+        sum = sum + method1(v1, i)
+    end
+    TS_ASSERT[[ sum == 1001000 ]]
+
+    -- also once the JIT compiled the calls, and through the class metatable
+    local wrong = Variant.new(1)
+    local failed = 0
+    for i = 1, 1000 do
+        if not pcall(method1, wrong, i) then
+            failed = failed + 1
+        end
+    end
+    TS_ASSERT[[ failed == 1000 ]]
+    TS_ASSERT[[ v1:method1(3) == 6 ]]
+    TS_ASSERT[[ not pcall(v1.method1, wrong, 3) ]]
+    TS_ASSERT[[ not pcall(v1.method1, {}, 3) ]]
+
+    return true
+end
@@ -5,11 +5,18 @@
 #include "parser_test.h"
 
 #include <stdlib.h>
+#include <sys/stat.h>
+#include <utime.h>
 
+#include "manifest.h"
+#include "metadata_file.h"
+#include "parser.h"
 #include "test_utils.h"
 
+#include <algorithm>
 #include <fstream>
 #include <iostream>
+#include <set>
 using namespace std;
 
 namespace {
@@ -26,17 +33,31 @@ namespace {
         return strconv::fmt_str("%1/parser_test_data/%2", binpath(), name);
 	}
 
-	string parser() {
+	string parser_binary() {
         return strconv::fmt_str("%1/../parser/selfportraitc", binpath());
 	}
 
+	int count_lines(const string& file, const string& prefix)
+	{
+		ifstream in(file);
+		TS_ASSERT(in.is_open());
+		int count = 0;
+		string line;
+		while (getline(in, line)) {
+			if (line.compare(0, prefix.size(), prefix) == 0) {
+				++count;
+			}
+		}
+		return count;
+	}
+
 	void runtest(const string& inputName, const string& referenceName, const string& outputName)
 	{
 		string source_file = input_file(inputName);
 		string expected_output = exp_output_file(referenceName);
 		string output = output_file(outputName);
 
-        auto parser_cmd = strconv::fmt_str("%1 %2 -o %3", parser(), source_file, output);
+        auto parser_cmd = strconv::fmt_str("%1 %2 -o %3", parser_binary(), source_file, output);
         if (system(parser_cmd.c_str()) != 0) {
 			std::cerr << "parser command may have failed" << std::endl;
             std::cerr << "(" << parser_cmd << ")"<< std::endl;
@@ -110,3 +131,267 @@ void ParserTestSuite::testTemplates()
 	runtest("templates.h", "templates.cpp", "templates.cpp");
 }
 
+
+void ParserTestSuite::testIncremental()
+{
+	string output = output_file("incremental_out.cpp");
+	string manifest = output_file("incremental_manifest.txt");
+	remove(manifest.c_str());
+
+	auto parser_cmd = strconv::fmt_str("%1 %2 -o %3 --manifest=%4", parser_binary(), input_file("simple_class.h"), output, manifest);
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	// backdate the output, an up to date run must not touch it
+	struct utimbuf times = { 1000, 1000 };
+	TS_ASSERT_EQUALS(utime(output.c_str(), &times), 0);
+
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	struct stat st;
+	TS_ASSERT_EQUALS(stat(output.c_str(), &st), 0);
+	TS_ASSERT_EQUALS(st.st_mtime, 1000);
+
+	// different flags regenerate, but the same contents leave the file alone
+	auto other_cmd = strconv::fmt_str("%1 -DUNUSED_MACRO", parser_cmd);
+	TS_ASSERT_EQUALS(system(other_cmd.c_str()), 0);
+	TS_ASSERT_EQUALS(stat(output.c_str(), &st), 0);
+	TS_ASSERT_EQUALS(st.st_mtime, 1000);
+
+	runtest("simple_class.h", "simple_class.cpp", "incremental_out.cpp");
+}
+
+
+void ParserTestSuite::testShards()
+{
+	auto parser_cmd = strconv::fmt_str("%1 %2 -o %3 --shards=2", parser_binary(), input_file("inheritance.h"), output_file("shards.cpp"));
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	// every class goes to exactly one shard
+	for (const char* prefix: { "REFL_BEGIN_CLASS", "REFL_FUNCTION" }) {
+		int expected = count_lines(exp_output_file("inheritance.cpp"), prefix);
+		TS_ASSERT_EQUALS(count_lines(output_file("shards_0.cpp"), prefix) + count_lines(output_file("shards_1.cpp"), prefix), expected);
+	}
+	TS_ASSERT_LESS_THAN(0, count_lines(output_file("shards_0.cpp"), "REFL_BEGIN_CLASS"));
+	TS_ASSERT_LESS_THAN(0, count_lines(output_file("shards_1.cpp"), "REFL_BEGIN_CLASS"));
+}
+
+void ParserTestSuite::testMethodTables()
+{
+	auto parser_cmd = strconv::fmt_str("%1 %2 -o %3 --method-tables", parser_binary(), input_file("simple_class.h"), output_file("method_tables.cpp"));
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	// the same methods, only as rows of the class tables
+	for (const char* prefix: { "REFL_METHOD", "REFL_CONST_METHOD", "REFL_VOLATILE_METHOD", "REFL_CONST_VOLATILE_METHOD", "REFL_STATIC_METHOD" }) {
+		const string classic = string(prefix) + "(";
+		TS_ASSERT_EQUALS(count_lines(output_file("method_tables.cpp"), string(prefix) + "_ROW("), count_lines(exp_output_file("simple_class.cpp"), classic));
+		TS_ASSERT_EQUALS(count_lines(output_file("method_tables.cpp"), classic), 0);
+	}
+	TS_ASSERT_LESS_THAN(0, count_lines(output_file("method_tables.cpp"), "REFL_BEGIN_METHOD_TABLE"));
+	TS_ASSERT_EQUALS(count_lines(output_file("method_tables.cpp"), "REFL_BEGIN_METHOD_TABLE"), count_lines(output_file("method_tables.cpp"), "REFL_END_METHOD_TABLE"));
+}
+
+void ParserTestSuite::testBinaryMetadata()
+{
+	auto parser_cmd = strconv::fmt_str("%1 %2 -o %3 --binary-metadata=%4", parser_binary(), input_file("inheritance.h"), output_file("binary.cpp"), output_file("binary.meta"));
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	MetadataFile file(output_file("binary.meta"));
+
+	// the same classes as the generated code
+	ifstream in(exp_output_file("inheritance.cpp"));
+	const string prefix = "REFL_BEGIN_CLASS(";
+	size_t numClasses = 0;
+	string line;
+	while (getline(in, line)) {
+		if (line.compare(0, prefix.size(), prefix) == 0) {
+			const string name = line.substr(prefix.size(), line.find(')') - prefix.size());
+			TS_ASSERT(file.findClass(name.c_str()).isValid());
+			++numClasses;
+		}
+	}
+	TS_ASSERT_EQUALS(file.numClasses(), numClasses);
+
+	size_t numMethods = 0;
+	for (size_t i = 0; i < file.numClasses(); ++i) {
+		MetadataFile::ClassEntry c = file.classAt(i);
+		numMethods += c.numMethods();
+		for (size_t j = 0; j < c.numSuperclasses(); ++j) {
+			TS_ASSERT(c.superclass(j).isValid());
+		}
+	}
+	size_t expectedMethods = 0;
+	for (const char* p: { "REFL_METHOD(", "REFL_CONST_METHOD(", "REFL_VOLATILE_METHOD(", "REFL_CONST_VOLATILE_METHOD(", "REFL_STATIC_METHOD(" }) {
+		expectedMethods += count_lines(exp_output_file("inheritance.cpp"), p);
+	}
+	TS_ASSERT_EQUALS(numMethods, expectedMethods);
+
+	// one spelling per argument, as in C++
+	parser_cmd = strconv::fmt_str("%1 %2 -o %3 --binary-metadata=%4", parser_binary(), input_file("templates.h"), output_file("templates_binary.cpp"), output_file("templates.meta"));
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	MetadataFile templates(output_file("templates.meta"));
+	auto range = templates.findFunctions("function1");
+	TS_ASSERT_EQUALS(range.second - range.first, 1u);
+	MetadataFile::FunctionEntry function1 = templates.functionAt(range.first);
+	TS_ASSERT_EQUALS(function1.numberOfArguments(), 1u);
+	TS_ASSERT_EQUALS(string(function1.argumentSpelling(0)), "Foo<char> *");
+	TS_ASSERT(templates.findClass("Foo<char *>").isValid());
+}
+
+void ParserTestSuite::testJsonLines()
+{
+	// streamed only, and along with the generated code
+	auto parser_cmd = strconv::fmt_str("%1 %2 --json=%3", parser_binary(), input_file("interfaces.h"), output_file("interfaces.json"));
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+	parser_cmd = strconv::fmt_str("%1 %2 -o %3 --json=%4", parser_binary(), input_file("interfaces.h"), output_file("interfaces_json.cpp"), output_file("interfaces_kept.json"));
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	ifstream streamed(output_file("interfaces.json"));
+	ifstream kept(output_file("interfaces_kept.json"));
+	TS_ASSERT(streamed.is_open());
+	TS_ASSERT(kept.is_open());
+
+	const set<string> interfaces = { "Interface1", "Interface2", "Interface3", "NS::Interface1" };
+	const string prefix = "{\"kind\":\"class\",\"name\":\"";
+	int numClasses = 0;
+	string line, other;
+	while (getline(streamed, line)) {
+		TS_ASSERT(getline(kept, other));
+		TS_ASSERT_EQUALS(line, other);
+
+		if (line.compare(0, prefix.size(), prefix) == 0) {
+			const string name = line.substr(prefix.size(), line.find('"', prefix.size()) - prefix.size());
+			const bool isInterface = interfaces.count(name) != 0;
+			TS_ASSERT_EQUALS(line.find("\"interface\":true") != string::npos, isInterface);
+			TS_ASSERT_EQUALS(line.find("\"diagnostics\":[]") != string::npos, isInterface);
+			++numClasses;
+		}
+		TS_ASSERT_EQUALS(line.back(), '}');
+	}
+	TS_ASSERT(!getline(kept, other));
+	TS_ASSERT_EQUALS(numClasses, count_lines(exp_output_file("interfaces.cpp"), "REFL_BEGIN_CLASS("));
+}
+
+void ParserTestSuite::testIncrementalJson()
+{
+	string output = output_file("incremental_json.cpp");
+	string json = output_file("incremental_json.json");
+	string manifest = output_file("incremental_json_manifest.txt");
+	remove(manifest.c_str());
+
+	auto parser_cmd = strconv::fmt_str("%1 %2 -o %3 --json=%4 --manifest=%5", parser_binary(), input_file("simple_class.h"), output, json, manifest);
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	// the JSON lines are part of the entry, an unchanged second run is skipped
+	struct utimbuf times = { 1000, 1000 };
+	TS_ASSERT_EQUALS(utime(output.c_str(), &times), 0);
+	TS_ASSERT_EQUALS(utime(json.c_str(), &times), 0);
+
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+
+	struct stat st;
+	TS_ASSERT_EQUALS(stat(output.c_str(), &st), 0);
+	TS_ASSERT_EQUALS(st.st_mtime, 1000);
+	TS_ASSERT_EQUALS(stat(json.c_str(), &st), 0);
+	TS_ASSERT_EQUALS(st.st_mtime, 1000);
+
+	// a modified JSON file is written again
+	ofstream(json.c_str()) << "modified\n";
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+	TS_ASSERT_LESS_THAN(0, count_lines(json, "{\"kind\":\"class\""));
+}
+
+void ParserTestSuite::testManifestDependencies()
+{
+	string output = output_file("manifest_deps.cpp");
+	string manifest = output_file("manifest_deps.txt");
+	remove(manifest.c_str());
+
+	// a relative input is recorded with its absolute path, wherever the parser ran
+	auto parser_cmd = strconv::fmt_str("cd %1 && %2 simple_class.h -o %3 --manifest=%4", input_file(""), parser_binary(), output, manifest);
+	TS_ASSERT_EQUALS(system(parser_cmd.c_str()), 0);
+	bool found = false;
+	ifstream in(manifest);
+	string line;
+	getline(in, line);
+	const string suffix = " " + input_file("simple_class.h");
+	while (getline(in, line)) {
+		TS_ASSERT_DIFFERS(line.find(" /"), string::npos);
+		found = found || (line.size() > suffix.size() && line.compare(line.size() - suffix.size(), suffix.size(), suffix) == 0);
+	}
+	TS_ASSERT(found);
+
+	// an entry is only kept while every dependency can be read
+	string dependency = output_file("manifest_dependency.h");
+	ofstream(dependency.c_str()) << "int x;\n";
+	uint64_t h;
+	TS_ASSERT(Manifest::hashFile(output, h));
+
+	Manifest m;
+	TS_ASSERT(m.update(output, 1, h, {dependency}));
+	TS_ASSERT(m.upToDate(output, 1));
+	TS_ASSERT(!m.update(output, 1, h, {dependency, output_file("missing_dependency.h")}));
+	TS_ASSERT(!m.upToDate(output, 1));
+}
+
+void ParserTestSuite::testVirtualFiles()
+{
+	// the directory has to exist, the files do not
+	const string dir = output_file("");
+	const parser::VirtualFiles files = {
+		{ dir + "virtual_base.h", "class Base { public: virtual ~Base() {} virtual int value() const = 0; };\n" },
+		{ dir + "virtual_main.h",
+		  "#include \"virtual_base.h\"\n"
+		  "class Derived : public Base {\n"
+		  "public:\n"
+		  "\tint value() const { return number; }\n"
+		  "\tint number;\n"
+		  "};\n"
+		  "double half(int i);\n" }
+	};
+	const parser::Command command = { dir, "virtual_main.h", { "clang++", "-xc++", "-std=c++11" } };
+
+	definitions::TranslationUnit tu;
+	string diagnostics;
+	vector<string> dependencies;
+	TS_ASSERT(parser::parse(command, tu, false, &diagnostics, &dependencies, nullptr, true, &files));
+	TS_ASSERT_EQUALS(diagnostics, "");
+
+	// the generated code includes the file as it was given, not a path of this machine
+	TS_ASSERT_EQUALS(count(tu.include_directives.begin(), tu.include_directives.end(), "#include \"virtual_main.h\""), 1);
+
+	TS_ASSERT_EQUALS(tu.classIndex.count("Base"), 1u);
+	TS_ASSERT_EQUALS(tu.classIndex.count("Derived"), 1u);
+	if (tu.classIndex.count("Base") == 0 || tu.classIndex.count("Derived") == 0) {
+		return;
+	}
+	TS_ASSERT(!tu.classIndex.at("Base")->inMainFile);
+
+	const definitions::Class& derived = *tu.classIndex.at("Derived");
+	TS_ASSERT(derived.inMainFile);
+	TS_ASSERT_EQUALS(derived.inherited.size(), 1u);
+	TS_ASSERT_EQUALS(derived.attributes.size(), 1u);
+	TS_ASSERT_EQUALS(derived.attributes.at(0).name, "number");
+
+	bool foundValue = false;
+	for (const definitions::Method& m: derived.methods) {
+		if (m.name == "value") {
+			foundValue = true;
+			TS_ASSERT(m.is_const);
+			TS_ASSERT_EQUALS(m.return_type_spelling, "int");
+		}
+	}
+	TS_ASSERT(foundValue);
+
+	TS_ASSERT_EQUALS(tu.functions.size(), 1u);
+	if (!tu.functions.empty()) {
+		TS_ASSERT_EQUALS(tu.functions[0].name, "half");
+		TS_ASSERT_EQUALS(tu.functions[0].return_type_spelling, "double");
+		TS_ASSERT_EQUALS(tu.functions[0].argument_type_spellings, "int");
+	}
+
+	const string base = "/virtual_base.h";
+	TS_ASSERT(find_if(dependencies.begin(), dependencies.end(), [&](const string& d) {
+		return d.size() >= base.size() && d.compare(d.size() - base.size(), base.size(), base) == 0;
+	}) != dependencies.end());
+}
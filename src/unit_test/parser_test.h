@@ -28,6 +28,14 @@ public:
 	void testInheritance();
 	void testInterface();
 	void testTemplates();
+	void testIncremental();
+	void testShards();
+	void testMethodTables();
+	void testBinaryMetadata();
+	void testJsonLines();
+	void testIncrementalJson();
+	void testManifestDependencies();
+	void testVirtualFiles();
 };
 
 
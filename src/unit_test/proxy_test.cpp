@@ -8,6 +8,10 @@
 
 #include "test_utils.h"
 
+#include <atomic>
+#include <thread>
+#include <vector>
+
 namespace ProxyTest {
 
 	class Test {
@@ -152,6 +156,12 @@ namespace ProxyTest {
             return c.id();
         }
     };
+
+    struct Listener {
+        virtual ~Listener() {}
+
+        virtual int onEvent(bool urgent, double weight, const std::string& name, const CopyCount& source) = 0;
+    };
 }
 
 
@@ -213,6 +223,15 @@ REFL_METHOD(paramByReference, int, ProxyTest::CopyCount&)
 REFL_METHOD(paramByConstReference, int, const ProxyTest::CopyCount&)
 REFL_END_CLASS
 
+REFL_BEGIN_STUB(ProxyTest::Listener, ListenerStub)
+REFL_STUB_METHOD(ProxyTest::Listener, onEvent, int, bool, double, const std::string&, const ProxyTest::CopyCount&)
+REFL_END_STUB
+
+REFL_BEGIN_CLASS(ProxyTest::Listener)
+REFL_STUB(ListenerStub)
+REFL_METHOD(onEvent, int, bool, double, const std::string&, const ProxyTest::CopyCount&)
+REFL_END_CLASS
+
 
 void ProxyTestSuite::testProxy()
 {
@@ -379,6 +398,19 @@ void ProxyTestSuite::testLuaAPI()
 	LuaUtils::callFunc<bool>(L, "testProxy");
 }
 
+void ProxyTestSuite::testLuaHandlerArguments()
+{
+	LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/proxy_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+		luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+	}
+    LuaUtils::removeTraceBack(L, errIndex);
+	LuaUtils::callFunc<bool>(L, "testHandlerArguments");
+}
+
 void ProxyTestSuite::testReturnByValue()
 {
     using namespace ProxyTest;
@@ -687,3 +719,220 @@ void ProxyTestSuite::testParametersByConstReference()
     TS_ASSERT_EQUALS(r, 44);
     TS_ASSERT_EQUALS(c.id(), 44);
 }
+
+void ProxyTestSuite::testMultipleInterfaces()
+{
+    Class test = Class::lookup("ProxyTest::Test");
+    Class testVoid = Class::lookup("ProxyTest::TestVoid");
+    Class paramPassing = Class::lookup("ProxyTest::TestParamPassing");
+
+    Method m = test.findMethod([](const Method& m){ return m.name() == "method1"; });
+    Method mv = testVoid.findMethod([](const Method& m){ return m.name() == "method1"; });
+    Method other = paramPassing.findMethod([](const Method& m){ return m.name() == "paramByValue"; });
+
+    Proxy proxy{test, testVoid};
+
+    Proxy::IFaceList ifaces = proxy.interfaces();
+    TS_ASSERT_EQUALS(ifaces.size(), 2)
+    TS_ASSERT_EQUALS(ifaces.front(), test)
+    TS_ASSERT_EQUALS(ifaces.back(), testVoid)
+
+    int voidResult = 0;
+
+    proxy.addImplementation(m, [](const ArgArray& args) -> VariantValue {
+        return VariantValue(args[0].value<int>() + args[1].value<int>());
+    });
+
+    TS_ASSERT(proxy.hasImplementation(m));
+    TS_ASSERT(!proxy.hasImplementation(mv));
+
+    auto& stubVoid = proxy.reference(testVoid).convertTo<ProxyTest::TestVoid&>();
+    TS_ASSERT_THROWS(stubVoid.method1(1, 2), std::logic_error);
+
+    proxy.addImplementation(mv, [&](const ArgArray& args) -> VariantValue {
+        voidResult = args[0].value<int>() * args[1].value<int>();
+        return VariantValue();
+    });
+
+    TS_ASSERT(proxy.hasImplementation(mv));
+
+    auto& stub = proxy.reference(test).convertTo<ProxyTest::Test&>();
+    TS_ASSERT_EQUALS(stub.method1(3, 4), 7);
+
+    stubVoid.method1(3, 4);
+    TS_ASSERT_EQUALS(voidResult, 12);
+
+    TS_ASSERT_THROWS(proxy.addImplementation(other, [](const ArgArray&) { return VariantValue(); }), std::logic_error);
+    TS_ASSERT(!proxy.hasImplementation(other));
+}
+
+void ProxyTestSuite::testTypedImplementation()
+{
+    using namespace ProxyTest;
+    Class test = Class::lookup("ProxyTest::TestParamPassing");
+
+    Method byValue = test.findMethod([](const Method& m){ return m.name() == "paramByValue"; });
+    Method byRef = test.findMethod([](const Method& m){ return m.name() == "paramByReference"; });
+    Method retByValue = test.findMethod([](const Method& m){ return m.name() == "returnObjectByValue"; });
+
+    Proxy proxy(test);
+
+    proxy.addImplementation<int(CopyCount)>(byValue, [](CopyCount c) { return c.id(); });
+    proxy.addImplementation<int(CopyCount&)>(byRef, [](CopyCount& c) {
+        c.changeId(c.id()+1);
+        return c.id();
+    });
+    proxy.addImplementation<CopyCount()>(retByValue, []() { return CopyCount(33); });
+
+    TS_ASSERT(proxy.hasImplementation(byValue));
+    TS_ASSERT(proxy.hasImplementation(byRef));
+    TS_ASSERT(proxy.hasImplementation(retByValue));
+
+    auto& stub = proxy.reference(test).convertTo<TestParamPassing&>();
+
+    CopyCount c(44);
+
+    CopyCount::resetAll();
+    TS_ASSERT_EQUALS(stub.paramByValue(c), 44);
+    // only the copy made by the caller, the handler gets it moved
+    TS_ASSERT_EQUALS(CopyCount::numberOfCopies(), 1);
+    TS_ASSERT_EQUALS(CopyCount::numberOfMoves(), 1);
+
+    CopyCount::resetAll();
+    TS_ASSERT_EQUALS(stub.paramByReference(c), 45);
+    TS_ASSERT_EQUALS(c.id(), 45);
+    TS_ASSERT_EQUALS(CopyCount::numberOfCopies(), 0);
+    TS_ASSERT_EQUALS(CopyCount::numberOfMoves(), 0);
+
+    CopyCount::resetAll();
+    CopyCount r = stub.returnObjectByValue();
+    TS_ASSERT_EQUALS(r.id(), 33);
+    TS_ASSERT_EQUALS(CopyCount::numberOfCopies(), 0);
+
+    // dynamic callers go through the stub too
+    VariantValue handle = proxy.reference(test);
+    VariantValue v = byValue.call(handle, CopyCount(7));
+    TS_ASSERT_EQUALS(v.value<int>(), 7);
+
+    TS_ASSERT_THROWS(proxy.addImplementation<int(CopyCount, int)>(byValue, [](CopyCount c, int) { return c.id(); }), std::logic_error);
+}
+
+void ProxyTestSuite::testTypedImplementationFallback()
+{
+    Class test = Class::lookup("ProxyTest::Test");
+    Method m = test.findMethod([](const Method& m){ return m.name() == "method1"; });
+
+    Proxy proxy(test);
+
+    // not the signature of the stub, called through variants
+    proxy.addImplementation<long(const int&, const int&)>(m, [](const int& a, const int& b) -> long {
+        return a - b;
+    });
+
+    auto& stub = proxy.reference(test).convertTo<ProxyTest::Test&>();
+    TS_ASSERT_EQUALS(stub.method1(10, 3), 7);
+
+    // an untyped handler replaces the typed one
+    proxy.addImplementation(m, [](const ArgArray& args) -> VariantValue {
+        return VariantValue(args[0].value<int>() * args[1].value<int>());
+    });
+    TS_ASSERT_EQUALS(stub.method1(10, 3), 30);
+
+    proxy.addImplementation<int(int, int)>(m, [](int a, int b) { return a + b; });
+    TS_ASSERT_EQUALS(stub.method1(10, 3), 13);
+}
+
+void ProxyTestSuite::testConcurrentCalls()
+{
+    Class test = Class::lookup("ProxyTest::Test");
+    Method m = test.findMethod([](const Method& m){ return m.name() == "method1"; });
+
+    std::atomic<bool> wrong(false);
+    std::vector<std::thread> threads;
+
+    {
+        Proxy proxy(test);
+        proxy.addImplementation<int(int, int)>(m, [](int a, int b) { return a + b; });
+
+        for (int t = 0; t < 4; ++t) {
+            threads.emplace_back([&proxy, &wrong, test, t]() {
+                for (int i = 0; i < 10000; ++i) {
+                    Proxy copy(proxy);
+                    auto& stub = copy.reference(test).convertTo<ProxyTest::Test&>();
+                    // both handlers give the same result
+                    if (stub.method1(i, t) != i + t) {
+                        wrong = true;
+                    }
+                }
+            });
+        }
+
+        // swap handlers while the other threads are calling
+        for (int i = 0; i < 100; ++i) {
+            if (i % 2) {
+                proxy.addImplementation<int(int, int)>(m, [](int a, int b) { return a + b; });
+            } else {
+                proxy.addImplementation(m, [](const ArgArray& args) -> VariantValue {
+                    return VariantValue(args[0].value<int>() + args[1].value<int>());
+                });
+            }
+        }
+
+        for (auto& th: threads) {
+            th.join();
+        }
+        TS_ASSERT(!wrong);
+    }
+
+    // all handles are gone
+    Proxy another(test);
+    TS_ASSERT(!another.hasImplementation(m));
+}
+
+void ProxyTestSuite::testReplacedHandlersReleased()
+{
+    Class test = Class::lookup("ProxyTest::Test");
+    Method m = test.findMethod([](const Method& m){ return m.name() == "method1"; });
+
+    Proxy proxy(test);
+    auto& stub = proxy.reference(test).convertTo<ProxyTest::Test&>();
+
+    std::shared_ptr<int> first = std::make_shared<int>(1);
+    std::weak_ptr<int> watch = first;
+    proxy.addImplementation<int(int, int)>(m, [first](int a, int b) { return a + b + *first; });
+    first.reset();
+    TS_ASSERT_EQUALS(stub.method1(1, 2), 4);
+
+    // the tables holding the first handler go away with it
+    for (int i = 0; i < 1000; ++i) {
+        proxy.addImplementation<int(int, int)>(m, [i](int a, int b) { return a + b + i; });
+    }
+    TS_ASSERT(watch.expired());
+    TS_ASSERT_EQUALS(stub.method1(1, 2), 1002);
+}
+
+void ProxyTestSuite::testHandlerReplacesItself()
+{
+    Class test = Class::lookup("ProxyTest::Test");
+    Method m = test.findMethod([](const Method& m){ return m.name() == "method1"; });
+
+    Proxy proxy(test);
+    auto& stub = proxy.reference(test).convertTo<ProxyTest::Test&>();
+
+    // the running handler and its table stay alive until it returns
+    std::shared_ptr<int> offset = std::make_shared<int>(10);
+    std::weak_ptr<int> watch = offset;
+    proxy.addImplementation<int(int, int)>(m, [&proxy, &m, offset](int a, int b) {
+        proxy.addImplementation<int(int, int)>(m, [](int a, int b) { return a * b; });
+        return a + b + *offset;
+    });
+    offset.reset();
+
+    TS_ASSERT_EQUALS(stub.method1(2, 3), 15);
+    TS_ASSERT_EQUALS(stub.method1(2, 3), 6);
+
+    // released by the next replacement, once no call runs it anymore
+    proxy.addImplementation<int(int, int)>(m, [](int a, int b) { return a - b; });
+    TS_ASSERT(watch.expired());
+    TS_ASSERT_EQUALS(stub.method1(2, 3), -1);
+}
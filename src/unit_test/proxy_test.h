@@ -17,12 +17,19 @@ public:
     void testVoidProxy();
 	void testClient();
 	void testLuaAPI();
+	void testLuaHandlerArguments();
     void testReturnByValue();
     void testReturnByReference();
     void testReturnByConstReference();
     void testParametersByValue();
     void testParametersByReference();
     void testParametersByConstReference();
+    void testMultipleInterfaces();
+    void testTypedImplementation();
+    void testTypedImplementationFallback();
+    void testConcurrentCalls();
+    void testReplacedHandlersReleased();
+    void testHandlerReplacesItself();
 };
 
 
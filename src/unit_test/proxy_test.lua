@@ -21,12 +21,10 @@ function testProxy()
 	TS_ASSERT[[ #ifaces == 1]]
 	-- TODO: equality in lua
 
-	proxy:addImplementation(m1, function(varg1, varg2)
-		TS_ASSERT(varg1)
-		TS_ASSERT(varg1:isIntegral())
-		TS_ASSERT(varg2)
-		TS_ASSERT(varg2:isIntegral())
-		return varg1:tonumber()*varg2:tonumber()
+	proxy:addImplementation(m1, function(arg1, arg2)
+		TS_ASSERT[[ type(arg1) == "number" ]]
+		TS_ASSERT[[ type(arg2) == "number" ]]
+		return arg1*arg2
 	end)
 
 	TS_ASSERT(proxy:hasImplementation(m1))
@@ -35,7 +33,7 @@ function testProxy()
 
 	TS_ASSERT(handle)
 
-        TS_ASSERT[[ m1:call(handle, 3, 5):tonumber() == 15 ]]
+        TS_ASSERT[[ m1:call(handle, 3, 5) == 15 ]]
 
 	local client = Class.lookup("ProxyTest::Client")
 
@@ -54,7 +52,40 @@ function testProxy()
 
 	setter:call(cinst, handle)
 
-        TS_ASSERT[[ doSomething:call(cinst, 3):tonumber() == 6 ]]
+        TS_ASSERT[[ doSomething:call(cinst, 3) == 6 ]]
+
+    return true
+end
+
+function testHandlerArguments()
+
+    local listener = Class.lookup("ProxyTest::Listener")
+    local onEvent = listener:findMethod(function(m) return m:name() == "onEvent" end)
+    local CopyCount = Class.lookup("ProxyTest::CopyCount")
+
+    local proxy = Proxy.create(listener)
+    local events = {}
+
+    proxy:addImplementation(onEvent, function(urgent, weight, name, source)
+        TS_ASSERT[[ type(urgent) == "boolean" ]]
+        TS_ASSERT[[ type(weight) == "number" ]]
+        TS_ASSERT[[ type(name) == "string" ]]
+        events[#events + 1] = name
+        return source:id() + (urgent and 1000 or 0)
+    end)
+
+    local handle = proxy:reference(listener)
+    local source = CopyCount:construct(7)
+
+    TS_ASSERT[[ onEvent:call(handle, true, 0.5, "first", source) == 1007 ]]
+    TS_ASSERT[[ onEvent:call(handle, false, 1.5, "sec\0ond", source) == 7 ]]
+    TS_ASSERT[[ #events == 2 ]]
+    TS_ASSERT[[ events[2] == "sec\0ond" ]]
+
+    proxy:addImplementation(onEvent, function() error("handler failed") end)
+    local ok, err = pcall(onEvent.call, onEvent, handle, true, 0.5, "third", source)
+    TS_ASSERT[[ not ok ]]
+    TS_ASSERT[[ string.find(err, "handler failed", 1, true) ]]
 
     return true
 end
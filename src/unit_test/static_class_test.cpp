@@ -0,0 +1,123 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#define REFL_STATIC_METADATA
+
+#include "static_class_test.h"
+#include "reflection_impl.h"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+using namespace std;
+
+namespace StaticClassTest {
+
+	// number of meta-classes built, REFL_BEGIN_CLASS bodies run only once
+	std::atomic<int> built{0};
+
+	class Base {
+	public:
+		virtual ~Base() {}
+		int baseMethod() const { return 5; }
+	};
+
+	class Test1: public Base {
+	public:
+		int method1(int arg) { return arg*2; }
+		static int method2(int arg) { return arg*3; }
+	};
+
+	class Test2 {};
+}
+
+REFL_BEGIN_CLASS(StaticClassTest::Base)
+	++StaticClassTest::built;
+	REFL_CONST_METHOD(baseMethod, int)
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(StaticClassTest::Test1)
+	++StaticClassTest::built;
+	REFL_SUPER_CLASS(StaticClassTest::Base)
+	REFL_DEFAULT_CONSTRUCTOR()
+	REFL_BEGIN_METHOD_TABLE
+	REFL_METHOD_ROW(method1, int, int)
+	REFL_STATIC_METHOD_ROW(method2, int, int)
+	REFL_END_METHOD_TABLE
+REFL_END_CLASS
+
+REFL_BEGIN_CLASS(StaticClassTest::Test2)
+	++StaticClassTest::built;
+REFL_END_CLASS
+
+using namespace StaticClassTest;
+
+void StaticClassTestSuite::testLazyConstruction()
+{
+	// loading the test binary did not build anything
+	TS_ASSERT_EQUALS(built.load(), 0);
+
+	Class test2 = Class::lookup("StaticClassTest::Test2");
+	TS_ASSERT(test2.isValid());
+	TS_ASSERT_EQUALS(built.load(), 1);
+
+	TS_ASSERT(Class::lookup("StaticClassTest::Test2") == test2);
+	TS_ASSERT_EQUALS(built.load(), 1);
+}
+
+void StaticClassTestSuite::testLookup()
+{
+	Class test1 = Class::lookup("StaticClassTest::Test1");
+	TS_ASSERT(test1.isValid());
+	TS_ASSERT_EQUALS(test1.fullyQualifiedName(), "StaticClassTest::Test1");
+	TS_ASSERT(Class::lookup(typeid(Test1)) == test1);
+	TS_ASSERT(ClassOf<Test1>() == test1);
+
+	TS_ASSERT(!Class::lookup("StaticClassTest::Test3").isValid());
+	TS_ASSERT(!Class::lookup(typeid(std::vector<Test1>)).isValid());
+
+	VariantValue v = test1.constructors().front().call();
+	Method method1 = test1.findMethod([](const Method& m) { return m.name() == "method1"; });
+	TS_ASSERT_EQUALS(method1.call(v, 4).value<int>(), 8);
+	Method method2 = test1.findMethod([](const Method& m) { return m.name() == "method2"; });
+	TS_ASSERT_EQUALS(method2.call(4).value<int>(), 12);
+}
+
+void StaticClassTestSuite::testSuperClass()
+{
+	Class test1 = Class::lookup("StaticClassTest::Test1");
+
+	// the base is resolved by name and built on demand
+	TS_ASSERT_EQUALS(test1.superclasses().size(), 1u);
+	Class base = test1.superclasses().front();
+	TS_ASSERT(base == Class::lookup("StaticClassTest::Base"));
+
+	VariantValue v = test1.constructors().front().call();
+	Method baseMethod = test1.findMethod([](const Method& m) { return m.name() == "baseMethod"; });
+	TS_ASSERT(baseMethod.isValid());
+	TS_ASSERT_EQUALS(baseMethod.call(v).value<int>(), 5);
+}
+
+void StaticClassTestSuite::testParallelLookup()
+{
+	const Class expected = Class::lookup("StaticClassTest::Test1");
+
+	std::atomic<int> failures{0};
+	vector<thread> threads;
+	for (int i = 0; i < 8; ++i) {
+		threads.emplace_back([&]() {
+			for (int j = 0; j < 1000; ++j) {
+				if (Class::lookup("StaticClassTest::Test1") != expected || Class::lookup(typeid(Base)) != expected.superclasses().front()) {
+					++failures;
+				}
+			}
+		});
+	}
+	for (thread& t: threads) {
+		t.join();
+	}
+	TS_ASSERT_EQUALS(failures.load(), 0);
+	TS_ASSERT_EQUALS(built.load(), 3);
+}
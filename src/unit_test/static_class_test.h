@@ -0,0 +1,22 @@
+/*
+** SelfPortrait API
+** See Copyright Notice in reflection.h
+*/
+#ifndef STATIC_CLASS_TEST_H
+#define STATIC_CLASS_TEST_H
+
+#include <cxxtest/TestSuite.h>
+
+class StaticClassTestSuite : public CxxTest::TestSuite
+{
+public:
+
+	// test methods must begin with "test", otherwise cxxtestgen ignores them
+	void testLazyConstruction();
+	void testLookup();
+	void testSuperClass();
+	void testParallelLookup();
+};
+
+
+#endif /* STATIC_CLASS_TEST_H */
@@ -62,7 +62,7 @@ namespace LuaUtils {
         const int nargs = lua_gettop(L);
 
         if (nargs == 3) {
-            CxxTest::TestTracker::tracker().failedTest( luaL_checkstring(L, -3), luaL_checkint(L, -2), luaL_checkstring(L, -1) );
+            CxxTest::TestTracker::tracker().failedTest( luaL_checkstring(L, -3), static_cast<int>(luaL_checkinteger(L, -2)), luaL_checkstring(L, -1) );
         } else if (nargs >= 1) {
             lua_Debug debug;
             lua_getstack(L, 1, &debug);
@@ -79,7 +79,7 @@ namespace LuaUtils {
         const int nargs = lua_gettop(L);
 
         if (nargs == 3) {
-            CxxTest::TestTracker::tracker().trace(luaL_checkstring(L, -3), luaL_checkint(L, -2), luaL_checkstring(L, -1) );
+            CxxTest::TestTracker::tracker().trace(luaL_checkstring(L, -3), static_cast<int>(luaL_checkinteger(L, -2)), luaL_checkstring(L, -1) );
         } else if (nargs >= 1) {
             lua_Debug debug;
             lua_getstack(L, 1, &debug);
@@ -96,7 +96,7 @@ namespace LuaUtils {
         const int nargs = lua_gettop(L);
 
         if (nargs == 3) {
-            CxxTest::TestTracker::tracker().warning(luaL_checkstring(L, -3), luaL_checkint(L, -2), luaL_checkstring(L, -1) );
+            CxxTest::TestTracker::tracker().warning(luaL_checkstring(L, -3), static_cast<int>(luaL_checkinteger(L, -2)), luaL_checkstring(L, -1) );
         } else if (nargs >= 1) {
             lua_Debug debug;
             lua_getstack(L, 1, &debug);
@@ -307,6 +307,19 @@ void VariantTestSuite::testLuaAPI()
     LuaUtils::callFunc<bool>(L, "testVariant");
 }
 
+void VariantTestSuite::testLuaIntegers()
+{
+    LuaUtils::LuaStateHolder L;
+    LuaUtils::addTestFunctionsAndPaths(&*L);
+
+    const int errIndex = LuaUtils::pushTraceBack(L);
+    if (luaL_loadfile(L, strconv::fmt_str("%1/variant_test.lua", srcpath()).c_str()) || lua_pcall(L,0,0,errIndex)) {
+        luaL_error(L, "cannot run config file: %s\n", lua_tostring(L, -1));
+    }
+    LuaUtils::removeTraceBack(L, errIndex);
+    LuaUtils::callFunc<bool>(L, "testIntegers");
+}
+
 
 void VariantTestSuite::testAssignement()
 {
@@ -385,3 +398,37 @@ void VariantTestSuite::testAlignemnt()
         TS_ASSERT_EQUALS(alignof(AlignTest), v.alignOf());
     }
 }
+
+void VariantTestSuite::testStringRef()
+{
+    std::string str("borrowed");
+
+    VariantValue ref;
+    ref.construct<std::string&>(str);
+    StringRef s = ref.convertTo<StringRef>();
+    TS_ASSERT_EQUALS(s.data(), str.data());
+    TS_ASSERT_EQUALS(s.size(), str.size());
+
+    VariantValue constRef;
+    constRef.construct<const std::string&>(str);
+    TS_ASSERT(constRef.isStdString());
+    TS_ASSERT_EQUALS(constRef.convertTo<StringRef>().data(), str.data());
+
+    const char* literal = "literal";
+    VariantValue cstr;
+    cstr.construct<const char*>(literal);
+    TS_ASSERT_EQUALS(cstr.convertTo<StringRef>().data(), literal);
+    TS_ASSERT_EQUALS(cstr.convertToThrow<const StringRef&>().size(), 7);
+
+    VariantValue held(StringRef("a\0b", 3));
+    TS_ASSERT_EQUALS(held.convertTo<std::string>(), std::string("a\0b", 3));
+
+    bool success = true;
+    VariantValue(3).convertTo<StringRef>(&success);
+    TS_ASSERT(!success);
+    TS_ASSERT_THROWS(VariantValue(3).convertToThrow<StringRef>(), std::runtime_error);
+
+    TS_ASSERT_EQUALS(StringRef("key=value").substr(4), StringRef("value"));
+    TS_ASSERT_EQUALS(StringRef("key=value").find('='), 3);
+    TS_ASSERT_EQUALS(StringRef("key").find('='), StringRef::npos);
+}
@@ -15,6 +15,7 @@ public:
 	// test methods must begin with "test", otherwise cxxtestgen ignores them
 
     void testLuaAPI();
+    void testLuaIntegers();
 	void testInvalid();
 	void testValue();
 	void testConversions();
@@ -24,6 +25,7 @@ public:
     void testPrintable();
     void testAssignement();
     void testAlignemnt();
+    void testStringRef();
 };
 
 
@@ -29,3 +29,39 @@ function testVariant()
 
     return false
 end
+
+function testIntegers()
+
+    local v1 = Variant.new(7)
+    TS_ASSERT [[ v1:isIntegral() ]]
+    TS_ASSERT [[ v1 % 4 == 3 ]]
+    -- floor modulo, the result has the sign of the divisor
+    TS_ASSERT [[ v1 % -4 == -1 ]]
+    TS_ASSERT [[ Variant.new(-7) % 4 == 1 ]]
+    TS_ASSERT [[ Variant.new(-8) % 4 == 0 ]]
+    TS_ASSERT [[ Variant.new(-7.5) % 2 == 0.5 ]]
+    TS_ASSERT [[ Variant.new(7.5) % -2 == -0.5 ]]
+    TS_ASSERT [[ -v1 == -7 ]]
+    TS_ASSERT [[ v1 / 2 == 3.5 ]]
+
+    local v2 = Variant.new(2.5)
+    TS_ASSERT [[ v2:isFloatingPoint() ]]
+    TS_ASSERT [[ v2 + v1 == 9.5 ]]
+
+    -- numbers have an integer subtype since Lua 5.3
+    if math.type then
+        local big = 9007199254740993
+        local v3 = Variant.new(big)
+        TS_ASSERT [[ v3:isIntegral() ]]
+        TS_ASSERT [[ v3:tonumber() == big ]]
+        TS_ASSERT [[ math.type(v3:tonumber()) == 'integer' ]]
+        TS_ASSERT [[ v3 + 1 == big + 1 ]]
+        TS_ASSERT [[ math.type(v3 + 1) == 'integer' ]]
+        TS_ASSERT [[ v3 - v1 == big - 7 ]]
+        TS_ASSERT [[ v3 * 2 == big * 2 ]]
+        TS_ASSERT [[ math.type(v3 / 1) == 'float' ]]
+        TS_ASSERT [[ math.type(v2 + 1) == 'float' ]]
+    end
+
+    return false
+end
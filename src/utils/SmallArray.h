@@ -158,7 +158,7 @@ private:
 
     template<class... Args>
     T& construct(size_type i, Args&&... args) {
-        new(Base::access_mem(i)) T(::std::forward<Args>(args)...);
+        return *new(Base::access_mem(i)) T(::std::forward<Args>(args)...);
     }
 
     void destruct(size_type i) {
@@ -168,7 +168,7 @@ private:
 public:
 
     ~SmallArray() {
-        for (int i = 0; i < Base::size(); ++i) {
+        for (size_type i = 0; i < Base::size(); ++i) {
             destruct(i);
         }
     }
@@ -3,6 +3,7 @@
 ** See Copyright Notice in lua_utils.h
 */
 #include "lua_utils.h"
+#include <cmath>
 #include <stdexcept>
 #include "str_conversion.h"
 using namespace std;
@@ -87,6 +88,19 @@ namespace LuaUtils {
         }
     }
 
+    bool isinteger(lua_State *L, int idx)
+    {
+        if (lua_type(L, idx) != LUA_TNUMBER) {
+            return false;
+        }
+#if LUA_VERSION_NUM >= 503
+        return lua_isinteger(L, idx);
+#else
+        const lua_Number n = lua_tonumber(L, idx);
+        return n == std::floor(n) && std::fabs(n) <= 9007199254740992.0;
+#endif
+    }
+
     int stackDump(lua_State *L)
 	{
 		int top = lua_gettop(L);
@@ -41,6 +41,11 @@ namespace LuaUtils {
 
 	bool isudata (lua_State *L, int ud, const char *tname);
 
+	// true if the number at idx should be treated as an integer. Lua 5.3 has
+	// an integer subtype, older versions and LuaJIT only have doubles so
+	// integral values that are exactly representable are taken as integers
+	bool isinteger(lua_State *L, int idx);
+
     void printType(lua_State* L, int i);
 
     int stackDump(lua_State *L);